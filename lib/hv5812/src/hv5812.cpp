@@ -2,32 +2,38 @@
 #include <Arduino.h>
 
 const unsigned CLOCK_DELAY_US = 2U;
+const uint32_t CLOCK_DELAY_CYCLES = CLOCK_DELAY_US * (F_CPU / 1000000UL);
+const uint8_t GPIO16 = 16U;
 
 static uint8_t _bl;
 static uint8_t _strobe;
 static uint8_t _clk;
 static uint8_t _data_in;
 
-void HV5812_vfdDriver(long content_data_in)
+// Used by the ISR while the flash may be busy, so they must not call out of the IRAM.
+static inline __attribute__((always_inline)) void hv5812_write(uint8_t pin, bool level);
+static inline __attribute__((always_inline)) void hv5812_delay();
+
+void ICACHE_RAM_ATTR HV5812_vfdDriver(long content_data_in)
 {
   for (int i = 0; i < 20; i++)
   {
     if (content_data_in & (1 << (19 - i)))
     {
-      digitalWrite(_data_in, HIGH);
+      hv5812_write(_data_in, HIGH);
     }
     else
     {
-      digitalWrite(_data_in, LOW);
+      hv5812_write(_data_in, LOW);
     }
-    delayMicroseconds(CLOCK_DELAY_US);
-    digitalWrite(_clk, HIGH);
-    delayMicroseconds(CLOCK_DELAY_US);
-    digitalWrite(_clk, LOW);
+    hv5812_delay();
+    hv5812_write(_clk, HIGH);
+    hv5812_delay();
+    hv5812_write(_clk, LOW);
   }
-  digitalWrite(_strobe, LOW); // latch-pulse inverted
-  delayMicroseconds(CLOCK_DELAY_US);
-  digitalWrite(_strobe, HIGH);
+  hv5812_write(_strobe, LOW); // latch-pulse inverted
+  hv5812_delay();
+  hv5812_write(_strobe, HIGH);
 }
 
 void HV5812_blanking(vfd_driver_blanking_e blanking)
@@ -58,3 +64,32 @@ void HV5812_init(uint8_t bl, uint8_t strobe, uint8_t clk, uint8_t data_in)
   digitalWrite(bl, HIGH);     // Blanking low active
   digitalWrite(strobe, HIGH); // Inverted in HW
 }
+
+// Same as digitalWrite() of the core for an output pin, without the call.
+static inline __attribute__((always_inline)) void hv5812_write(uint8_t pin, bool level)
+{
+  if (pin < GPIO16)
+  {
+    if (level)
+      GPOS = (1UL << pin);
+    else
+      GPOC = (1UL << pin);
+  }
+  else if (level)
+  {
+    GP16O |= 1UL;
+  }
+  else
+  {
+    GP16O &= ~1UL;
+  }
+}
+
+// Busy wait of CLOCK_DELAY_US by the cycle counter instead of delayMicroseconds().
+static inline __attribute__((always_inline)) void hv5812_delay()
+{
+  const uint32_t start = ESP.getCycleCount();
+  while (ESP.getCycleCount() - start < CLOCK_DELAY_CYCLES)
+  {
+  }
+}
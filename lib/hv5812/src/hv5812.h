@@ -46,6 +46,9 @@ extern "C"
    * \brief Transmit data to shift register ic.
    * \param content_data_in Serial data to be outputted to the high voltage outputs HVout1 to HVout20.
    * \sa    [HV5812.pdf](../../lib/hv5812/docs/HV5812.pdf "Hardware specs")
+   *
+   * Resides in IRAM and writes the GPIO registers directly, so it can be called from an
+   * interrupt while the SPI flash is busy.
    */
   void HV5812_vfdDriver(long content_data_in);
 
@@ -0,0 +1,32 @@
+#include "animations.h"
+
+#include <Arduino.h>
+
+// Generated by tools/vfd_text2frames.py from "42nibbles"
+static const uint8_t VFD_ANIM_BOOT_SPLASH_FRAMES[][VFD_TUBE_CNT] PROGMEM = {
+    {16, 16, 16, 16, 16, 16},
+    {4, 16, 16, 16, 16, 16},
+    {2, 4, 16, 16, 16, 16},
+    {19, 2, 4, 16, 16, 16},
+    {20, 19, 2, 4, 16, 16},
+    {11, 20, 19, 2, 4, 16},
+    {11, 11, 20, 19, 2, 4},
+    {23, 11, 11, 20, 19, 2},
+    {14, 23, 11, 11, 20, 19},
+    {25, 14, 23, 11, 11, 20},
+    {16, 25, 14, 23, 11, 11},
+    {16, 16, 25, 14, 23, 11},
+    {16, 16, 16, 25, 14, 23},
+    {16, 16, 16, 16, 25, 14},
+    {16, 16, 16, 16, 16, 25},
+    {16, 16, 16, 16, 16, 16},
+};
+const vfd_animation_t VFD_ANIM_BOOT_SPLASH = {VFD_ANIM_BOOT_SPLASH_FRAMES, sizeof(VFD_ANIM_BOOT_SPLASH_FRAMES) / sizeof(VFD_ANIM_BOOT_SPLASH_FRAMES[0]), 200, 0};
+
+// Roll-over transition: the old digit is replaced by a dash, then by a blank
+// and finally the new digit shows up.
+static const uint8_t VFD_ANIM_ROLL_OVER_FRAMES[][VFD_TUBE_CNT] PROGMEM = {
+    {VFD_DASH, VFD_DASH, VFD_DASH, VFD_DASH, VFD_DASH, VFD_DASH},
+    {VFD_BLANK, VFD_BLANK, VFD_BLANK, VFD_BLANK, VFD_BLANK, VFD_BLANK},
+};
+const vfd_animation_t VFD_ANIM_ROLL_OVER = {VFD_ANIM_ROLL_OVER_FRAMES, sizeof(VFD_ANIM_ROLL_OVER_FRAMES) / sizeof(VFD_ANIM_ROLL_OVER_FRAMES[0]), 45, 0};
@@ -0,0 +1,19 @@
+/**
+  \file   animations.h
+  \brief  Flash resident animations for startVfdAnimation().
+
+  Scrolling texts are generated by <kbd>tools/vfd_text2frames.py</kbd> and pasted
+  into animations.cpp.
+*/
+#ifndef ANIMATIONS_H
+#define ANIMATIONS_H
+
+#include "multiplexing.h"
+
+/// Boot splash scrolling "42nibbles" through the display.
+extern const vfd_animation_t VFD_ANIM_BOOT_SPLASH;
+
+/// Short dash wipe to be played on the tubes whose digits have changed.
+extern const vfd_animation_t VFD_ANIM_ROLL_OVER;
+
+#endif // ANIMATIONS_H
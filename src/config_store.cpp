@@ -0,0 +1,224 @@
+#include "config_store.h"
+
+#include <Arduino.h>
+#include <cstring>
+#include "crc.h"
+
+extern "C" uint32_t _FS_start;     // Provided by the linker script, see ld/eagle.flash.1m.config.ld
+extern "C" uint32_t _EEPROM_start; // Provided by the linker script
+
+// Flash layout
+static const uint32_t FLASH_MAPPED_BASE = 0x40200000UL;
+static const uint32_t CONFIG_SECTOR_SIZE = 4096UL;
+static const uint32_t CONFIG_SECTOR_CNT = 2UL; // The last one is the EEPROM sector
+static const uint32_t CONFIG_SLOT_SIZE = 256UL;
+static const uint32_t CONFIG_SLOT_CNT = CONFIG_SECTOR_SIZE / CONFIG_SLOT_SIZE;
+
+// Record layout
+static const uint16_t RECORD_MAGIC = 0x4E42; // "BN"
+static const uint8_t RECORD_VERSION = 2;
+static const uint32_t ERASED_WORD = 0xFFFFFFFFUL;
+
+/// Header of each slot.  The first word is never all ones for a used slot.
+typedef struct
+{
+  uint16_t magic;
+  uint8_t version;
+  uint8_t length;
+  uint32_t sequence; ///< Incremented by each save, orders the records of both sectors
+} config_record_header_t;
+
+/// Complete slot as it is written to flash.
+typedef struct
+{
+  config_record_header_t header;
+  vfd_config_t config;
+  uint16_t crc;
+} config_record_t;
+
+static_assert(sizeof(config_record_t) <= CONFIG_SLOT_SIZE, "Config record exceeds its flash slot");
+static_assert(offsetof(config_record_t, crc) == sizeof(config_record_header_t) + sizeof(vfd_config_t),
+              "The CRC has to follow the configuration, older records are shorter");
+static_assert(sizeof(vfd_config_t) < 256U, "Config length must fit the record header");
+
+// Local variables
+static vfd_config_t _config;
+static uint32_t _sector;    // Sector taking the next record
+static uint32_t _next_slot; // CONFIG_SLOT_CNT means the sector is full
+static uint32_t _sequence;  // Of the newest record
+
+// Local function prototypes
+static bool layout_is_reserved();
+static uint32_t slot_address(uint32_t sector, uint32_t slot);
+static bool slot_is_erased(uint32_t sector, uint32_t slot);
+static uint32_t find_next_slot(uint32_t sector);
+static bool read_record(uint32_t sector, uint32_t slot, const vfd_config_t *defaults, vfd_config_t *config,
+                        uint32_t *sequence);
+static bool write_record(uint32_t sector, uint32_t slot, const config_record_t *record);
+
+bool configBegin(const vfd_config_t *defaults)
+{
+  vfd_config_t config;
+  uint32_t sequence;
+  bool is_loaded = false;
+
+  memcpy(&_config, defaults, sizeof(_config));
+  _sector = 0;
+  _next_slot = 0;
+  _sequence = 0;
+  if (!layout_is_reserved())
+    return false;
+  // The newest record of each sector is found from its first erased slot.  Both sectors hold records only if
+  // the clock was reset while switching them, so the sequence numbers decide.
+  for (uint32_t sector = 0; sector < CONFIG_SECTOR_CNT; sector++)
+  {
+    const uint32_t next_slot = find_next_slot(sector);
+    // Newest record first.  Older ones only matter if the newest one is torn.
+    for (uint32_t slot = next_slot; slot-- > 0;)
+    {
+      if (read_record(sector, slot, defaults, &config, &sequence))
+      {
+        if (!is_loaded || (int32_t)(sequence - _sequence) > 0)
+        {
+          memcpy(&_config, &config, sizeof(_config));
+          _sector = sector;
+          _next_slot = next_slot;
+          _sequence = sequence;
+          is_loaded = true;
+        }
+        break;
+      }
+    }
+  }
+  return is_loaded;
+}
+
+const vfd_config_t *configGet()
+{
+  return &_config;
+}
+
+bool configSave(const vfd_config_t *config)
+{
+  static_assert(sizeof(config_record_t) % 4 == 0, "Flash access needs whole words");
+  config_record_t record __attribute__((aligned(4)));
+
+  memcpy(&_config, config, sizeof(_config));
+  if (!layout_is_reserved())
+    return false;
+  memset(&record, 0, sizeof(record));
+  record.header.magic = RECORD_MAGIC;
+  record.header.version = RECORD_VERSION;
+  record.header.length = sizeof(vfd_config_t);
+  record.header.sequence = ++_sequence;
+  memcpy(&record.config, config, sizeof(record.config));
+  record.crc = crc16Ccitt(&record, offsetof(config_record_t, crc));
+
+  // Appending to the current sector.  A slot which was not erased after all, e.g. written by a reset during
+  // the last save, fails the verification and the record goes to the other sector.
+  if (_next_slot < CONFIG_SLOT_CNT && write_record(_sector, _next_slot, &record))
+  {
+    _next_slot++;
+    return true;
+  }
+  // Switching the sectors: The new record is written and verified in the other sector before the old one is
+  // erased, so there is a valid record at any time.
+  const uint32_t old_sector = _sector;
+  const uint32_t new_sector = (_sector + 1) % CONFIG_SECTOR_CNT;
+  if (!slot_is_erased(new_sector, 0) || !write_record(new_sector, 0, &record))
+  {
+    if (!ESP.flashEraseSector(slot_address(new_sector, 0) / CONFIG_SECTOR_SIZE) ||
+        !write_record(new_sector, 0, &record))
+      return false;
+  }
+  _sector = new_sector;
+  _next_slot = 1;
+  return ESP.flashEraseSector(slot_address(old_sector, 0) / CONFIG_SECTOR_SIZE);
+}
+
+uint16_t configScheduleVersion(const vfd_config_t *config)
+{
+  uint16_t crc = crc16Ccitt(&config->dst_rule, sizeof(config->dst_rule));
+  crc = crc16Ccitt(&config->std_rule, sizeof(config->std_rule), crc);
+  crc = crc16Ccitt(config->on_hour, sizeof(config->on_hour), crc);
+  return crc16Ccitt(config->off_hour, sizeof(config->off_hour), crc);
+}
+
+//********************************************************************
+// Local functions
+//********************************************************************
+
+// The sectors below the EEPROM sector are reserved as file system area by the linker script.  Else they are
+// the end of the staging area of the network update.
+static bool layout_is_reserved()
+{
+  return (uint32_t)(uintptr_t)&_EEPROM_start - (uint32_t)(uintptr_t)&_FS_start >=
+         (CONFIG_SECTOR_CNT - 1) * CONFIG_SECTOR_SIZE;
+}
+
+static uint32_t slot_address(uint32_t sector, uint32_t slot)
+{
+  const uint32_t first_sector = (uint32_t)(uintptr_t)&_EEPROM_start - (CONFIG_SECTOR_CNT - 1) * CONFIG_SECTOR_SIZE;
+  return (first_sector - FLASH_MAPPED_BASE) + sector * CONFIG_SECTOR_SIZE + slot * CONFIG_SLOT_SIZE;
+}
+
+static bool slot_is_erased(uint32_t sector, uint32_t slot)
+{
+  uint32_t first_word;
+
+  if (!ESP.flashRead(slot_address(sector, slot), &first_word, sizeof(first_word)))
+    return false;
+  return first_word == ERASED_WORD;
+}
+
+// Slots are used from the start of the sector, so the first erased one can be found by a binary search.
+static uint32_t find_next_slot(uint32_t sector)
+{
+  uint32_t low = 0;
+  uint32_t high = CONFIG_SLOT_CNT;
+  while (low < high)
+  {
+    const uint32_t mid = (low + high) / 2;
+    if (slot_is_erased(sector, mid))
+      high = mid;
+    else
+      low = mid + 1;
+  }
+  return low;
+}
+
+// Records of an older firmware are shorter, the CRC follows the stored length.
+static bool read_record(uint32_t sector, uint32_t slot, const vfd_config_t *defaults, vfd_config_t *config,
+                        uint32_t *sequence)
+{
+  config_record_t record __attribute__((aligned(4)));
+  uint16_t crc;
+
+  if (!ESP.flashRead(slot_address(sector, slot), reinterpret_cast<uint32_t *>(&record), sizeof(record)))
+    return false;
+  if (record.header.magic != RECORD_MAGIC || record.header.version != RECORD_VERSION ||
+      record.header.length > sizeof(vfd_config_t))
+    return false;
+  const size_t crc_offset = offsetof(config_record_t, config) + record.header.length;
+  memcpy(&crc, reinterpret_cast<const uint8_t *>(&record) + crc_offset, sizeof(crc));
+  if (crc16Ccitt(&record, crc_offset) != crc)
+    return false;
+  memcpy(config, defaults, sizeof(*config));
+  memcpy(config, &record.config, record.header.length);
+  *sequence = record.header.sequence;
+  return true;
+}
+
+// Writes the record and reads it back.
+static bool write_record(uint32_t sector, uint32_t slot, const config_record_t *record)
+{
+  config_record_t copy __attribute__((aligned(4)));
+  vfd_config_t config;
+  uint32_t sequence;
+
+  memcpy(&copy, record, sizeof(copy));
+  if (!ESP.flashWrite(slot_address(sector, slot), reinterpret_cast<uint32_t *>(&copy), sizeof(copy)))
+    return false;
+  return read_record(sector, slot, &record->config, &config, &sequence) && sequence == record->header.sequence &&
+         memcmp(&config, &record->config, sizeof(config)) == 0;
+}
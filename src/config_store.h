@@ -0,0 +1,113 @@
+/**
+  \file   config_store.h
+  \brief  Runtime configuration kept in a log structured flash record.
+
+  The operational settings of the clock used to be compile time constants, so
+  every room needed its own firmware build.  Now they are kept in a binary
+  record in the flash sector reserved for the EEPROM emulation and the sector
+  below it, which ld/eagle.flash.1m.config.ld keeps out of the network update.
+  The compile time settings in main.cpp are only the defaults for a clock
+  without a stored configuration.
+
+  Each sector is used as a log of fixed size slots.  Saving appends the record
+  to the next free slot of the current sector.  If it is full, the record is
+  written to the other sector and read back before the full one is erased, so a
+  reset at any time leaves a valid record.  The flash is erased once every
+  CONFIG_SLOT_CNT saves instead of each time.  Every record has a version, a
+  sequence number and a CRC, a torn or outdated record is skipped.
+
+  At boot the latest record of each sector is found by a binary search over the
+  slot headers, the one with the higher sequence number is loaded into a plain
+  struct.  The hot paths read the struct returned by configGet() directly, there
+  is no parsing at runtime.
+*/
+#ifndef CONFIG_STORE_H
+#define CONFIG_STORE_H
+
+#include <Timezone.h>
+#include <cstdint>
+
+/// Length of the NTP server name including the terminating zero.
+const unsigned CONFIG_NTP_SERVER_LEN = 40U;
+/// Count of days in the idle schedule, index 0 is sunday.
+const unsigned CONFIG_DAYS_PER_WEEK = 7U;
+/// Count of entries in the rotation of the display pages.
+const unsigned CONFIG_PAGE_CNT = 4U;
+/// Length of the custom message including the terminating zero.
+const unsigned CONFIG_MESSAGE_LEN = 8U;
+/// Length of the key of the HTTP requests including the terminating zero.
+const unsigned CONFIG_HTTP_KEY_LEN = 16U;
+
+/// Flags of vfd_config_t
+typedef enum
+{
+  CONFIG_WIFI_NTP_SYNC = 0x01,   ///< Connect to WiFi and synchronize with a NTP server
+  CONFIG_POWER_SAVE_MODE = 0x02, ///< Turn off the display in idle time
+  CONFIG_UART_DEBUG = 0x04,      ///< Activate the debug terminal
+  CONFIG_NTP_SERVER = 0x08,      ///< Serve NTP to the other clocks of the LAN, see ntp_server.h
+  CONFIG_NTP_DISCOVERY = 0x10,   ///< Prefer a NTP server of the LAN found by a broadcast request
+  CONFIG_HTTP_SERVER = 0x20,     ///< Serve status and configuration by HTTP, see http_server.h
+  CONFIG_RADIO_SLEEP = 0x40      ///< Turn the radio off in idle time, see radio_power.h
+} config_flags_e;
+
+/**
+ * \brief Runtime configuration.
+ *
+ * The display is on from on_hour to off_hour (local time).  If both are equal the
+ * display is off for the whole day.
+ *
+ * New members have to be appended at the end.  A record stored by an older firmware is
+ * shorter, its missing members are taken from the defaults passed to configBegin().
+ */
+typedef struct
+{
+  uint8_t flags;                          ///< Combination of config_flags_e
+  uint8_t tube_type;                      ///< vfd_tube_type_e
+  uint8_t brightness;                     ///< 0 to VFD_BRIGHTNESS_MAX
+  uint8_t reserved;                       ///< Always 0
+  uint16_t udp_local_port;                ///< Local port of the NTP client
+  char ntp_server[CONFIG_NTP_SERVER_LEN]; ///< Host name of the NTP server
+  TimeChangeRule dst_rule;                ///< Start of daylight saving time
+  TimeChangeRule std_rule;                ///< Start of standard time
+  uint8_t on_hour[CONFIG_DAYS_PER_WEEK];  ///< First hour with display on
+  uint8_t off_hour[CONFIG_DAYS_PER_WEEK]; ///< First hour with display off
+  uint16_t low_heap_bytes;                ///< Restart if the largest free heap block stays below, 0 disables
+  uint16_t telemetry_port;                ///< UDP port of the telemetry collector, 0 disables
+  uint16_t telemetry_interval_s;          ///< Interval of the telemetry datagrams
+  uint32_t telemetry_ip;                  ///< IPv4 address of the telemetry collector
+  uint8_t page[CONFIG_PAGE_CNT];          ///< Rotation of the display pages, see display_pages.h
+  uint8_t page_s[CONFIG_PAGE_CNT];        ///< Seconds each page is shown, 0 skips the entry
+  char message[CONFIG_MESSAGE_LEN];       ///< Text of the message page
+  char http_key[CONFIG_HTTP_KEY_LEN];     ///< Key of the HTTP requests changing the clock, empty refuses them
+} vfd_config_t;
+
+/**
+ * \brief Loads the configuration from flash.
+ * \param defaults Configuration to be used if there is no valid record.
+ * \return true if a stored record was loaded.
+ */
+bool configBegin(const vfd_config_t *defaults);
+
+/**
+ * \brief Active configuration.
+ * \return Pointer to the configuration loaded by configBegin().
+ */
+const vfd_config_t *configGet();
+
+/**
+ * \brief Stores a new configuration and makes it active.
+ * \param config Configuration to be stored.
+ * \return false if the flash could not be written.  The configuration is active anyway.
+ *
+ * Settings read only at boot, e.g. the NTP client port, take effect after a restart.
+ */
+bool configSave(const vfd_config_t *config);
+
+/**
+ * \brief Checksum of the idle schedule and the timezone rules.
+ * \param config Configuration to be checked.
+ * \return Value changing whenever the schedule or the timezone is changed.
+ */
+uint16_t configScheduleVersion(const vfd_config_t *config);
+
+#endif // CONFIG_STORE_H
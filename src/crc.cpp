@@ -0,0 +1,19 @@
+#include "crc.h"
+
+uint16_t crc16Ccitt(const void *data, size_t len, uint16_t crc)
+{
+  const uint8_t *bytes = static_cast<const uint8_t *>(data);
+
+  while (len--)
+  {
+    crc ^= (uint16_t)(*bytes++) << 8;
+    for (int i = 0; i < 8; i++)
+    {
+      if (crc & 0x8000U)
+        crc = (crc << 1) ^ 0x1021U;
+      else
+        crc <<= 1;
+    }
+  }
+  return crc;
+}
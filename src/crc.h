@@ -0,0 +1,23 @@
+/**
+  \file   crc.h
+  \brief  Checksums for records kept in non-volatile memories.
+*/
+#ifndef CRC_H
+#define CRC_H
+
+#include <cstddef>
+#include <cstdint>
+
+/// Start value of crc16Ccitt().
+const uint16_t CRC16_CCITT_INIT = 0xFFFFU;
+
+/**
+ * \brief Computes a CRC-16/CCITT (polynomial 0x1021) checksum.
+ * \param data Data to be checked.
+ * \param len Count of bytes.
+ * \param crc CRC16_CCITT_INIT or the result of the previous block for checking data piecewise.
+ * \return Checksum.
+ */
+uint16_t crc16Ccitt(const void *data, size_t len, uint16_t crc = CRC16_CCITT_INIT);
+
+#endif // CRC_H
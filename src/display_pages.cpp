@@ -0,0 +1,168 @@
+#include "display_pages.h"
+
+#include <Arduino.h>
+#include <TimeLib.h>
+#include <cstring>
+#include "config_store.h"
+
+// Local variables
+static const display_page_t *_pages;
+static size_t _page_cnt;
+static uint8_t _published[VFD_TUBE_CNT];
+static int _published_dots;
+static bool _published_is_valid;
+static uint8_t _armed[VFD_TUBE_CNT];
+static int _armed_dots;
+
+// Local function prototypes
+static uint8_t changed_tubes(const uint8_t vfd_output[VFD_TUBE_CNT]);
+static void two_digits(uint8_t vfd_output[VFD_TUBE_CNT], unsigned tube, unsigned value);
+
+void displayPagesBegin(const display_page_t *pages, size_t page_cnt)
+{
+  _pages = pages;
+  _page_cnt = page_cnt;
+  _published_is_valid = false;
+}
+
+int displayPageFind(const char *name)
+{
+  for (size_t i = 0; i < _page_cnt; i++)
+  {
+    if (strcmp_P(name, _pages[i].name) == 0)
+      return i;
+  }
+  return -1;
+}
+
+bool displayPageName(uint8_t page, char *name, size_t size)
+{
+  if (page >= _page_cnt || size == 0)
+    return false;
+  strncpy_P(name, _pages[page].name, size - 1);
+  name[size - 1] = '\0';
+  return true;
+}
+
+int displayPagesRender(time_t local_time, uint8_t vfd_output[VFD_TUBE_CNT])
+{
+  const vfd_config_t *config = configGet();
+  uint8_t page = 0;
+  uint32_t rotation_s = 0;
+
+  for (unsigned i = 0; i < CONFIG_PAGE_CNT; i++)
+    rotation_s += config->page_s[i];
+  if (rotation_s > 0)
+  {
+    uint32_t position_s = (uint32_t)local_time % rotation_s;
+    for (unsigned i = 0; i < CONFIG_PAGE_CNT; i++)
+    {
+      if (position_s < config->page_s[i])
+      {
+        page = config->page[i];
+        break;
+      }
+      position_s -= config->page_s[i];
+    }
+  }
+  if (page >= _page_cnt)
+    return displayPageTime(local_time, vfd_output);
+  const display_page_render_t render = reinterpret_cast<display_page_render_t>(pgm_read_ptr(&_pages[page].render));
+  return render(local_time, vfd_output);
+}
+
+uint8_t displayPagesUpdate(time_t local_time)
+{
+  uint8_t vfd_output[VFD_TUBE_CNT];
+  const int dots = displayPagesRender(local_time, vfd_output);
+  const uint8_t changed = changed_tubes(vfd_output);
+
+  if (!_published_is_valid || dots != _published_dots)
+    updateVfd(vfd_output, dots);
+  else if (changed != 0)
+    updateVfdTubes(vfd_output, changed);
+  memcpy(_published, vfd_output, sizeof(_published));
+  _published_dots = dots;
+  _published_is_valid = true;
+  return changed;
+}
+
+void displayPagesArm(time_t local_time)
+{
+  _armed_dots = displayPagesRender(local_time, _armed);
+  armVfdFrame(_armed, _armed_dots);
+}
+
+uint8_t displayPagesCommitted()
+{
+  const uint8_t changed = changed_tubes(_armed);
+
+  memcpy(_published, _armed, sizeof(_published));
+  _published_dots = _armed_dots;
+  _published_is_valid = true;
+  return changed;
+}
+
+void displayPagesInvalidate()
+{
+  _published_is_valid = false;
+}
+
+int displayPageTime(time_t local_time, uint8_t vfd_output[VFD_TUBE_CNT])
+{
+  two_digits(vfd_output, 0, second(local_time));
+  two_digits(vfd_output, 2, minute(local_time));
+  two_digits(vfd_output, 4, hour(local_time));
+  return 1000; // Blinking dots with a period of 1000 ms
+}
+
+int displayPageDate(time_t local_time, uint8_t vfd_output[VFD_TUBE_CNT])
+{
+  two_digits(vfd_output, 0, year(local_time) % 100);
+  two_digits(vfd_output, 2, month(local_time));
+  two_digits(vfd_output, 4, day(local_time));
+  return 0; // Dots are permanently turned on
+}
+
+int displayPageUptime(time_t, uint8_t vfd_output[VFD_TUBE_CNT])
+{
+  const uint32_t uptime_min = millis() / 60000UL;
+
+  two_digits(vfd_output, 0, uptime_min % 60);
+  two_digits(vfd_output, 2, uptime_min / 60 % 24);
+  two_digits(vfd_output, 4, min(uptime_min / (60 * 24), (uint32_t)99U));
+  return 0;
+}
+
+int displayPageMessage(time_t, uint8_t vfd_output[VFD_TUBE_CNT])
+{
+  const char *message = configGet()->message;
+  const size_t len = strnlen(message, CONFIG_MESSAGE_LEN);
+
+  for (unsigned i = 0; i < VFD_TUBE_CNT; i++)
+    vfd_output[VFD_TUBE_CNT - 1 - i] = i < len ? getVfdGlyph(message[i]) : VFD_BLANK;
+  return -1; // Dots are turned off
+}
+
+//********************************************************************
+// Local functions
+//********************************************************************
+
+static uint8_t changed_tubes(const uint8_t vfd_output[VFD_TUBE_CNT])
+{
+  uint8_t changed = 0;
+
+  for (unsigned i = 0; i < VFD_TUBE_CNT; i++)
+  {
+    if (vfd_output[i] != _published[i])
+      changed |= 1U << i;
+  }
+  return changed;
+}
+
+// The tube given is the one of the ones.
+static void two_digits(uint8_t vfd_output[VFD_TUBE_CNT], unsigned tube, unsigned value)
+{
+  vfd_output[tube] = value % 10;
+  vfd_output[tube + 1] = value / 10 % 10;
+}
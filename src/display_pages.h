@@ -0,0 +1,108 @@
+/**
+  \file   display_pages.h
+  \brief  Pages shown by the tubes and their rotation.
+
+  What the tubes show is given by a table of pages in flash, like the commands
+  of the shell.  Each page renders the digits of all tubes for a given local
+  time.  The rotation is kept in the runtime configuration: a list of pages,
+  each shown for some seconds.  The rotation starts over on each multiple of
+  its total length, so a rotation of 60 seconds is aligned to the minute.  The
+  default shows the time for 56 seconds and the date for 4 seconds.
+
+  displayPagesUpdate() is called once a second.  It compares the rendered
+  digits with the digits published last and passes only the changed tubes to
+  updateVfdTubes(), so the blinking dots keep their phase.  The whole frame is
+  passed by updateVfd() only if the dots change, e.g. when the page changes.
+
+  Config records keep the index of a page, so new pages have to be appended to
+  the table.
+*/
+#ifndef DISPLAY_PAGES_H
+#define DISPLAY_PAGES_H
+
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include "multiplexing.h"
+
+/**
+ * \brief Page renderer.
+ * \param local_time Local time to be shown.
+ * \param vfd_output[] Receives the digits as used by updateVfd().
+ * \return Dot blinking period as used by updateVfd().
+ */
+typedef int (*display_page_render_t)(time_t local_time, uint8_t vfd_output[VFD_TUBE_CNT]);
+
+/// Entry of the page table.  The table has to be kept in PROGMEM.
+typedef struct
+{
+  char name[12];                ///< Name used by the configuration
+  display_page_render_t render; ///< Function rendering the page
+} display_page_t;
+
+/**
+ * \brief Sets the page table.
+ * \param pages Page table in PROGMEM.
+ * \param page_cnt Count of entries in the page table.
+ */
+void displayPagesBegin(const display_page_t *pages, size_t page_cnt);
+
+/**
+ * \brief Finds a page by name.
+ * \param name Name of the page.
+ * \return Index of the page, -1 if there is none.
+ */
+int displayPageFind(const char *name);
+
+/**
+ * \brief Name of a page.
+ * \param page Index of the page.
+ * \param name Receives the name.
+ * \param size Size of name.
+ * \return false if there is no such page.
+ */
+bool displayPageName(uint8_t page, char *name, size_t size);
+
+/**
+ * \brief Renders the page due by the rotation.
+ * \param local_time Local time to be shown.
+ * \param vfd_output[] Receives the digits.
+ * \return Dot blinking period.
+ */
+int displayPagesRender(time_t local_time, uint8_t vfd_output[VFD_TUBE_CNT]);
+
+/**
+ * \brief Shows the page due by the rotation.  To be called once a second.
+ * \param local_time Local time to be shown.
+ * \return Mask of the tubes that changed.
+ */
+uint8_t displayPagesUpdate(time_t local_time);
+
+/**
+ * \brief Prepares the page of the next second, see armVfdFrame().
+ * \param local_time Local time of the next second.
+ */
+void displayPagesArm(time_t local_time);
+
+/**
+ * \brief Takes note that the frame prepared by displayPagesArm() has been shown.
+ * \return Mask of the tubes that changed.
+ */
+uint8_t displayPagesCommitted();
+
+/// The next update passes the whole frame, e.g. after something else was shown.
+void displayPagesInvalidate();
+
+/// Page HH MM SS with the dots blinking once a second.
+int displayPageTime(time_t local_time, uint8_t vfd_output[VFD_TUBE_CNT]);
+
+/// Page DD MM YY.
+int displayPageDate(time_t local_time, uint8_t vfd_output[VFD_TUBE_CNT]);
+
+/// Page with days, hours and minutes since boot.
+int displayPageUptime(time_t local_time, uint8_t vfd_output[VFD_TUBE_CNT]);
+
+/// Page with the message of the configuration, left aligned.
+int displayPageMessage(time_t local_time, uint8_t vfd_output[VFD_TUBE_CNT]);
+
+#endif // DISPLAY_PAGES_H
@@ -0,0 +1,154 @@
+#include "event_log.h"
+#include "postmortem.h"
+#include "spsc_ring.h"
+
+#include <cstring>
+
+/// Count of records in the ring.
+static const uint16_t EVENT_LOG_RECORD_CNT = 32U;
+/// Maximum length of an output line.
+static const size_t EVENT_LOG_LINE_LEN = 100U;
+/// Version of the hex output, to be checked by the decoder.
+static const unsigned EVENT_LOG_HEX_VERSION = 1U;
+
+// Format strings in flash
+#define EVENT_LOG_FORMAT(id, format) static const char FORMAT_##id[] PROGMEM = format;
+EVENT_LOG_EVENTS(EVENT_LOG_FORMAT)
+#undef EVENT_LOG_FORMAT
+
+#define EVENT_LOG_FORMAT_PTR(id, format) FORMAT_##id,
+static const char *const FORMATS[EV_COUNT] PROGMEM = {EVENT_LOG_EVENTS(EVENT_LOG_FORMAT_PTR)};
+#undef EVENT_LOG_FORMAT_PTR
+
+// Local variables
+static SpscRing<event_record_t, EVENT_LOG_RECORD_CNT> _ring;
+static event_log_mode_e _mode = EVENT_LOG_TEXT;
+static uint16_t _seq;
+static uint32_t _dropped;          // since boot
+static uint32_t _dropped_reported; // already put out as EV_LOG_DROPPED
+static char _line[EVENT_LOG_LINE_LEN];
+static size_t _line_len;
+static size_t _line_pos;
+
+// Local function prototypes
+static size_t format_text(const event_record_t &record, char *line, size_t size);
+static size_t format_hex(const event_record_t &record, char *line, size_t size);
+
+void eventLogRecord(event_id_e id, uint8_t argc, int32_t a0, int32_t a1, int32_t a2)
+{
+  event_record_t record;
+  record.ms = millis();
+  record.seq = _seq++;
+  record.id = id;
+  record.argc = argc;
+  record.arg[0] = a0;
+  record.arg[1] = a1;
+  record.arg[2] = a2;
+  if (!_ring.push(record))
+    _dropped++;
+  postmortemEvent(id, a0);
+}
+
+void eventLogSetMode(event_log_mode_e mode)
+{
+  _mode = mode;
+  if (mode == EVENT_LOG_HEX)
+  { // A line in progress is cut off, the decoder skips it.
+    _line_pos = 0;
+    _line_len = snprintf(_line, sizeof(_line), "\n#H %u %u %u\n", EVENT_LOG_HEX_VERSION, (unsigned)EV_COUNT,
+                         (unsigned)sizeof(event_record_t));
+  }
+}
+
+event_log_mode_e eventLogGetMode()
+{
+  return _mode;
+}
+
+void eventLogPoll(HardwareSerial &out)
+{
+  if (_mode == EVENT_LOG_OFF)
+    return;
+  for (;;)
+  {
+    if (_line_pos == _line_len)
+    {
+      event_record_t record;
+      if (_dropped != _dropped_reported && _ring.size() < _ring.capacity())
+      { // Report the loss in order, there is room for it now.
+        eventLog(EV_LOG_DROPPED, _dropped - _dropped_reported);
+        _dropped_reported = _dropped;
+      }
+      if (!_ring.pop(record))
+        return;
+      _line_pos = 0;
+      if (_mode == EVENT_LOG_HEX)
+        _line_len = format_hex(record, _line, sizeof(_line));
+      else
+        _line_len = format_text(record, _line, sizeof(_line));
+    }
+    // Never more than the FIFO takes without blocking
+    const int room = out.availableForWrite();
+    if (room <= 0)
+      return;
+    const size_t len = min((size_t)room, _line_len - _line_pos);
+    out.write((const uint8_t *)&_line[_line_pos], len);
+    _line_pos += len;
+  }
+}
+
+const char *eventLogFormat(uint8_t id)
+{
+  if (id >= EV_COUNT)
+    return nullptr;
+  return (const char *)pgm_read_ptr(&FORMATS[id]);
+}
+
+uint32_t eventLogDropped()
+{
+  return _dropped;
+}
+
+//********************************************************************
+// Local functions
+//********************************************************************
+
+static size_t format_text(const event_record_t &record, char *line, size_t size)
+{
+  int len = snprintf(line, size, "[%6lu.%03lu] ", (unsigned long)(record.ms / 1000UL),
+                     (unsigned long)(record.ms % 1000UL));
+  const char *format = eventLogFormat(record.id);
+  if (format != nullptr)
+  {
+    len += snprintf_P(line + len, size - len, format, record.arg[0], record.arg[1], record.arg[2]);
+  }
+  else
+  {
+    len += snprintf(line + len, size - len, "unknown event %u", record.id);
+  }
+  if ((size_t)len > size - 2)
+    len = size - 2;
+  line[len++] = '\n';
+  line[len] = '\0';
+  return len;
+}
+
+static size_t format_hex(const event_record_t &record, char *line, size_t size)
+{
+  static const char HEX_DIGITS[] = "0123456789abcdef";
+  const uint8_t *bytes = (const uint8_t *)&record;
+  size_t len = 0;
+
+  if (size < 2 * sizeof(record) + 4)
+    return 0;
+  line[len++] = '#';
+  line[len++] = 'E';
+  for (size_t i = 0; i < sizeof(record); i++)
+  {
+    line[len++] = HEX_DIGITS[bytes[i] >> 4];
+    line[len++] = HEX_DIGITS[bytes[i] & 0x0F];
+  }
+  line[len++] = '\n';
+  line[len] = '\0';
+  return len;
+}
@@ -0,0 +1,128 @@
+/**
+  \file   event_log.h
+  \brief  Deferred binary event log.
+
+  Printing a line of 80 characters at 115200 baud blocks the caller for about
+  7 ms once the transmit FIFO of the UART is full.  So the time critical paths
+  do not print.  They record an event ID and up to three integer arguments into
+  a RAM ring instead, which takes constant time.  eventLogPoll() is called from
+  loop() and hands the records to the UART only as far as its transmit FIFO has
+  room, so it never blocks either.
+
+  The format strings are kept in flash.  In text mode the records are formatted
+  on the clock.  In hex mode each record is put out as a line "#E" followed by
+  the record in hex, and tools/vfd_logdecode.py turns a capture of the terminal
+  into text.  The decoder takes the format strings from EVENT_LOG_EVENTS below,
+  so new events have to be appended at the end of the list only.
+
+  Every event is mirrored into the post-mortem kept in the RTC user memory, see
+  postmortem.h, so only significant events should be recorded.
+
+  Records are dropped if the ring is full.  The count of dropped records is put
+  out as an event of its own as soon as there is room again.
+
+  eventLog() is meant to be called from the loop() context only.  It is not
+  safe to be called from an interrupt.
+*/
+#ifndef EVENT_LOG_H
+#define EVENT_LOG_H
+
+#include <Arduino.h>
+#include <cstdint>
+
+/**
+ * \brief List of the events as X(id, format).
+ *
+ * The format is a printf() format string taking up to three int arguments.
+ * Append new events at the end, the position is the ID used in hex mode.
+ */
+#define EVENT_LOG_EVENTS(X)                                                               \
+  X(EV_LOG_DROPPED, "%d log records dropped")                                             \
+  X(EV_RTC_READ, "RTC read %d UTC")                                                       \
+  X(EV_NVRAM_LOADED, "Sync state from RTC RAM: last NTP sync @%d UTC, RTC drift %d ppb")  \
+  X(EV_NVRAM_INVALID, "No valid sync state in RTC RAM")                                   \
+  X(EV_NVRAM_STORE_FAILED, "Unable to store sync state in RTC RAM")                       \
+  X(EV_WARM_START, "Using drift corrected RTC @%d UTC, NTP query deferred")               \
+  X(EV_NTP_SYNC, "Time from NTP server @%d UTC, synchronized RTC")                        \
+  X(EV_NTP_FAILED, "No NTP reply, syncing with internal RTC @%d UTC")                     \
+  X(EV_RTC_SET, "RTC set to %d UTC")                                                      \
+  X(EV_BOOT, "Boot %d, reset reason %d")                                                  \
+  X(EV_LOW_MEMORY, "Low memory: largest block %d bytes, %d bytes free, %d %% fragmented") \
+  X(EV_NTP_PEER, "NTP server found in the LAN, host .%d")                                 \
+  X(EV_OTA_RESULT, "Firmware update finished with result %d")                             \
+  X(EV_RADIO_OFF, "Radio off in idle time, wake-up @%d UTC")                              \
+  X(EV_RADIO_ON, "Radio on, connected %d ms after wake-up")                               \
+  X(EV_RADIO_TIMEOUT, "Radio on, no connection %d ms after wake-up")                      \
+  X(EV_RADIO_SYNC, "First sync %d ms after wake-up, %d late syncs")                      \
+  X(EV_HEAP_WALK_OFF, "Heap walk found %d bytes free, the core %d, using the core")
+
+/// Event IDs
+typedef enum
+{
+#define EVENT_LOG_ID(id, format) id,
+  EVENT_LOG_EVENTS(EVENT_LOG_ID)
+#undef EVENT_LOG_ID
+      EV_COUNT ///< Count of events, not an event
+} event_id_e;
+
+/// Output mode of eventLogPoll()
+typedef enum
+{
+  EVENT_LOG_OFF = 0, ///< Records are kept in the ring and dropped when it is full
+  EVENT_LOG_TEXT,    ///< Records are formatted on the clock
+  EVENT_LOG_HEX      ///< Records are put out in hex for tools/vfd_logdecode.py
+} event_log_mode_e;
+
+/// Record as stored in the ring and put out in hex mode (little endian).
+typedef struct
+{
+  uint32_t ms;     ///< millis() when the event was recorded
+  uint16_t seq;    ///< Sequence number, gaps show dropped records
+  uint8_t id;      ///< event_id_e
+  uint8_t argc;    ///< Count of valid arguments
+  int32_t arg[3];  ///< Arguments of the format string
+} event_record_t;
+
+/**
+ * \brief Records an event.  Takes constant time and never blocks.
+ * \param id Event ID.
+ * \param argc Count of arguments.
+ * \param a0,a1,a2 Arguments of the format string.
+ */
+void eventLogRecord(event_id_e id, uint8_t argc, int32_t a0, int32_t a1, int32_t a2);
+
+/// Records an event without arguments.
+inline void eventLog(event_id_e id) { eventLogRecord(id, 0, 0, 0, 0); }
+/// Records an event with one argument.
+inline void eventLog(event_id_e id, int32_t a0) { eventLogRecord(id, 1, a0, 0, 0); }
+/// Records an event with two arguments.
+inline void eventLog(event_id_e id, int32_t a0, int32_t a1) { eventLogRecord(id, 2, a0, a1, 0); }
+/// Records an event with three arguments.
+inline void eventLog(event_id_e id, int32_t a0, int32_t a1, int32_t a2) { eventLogRecord(id, 3, a0, a1, a2); }
+
+/**
+ * \brief Selects the output of eventLogPoll().
+ * \param mode Output mode.  Selecting EVENT_LOG_HEX puts out a "#H" header line for the decoder.
+ */
+void eventLogSetMode(event_log_mode_e mode);
+
+/// Output mode selected last.
+event_log_mode_e eventLogGetMode();
+
+/**
+ * \brief Puts out recorded events as far as the transmit FIFO has room.  To be called from loop().
+ * \param out Serial port to be used.
+ */
+void eventLogPoll(HardwareSerial &out);
+
+/**
+ * \brief Format string of an event.
+ * \param id Event ID.
+ * \return Format string in PROGMEM, nullptr if the ID is unknown.
+ */
+const char *eventLogFormat(uint8_t id);
+
+/// Count of records dropped since boot.
+uint32_t eventLogDropped();
+
+#endif // EVENT_LOG_H
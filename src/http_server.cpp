@@ -0,0 +1,382 @@
+#include "http_server.h"
+
+#include <ESP8266WiFi.h>
+#include <WiFiClient.h>
+#include <WiFiServer.h>
+#include <cctype>
+#include <cstdarg>
+#include <cstring>
+
+/// Room needed in the send buffer for a part, its chunk framing and the headers.
+static const int PART_ROOM = 2 * HTTP_PART_LEN;
+static const size_t REQUEST_LINE_LEN = 8U + HTTP_PATH_LEN + HTTP_QUERY_LEN + 12U;
+
+/// Response in progress
+struct http_response_s
+{
+  uint16_t status;
+  uint8_t content_type;
+  bool headers_sent;
+  bool chunked;
+};
+
+/// State of the connection
+typedef enum
+{
+  HTTP_IDLE = 0,
+  HTTP_READING,
+  HTTP_RESPONDING
+} http_state_e;
+
+// Local variables
+static WiFiServer *_server;
+static const http_route_t *_routes;
+static size_t _route_cnt;
+static WiFiClient _client;
+static http_state_e _state;
+static unsigned long _start_ms;
+static char _line[REQUEST_LINE_LEN];
+static size_t _line_len;
+static bool _line_complete;
+static uint8_t _blank_line_match; // count of line end characters seen in a row
+static http_request_t _request;
+static http_response_t _response;
+static http_handler_t _handler;
+static uint16_t _part;
+static char _buffer[HTTP_PART_LEN];
+
+// Local function prototypes
+static void read_request();
+static bool parse_request_line();
+static void respond();
+static void finish();
+static bool not_found(const http_request_t *request, http_response_t *response, uint16_t part);
+static void send_headers(http_response_t *response);
+static void send_part(http_response_t *response, const char *data, size_t len, bool is_progmem);
+static size_t url_decode(const char *src, size_t src_len, char *dst, size_t dst_size);
+
+void httpServerBegin(const http_route_t *routes, size_t route_cnt, uint16_t port)
+{
+  static WiFiServer server(port);
+
+  _routes = routes;
+  _route_cnt = route_cnt;
+  _server = &server;
+  _server->begin();
+  _server->setNoDelay(true);
+}
+
+void httpServerPoll()
+{
+  if (_server == nullptr)
+    return;
+  switch (_state)
+  {
+  case HTTP_IDLE:
+    if (!_server->hasClient())
+      return;
+    _client = _server->available();
+    _start_ms = millis();
+    _line_len = 0;
+    _line_complete = false;
+    _blank_line_match = 0;
+    _state = HTTP_READING;
+    break;
+  case HTTP_READING:
+    read_request();
+    break;
+  case HTTP_RESPONDING:
+    respond();
+    break;
+  }
+}
+
+void httpSetStatus(http_response_t *response, uint16_t status)
+{
+  if (!response->headers_sent)
+    response->status = status;
+}
+
+void httpSend_P(http_response_t *response, PGM_P data)
+{
+  send_part(response, data, strlen_P(data), true);
+}
+
+void httpPrintf_P(http_response_t *response, PGM_P format, ...)
+{
+  va_list args;
+
+  va_start(args, format);
+  const int len = vsnprintf_P(_buffer, sizeof(_buffer), format, args);
+  va_end(args);
+  if (len > 0)
+    send_part(response, _buffer, min((size_t)len, sizeof(_buffer) - 1), false);
+}
+
+void httpJsonEscape(char *dst, size_t dst_size, const char *src, size_t src_len)
+{
+  size_t len = 0;
+
+  if (dst_size == 0)
+    return;
+  for (size_t i = 0; i < src_len && src[i] != '\0'; i++)
+  {
+    const unsigned char c = src[i];
+    char escaped[7];
+    size_t escaped_len;
+    if (c == '"' || c == '\\')
+    {
+      escaped[0] = '\\';
+      escaped[1] = c;
+      escaped_len = 2;
+    }
+    else if (c < 0x20)
+      escaped_len = snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+    else
+    {
+      escaped[0] = c;
+      escaped_len = 1;
+    }
+    if (len + escaped_len >= dst_size)
+      break;
+    memcpy(dst + len, escaped, escaped_len);
+    len += escaped_len;
+  }
+  dst[len] = '\0';
+}
+
+bool httpNextParam(const http_request_t *request, size_t *pos, char *name, size_t name_size, char *value,
+                   size_t value_size)
+{
+  const char *query = request->query;
+  const size_t query_len = strlen(query);
+
+  while (*pos < query_len)
+  {
+    const char *param = query + *pos;
+    const size_t param_len = strcspn(param, "&");
+    *pos += param_len + 1;
+    if (param_len == 0)
+      continue;
+    const char *equals = (const char *)memchr(param, '=', param_len);
+    const size_t name_len = equals != nullptr ? (size_t)(equals - param) : param_len;
+    url_decode(param, name_len, name, name_size);
+    if (equals != nullptr)
+      url_decode(equals + 1, param_len - name_len - 1, value, value_size);
+    else if (value_size > 0)
+      value[0] = '\0';
+    return true;
+  }
+  return false;
+}
+
+//********************************************************************
+// Local functions
+//********************************************************************
+
+// Request line and headers, the headers are skipped.
+static void read_request()
+{
+  if (!_client.connected() || millis() - _start_ms > HTTP_TIMEOUT_MS)
+  {
+    _client.stop();
+    _state = HTTP_IDLE;
+    return;
+  }
+  for (size_t budget = HTTP_READ_BUDGET; budget > 0; budget--)
+  {
+    const int c = _client.read();
+    if (c < 0)
+      return;
+    if (!_line_complete)
+    {
+      if (c == '\n')
+      {
+        _line_complete = true;
+        _blank_line_match = 1;
+      }
+      else if (c != '\r' && _line_len < sizeof(_line) - 1)
+        _line[_line_len++] = c;
+      continue;
+    }
+    // The headers end with an empty line.
+    if (c == '\n')
+      _blank_line_match++;
+    else if (c != '\r')
+      _blank_line_match = 0;
+    if (_blank_line_match == 2)
+      break;
+  }
+  if (_blank_line_match < 2)
+    return;
+
+  _response.status = 200;
+  _response.headers_sent = false;
+  _response.chunked = false;
+  _response.content_type = HTTP_JSON;
+  _handler = not_found;
+  if (parse_request_line())
+  {
+    for (size_t i = 0; i < _route_cnt; i++)
+    {
+      if (strcmp_P(_request.path, _routes[i].path) == 0)
+      {
+        _handler = reinterpret_cast<http_handler_t>(pgm_read_ptr(&_routes[i].handler));
+        _response.content_type = pgm_read_byte(&_routes[i].content_type);
+        break;
+      }
+    }
+  }
+  else
+  {
+    _response.status = 400;
+  }
+  _part = 0;
+  _state = HTTP_RESPONDING;
+}
+
+// "GET /path?query HTTP/1.1"
+static bool parse_request_line()
+{
+  char *target;
+
+  _line[_line_len] = '\0';
+  if (strncmp(_line, "GET ", 4) == 0)
+  {
+    _request.method = HTTP_GET;
+    target = _line + 4;
+  }
+  else if (strncmp(_line, "POST ", 5) == 0)
+  {
+    _request.method = HTTP_POST;
+    target = _line + 5;
+  }
+  else
+    return false;
+  char *version = strchr(target, ' ');
+  if (version == nullptr)
+    return false;
+  *version++ = '\0';
+  _response.chunked = strcmp(version, "HTTP/1.0") != 0;
+  char *query = strchr(target, '?');
+  if (query != nullptr)
+    *query++ = '\0';
+  if (strlen(target) >= sizeof(_request.path))
+    return false;
+  strcpy(_request.path, target);
+  strncpy(_request.query, query != nullptr ? query : "", sizeof(_request.query) - 1);
+  _request.query[sizeof(_request.query) - 1] = '\0';
+  return true;
+}
+
+static void respond()
+{
+  if (!_client.connected())
+  {
+    _client.stop();
+    _state = HTTP_IDLE;
+    return;
+  }
+  for (uint8_t i = 0; i < HTTP_PARTS_PER_POLL; i++)
+  {
+    // Never more than the send buffer takes without waiting
+    if (_client.availableForWrite() < PART_ROOM)
+      return;
+    if (!_handler(&_request, &_response, _part++))
+    {
+      finish();
+      return;
+    }
+  }
+}
+
+static void finish()
+{
+  send_headers(&_response); // for an empty body
+  if (_response.chunked)
+    _client.write((const uint8_t *)"0\r\n\r\n", 5);
+  _client.stop();
+  _state = HTTP_IDLE;
+}
+
+static bool not_found(const http_request_t *, http_response_t *response, uint16_t part)
+{
+  if (response->status == 200)
+    httpSetStatus(response, 404);
+  if (part == 0)
+    httpPrintf_P(response, PSTR("{\"error\":%u}\n"), response->status);
+  return false;
+}
+
+static void send_headers(http_response_t *response)
+{
+  static const char *const CONTENT_TYPES[] = {"application/json", "text/html", "text/plain"};
+
+  if (response->headers_sent)
+    return;
+  response->headers_sent = true;
+  const char *reason;
+  switch (response->status)
+  {
+  case 200:
+    reason = "OK";
+    break;
+  case 400:
+    reason = "Bad Request";
+    break;
+  case 403:
+    reason = "Forbidden";
+    break;
+  case 404:
+    reason = "Not Found";
+    break;
+  case 405:
+    reason = "Method Not Allowed";
+    break;
+  default:
+    reason = "Error";
+    break;
+  }
+  _client.printf_P(PSTR("HTTP/1.1 %u %s\r\nContent-Type: %s\r\n%sConnection: close\r\nCache-Control: no-cache\r\n\r\n"),
+                   response->status, reason, CONTENT_TYPES[response->content_type % 3],
+                   response->chunked ? "Transfer-Encoding: chunked\r\n" : "");
+}
+
+static void send_part(http_response_t *response, const char *data, size_t len, bool is_progmem)
+{
+  send_headers(response);
+  if (len == 0)
+    return; // an empty chunk would end the body
+  if (response->chunked)
+    _client.printf("%x\r\n", len);
+  if (is_progmem)
+    _client.write_P(data, len);
+  else
+    _client.write((const uint8_t *)data, len);
+  if (response->chunked)
+    _client.write((const uint8_t *)"\r\n", 2);
+}
+
+static size_t url_decode(const char *src, size_t src_len, char *dst, size_t dst_size)
+{
+  size_t len = 0;
+
+  if (dst_size == 0)
+    return 0;
+  for (size_t i = 0; i < src_len && len < dst_size - 1; i++)
+  {
+    char c = src[i];
+    if (c == '+')
+      c = ' ';
+    else if (c == '%' && i + 2 < src_len && isxdigit((unsigned char)src[i + 1]) &&
+             isxdigit((unsigned char)src[i + 2]))
+    {
+      const char hex[3] = {src[i + 1], src[i + 2], '\0'};
+      c = (char)strtol(hex, nullptr, 16);
+      i += 2;
+    }
+    dst[len++] = c;
+  }
+  dst[len] = '\0';
+  return len;
+}
@@ -0,0 +1,143 @@
+/**
+  \file   http_server.h
+  \brief  Minimal non-blocking HTTP server for status and configuration.
+
+  The server handles one connection at a time and is driven by httpServerPoll()
+  from loop().  Each call reads at most HTTP_READ_BUDGET bytes of the request or
+  sends at most HTTP_PARTS_PER_POLL parts of the response, and only as far as
+  the TCP send buffer has room.  So a slow client never delays the display.
+
+  GET and POST requests are supported, parameters are passed in the query string
+  and a body is ignored.  The handler decides by the method whether a request
+  may change the clock.  The routes are given by a constant table in flash like
+  the commands of the shell.  A handler produces the response body in parts, it
+  is called again with the next part number until it returns false.  Static parts are sent
+  directly from PROGMEM by httpSend_P(), dynamic parts are formatted into a
+  fixed buffer of HTTP_PART_LEN bytes by httpPrintf_P().  HTTP/1.1 clients get
+  the response with chunked encoding, nothing is allocated per request.
+*/
+#ifndef HTTP_SERVER_H
+#define HTTP_SERVER_H
+
+#include <Arduino.h>
+#include <cstddef>
+#include <cstdint>
+
+/// Maximum length of a dynamic part of a response.
+const size_t HTTP_PART_LEN = 160U;
+/// Maximum length of the path of a request.
+const size_t HTTP_PATH_LEN = 24U;
+/// Maximum length of the query string of a request.
+const size_t HTTP_QUERY_LEN = 160U;
+/// Bytes of a request read per poll at most.
+const size_t HTTP_READ_BUDGET = 256U;
+/// Parts of a response sent per poll at most.
+const uint8_t HTTP_PARTS_PER_POLL = 2U;
+/// A connection is closed if the request is not complete within this time.
+const unsigned long HTTP_TIMEOUT_MS = 3000UL;
+
+/// Content types of the routes
+typedef enum
+{
+  HTTP_JSON = 0, ///< application/json
+  HTTP_HTML,     ///< text/html
+  HTTP_TEXT      ///< text/plain
+} http_content_type_e;
+
+/// Methods of a request
+typedef enum
+{
+  HTTP_GET = 0, ///< Reads only
+  HTTP_POST     ///< May change the clock
+} http_method_e;
+
+/// Request as parsed by the server
+typedef struct
+{
+  uint8_t method;             ///< http_method_e
+  char path[HTTP_PATH_LEN];   ///< Path without query string
+  char query[HTTP_QUERY_LEN]; ///< Query string without '?', still URL encoded
+} http_request_t;
+
+/// Response in progress, see httpSend_P() and httpPrintf_P()
+typedef struct http_response_s http_response_t;
+
+/**
+ * \brief Route handler.
+ * \param request Request, the same for all parts.
+ * \param response Response to be written by httpSend_P() or httpPrintf_P().
+ * \param part 0 for the first call, incremented for each further call.
+ * \return true if there are further parts.
+ *
+ * A part should not exceed HTTP_PART_LEN bytes, the server calls the handler only if the send
+ * buffer has room for that.  The status of the response can be changed by httpSetStatus() as long
+ * as nothing has been sent.
+ */
+typedef bool (*http_handler_t)(const http_request_t *request, http_response_t *response, uint16_t part);
+
+/// Entry of the route table.  The table has to be kept in PROGMEM.
+typedef struct
+{
+  char path[HTTP_PATH_LEN]; ///< Path to be matched exactly
+  uint8_t content_type;     ///< http_content_type_e
+  http_handler_t handler;   ///< Function producing the response
+} http_route_t;
+
+/**
+ * \brief Starts the server.
+ * \param routes Route table in PROGMEM.
+ * \param route_cnt Count of entries in the route table.
+ * \param port TCP port to listen on.
+ */
+void httpServerBegin(const http_route_t *routes, size_t route_cnt, uint16_t port = 80U);
+
+/// Serves the connection in progress.  To be called from loop().
+void httpServerPoll();
+
+/**
+ * \brief Sets the status of the response.
+ * \param response Response of the handler.
+ * \param status HTTP status code, e.g. 400.
+ */
+void httpSetStatus(http_response_t *response, uint16_t status);
+
+/**
+ * \brief Sends a part of the response from PROGMEM.
+ * \param response Response of the handler.
+ * \param data Zero terminated data in PROGMEM.
+ */
+void httpSend_P(http_response_t *response, PGM_P data);
+
+/**
+ * \brief Sends a formatted part of the response.
+ * \param response Response of the handler.
+ * \param format printf() format string in PROGMEM.  The result is cut to HTTP_PART_LEN bytes.
+ */
+void httpPrintf_P(http_response_t *response, PGM_P format, ...) __attribute__((format(printf, 2, 3)));
+
+/**
+ * \brief Fetches the next parameter of the query string.
+ * \param request Request of the handler.
+ * \param pos Position in the query string, 0 for the first parameter.
+ * \param name Receives the URL decoded name.
+ * \param name_size Size of name.
+ * \param value Receives the URL decoded value.
+ * \param value_size Size of value.
+ * \return false if there are no further parameters.
+ */
+bool httpNextParam(const http_request_t *request, size_t *pos, char *name, size_t name_size, char *value,
+                   size_t value_size);
+
+/**
+ * \brief Escapes a text for a JSON string.
+ * \param dst Receives the escaped text, always zero terminated.
+ * \param dst_size Size of dst, 6 times the length of the text suffice for any text.
+ * \param src Text, ends at a zero or after src_len characters.
+ * \param src_len Maximum length of the text.
+ *
+ * Quotes, backslashes and control characters are escaped.  A text too long for dst is cut, never within
+ * an escape sequence.
+ */
+void httpJsonEscape(char *dst, size_t dst_size, const char *src, size_t src_len);
+
+#endif // HTTP_SERVER_H
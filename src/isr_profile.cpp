@@ -0,0 +1,123 @@
+#include "isr_profile.h"
+
+#include "multiplexing.h"
+
+/// Time of flash accesses per call of isrProfilePoll(), loop() gets the rest.
+static const uint32_t ISR_PROFILE_BURST_MS = 20UL;
+static const uint32_t ISR_PROFILE_ERASE_MS = 1000UL;
+static const size_t ISR_PROFILE_BLOCK_SIZE = 256U;
+
+/// Phases of a measurement
+typedef enum
+{
+  PROFILE_IDLE,
+  PROFILE_QUIET, ///< Reference without flash accesses
+  PROFILE_LOAD   ///< Flash accesses in loop()
+} profile_phase_e;
+
+// Local variables
+static profile_phase_e _phase = PROFILE_IDLE;
+static uint32_t _phase_ms;
+static uint32_t _start_ms;
+static bool _erase;
+static uint32_t _free_start;
+static uint32_t _free_end;
+static uint32_t _address;
+static uint32_t _last_erase_ms;
+static uint32_t _read_blocks;
+static uint32_t _erased_sectors;
+static uint32_t _failures;
+static vfd_isr_stats_t _quiet;
+static uint32_t _block[ISR_PROFILE_BLOCK_SIZE / sizeof(uint32_t)];
+
+// Local function prototypes
+static void load_flash(uint32_t now_ms);
+static void print_stats(HardwareSerial &out, const __FlashStringHelper *phase, const vfd_isr_stats_t &stats);
+
+bool isrProfileStart(uint16_t seconds, bool erase)
+{
+  _free_start = (ESP.getSketchSize() + FLASH_SECTOR_SIZE - 1) & ~(FLASH_SECTOR_SIZE - 1);
+  _free_end = _free_start + ESP.getFreeSketchSpace();
+  if (_free_end < _free_start + FLASH_SECTOR_SIZE)
+    return false;
+  _phase_ms = min(seconds, ISR_PROFILE_MAX_S) * 1000UL;
+  _erase = erase;
+  _address = _free_start;
+  _read_blocks = 0;
+  _erased_sectors = 0;
+  _failures = 0;
+  _start_ms = millis();
+  _last_erase_ms = _start_ms;
+  vfd_isr_stats_t stats;
+  getVfdIsrPeak(&stats, true);
+  _phase = PROFILE_QUIET;
+  return true;
+}
+
+void isrProfilePoll(HardwareSerial &out)
+{
+  const uint32_t now_ms = millis();
+
+  switch (_phase)
+  {
+  case PROFILE_IDLE:
+    break;
+  case PROFILE_QUIET:
+    if (now_ms - _start_ms < _phase_ms)
+      break;
+    getVfdIsrPeak(&_quiet, true);
+    _start_ms = now_ms;
+    _phase = PROFILE_LOAD;
+    break;
+  case PROFILE_LOAD:
+    if (now_ms - _start_ms < _phase_ms)
+    {
+      load_flash(now_ms);
+      break;
+    }
+    vfd_isr_stats_t loaded;
+    getVfdIsrPeak(&loaded, true);
+    _phase = PROFILE_IDLE;
+    print_stats(out, F("quiet"), _quiet);
+    print_stats(out, F("flash load"), loaded);
+    out.printf_P(PSTR("%u blocks of %u bytes read, %u sectors erased, %u failures\n"), _read_blocks,
+                 ISR_PROFILE_BLOCK_SIZE, _erased_sectors, _failures);
+    break;
+  }
+}
+
+//********************************************************************
+// Local functions
+//********************************************************************
+
+// Reads the free flash for a burst, erases and writes its last sector now and then.
+static void load_flash(uint32_t now_ms)
+{
+  if (_erase && now_ms - _last_erase_ms >= ISR_PROFILE_ERASE_MS)
+  {
+    _last_erase_ms = now_ms;
+    const uint32_t sector_address = _free_end - FLASH_SECTOR_SIZE;
+    if (ESP.flashEraseSector(sector_address / FLASH_SECTOR_SIZE) &&
+        ESP.flashWrite(sector_address, _block, sizeof(_block)))
+      _erased_sectors++;
+    else
+      _failures++;
+  }
+  while (millis() - now_ms < ISR_PROFILE_BURST_MS)
+  {
+    if (ESP.flashRead(_address, _block, sizeof(_block)))
+      _read_blocks++;
+    else
+      _failures++;
+    _address += sizeof(_block);
+    if (_address >= _free_end)
+      _address = _free_start;
+  }
+}
+
+static void print_stats(HardwareSerial &out, const __FlashStringHelper *phase, const vfd_isr_stats_t &stats)
+{
+  out.print(F("ISR "));
+  out.print(phase);
+  out.printf_P(PSTR(": max %u us, jitter max %u us, %u slots\n"), stats.max_us, stats.max_jitter_us, stats.slots);
+}
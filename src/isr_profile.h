@@ -0,0 +1,39 @@
+/**
+  \file   isr_profile.h
+  \brief  Worst-case run time of the display ISR while the flash is busy.
+
+  Reading, erasing or writing the SPI flash turns its cache off.  The display
+  ISR keeps running at that time, so everything it touches has to be in IRAM or
+  DRAM (see tools/isr_sections.py), and it is delayed by the flash operations
+  of the SDK.  isrProfileStart() measures the ISR for the given time without
+  load, then for the same time while loop() reads the free flash behind the
+  firmware in bursts.  Optionally a sector at the end of the free flash is
+  erased and written once a second, which is the longest time the cache is
+  off.  The results come from getVfdIsrPeak(), the telemetry is not disturbed.
+
+  Erasing destroys a firmware image waiting for the restart to be installed.
+*/
+#ifndef ISR_PROFILE_H
+#define ISR_PROFILE_H
+
+#include <Arduino.h>
+#include <cstdint>
+
+/// Longest measuring time of each phase in seconds.
+const uint16_t ISR_PROFILE_MAX_S = 300U;
+
+/**
+ * \brief Starts a measurement, a running one is replaced.
+ * \param seconds Time of each phase, limited to ISR_PROFILE_MAX_S.
+ * \param erase If true a flash sector is erased and written once a second.
+ * \return false if there is no free flash.
+ */
+bool isrProfileStart(uint16_t seconds, bool erase);
+
+/**
+ * \brief Puts load on the flash and reports the results at the end.  To be called from loop().
+ * \param out UART for the results.
+ */
+void isrProfilePoll(HardwareSerial &out);
+
+#endif // ISR_PROFILE_H
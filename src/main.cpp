@@ -53,8 +53,24 @@
 #include <WiFiManager.h>
 
 // VFD tube stuff
+#include "animations.h"
+#include "config_store.h"
+#include "display_pages.h"
+#include "event_log.h"
+#include "http_server.h"
 #include "hv5812.h"
+#include "isr_profile.h"
+#include "mem_monitor.h"
 #include "multiplexing.h"
+#include "ntp_server.h"
+#include "ota_update.h"
+#include "postmortem.h"
+#include "radio_power.h"
+#include "rtc_nvram.h"
+#include "rtc_sqw.h"
+#include "shell.h"
+#include "telemetry.h"
+#include "vfd_trace.h"
 
 #include <string>
 #include <cstdint>
@@ -76,6 +92,8 @@
  *
  * The configuration of WiFi is described in the README.md file.
  *
+ * This is only the default for a clock without a stored runtime configuration, see config_store.h.
+ *
  * Hinweis: Auf Messen bitte SUPPORT_WIFI_NTP_SYNC auskommentieren, falls die Uhr ohne WiFi laufen soll.
  */
 #define SUPPORT_WIFI_NTP_SYNC
@@ -86,19 +104,39 @@
  * \sa    is_idle_time()
  *
  * As a default the clock supports power saving.  The settings are defined in is_idle_time().  If you like to
- * run the clock around the clock comment this.
+ * run the clock around the clock comment this.  This is only the default for a clock without a stored runtime
+ * configuration, see config_store.h.
  *
  * Hinweis: Auf Messen bitte SUPPORT_POWER_SAVE_MODE auskommentieren, falls die Uhr 24/7 laufen soll.
  */
 #define SUPPORT_POWER_SAVE_MODE
 
+/**
+ * \def   SUPPORT_RTC_SQW_TICK
+ * \brief Seconds tick from the 1 Hz square wave of the DS1307.
+ * \sa    rtc_sqw.h
+ *
+ * If the SQW/OUT pin of the DS1307 is connected to IODEF_RTC_SQW the display can be driven by its 1 Hz
+ * output.  The second transitions are phase locked to the RTC then and loop() sleeps between the ticks.
+ * Without this hardware modification the seconds are counted by the system time.  The drift correction kept in
+ * the RTC NVRAM is applied to the ticks as well.
+ *
+ * Caution: The ESP-01 has no free GPIO without a boot strapping function, so IODEF_RTC_SQW is GPIO0.  The DS1307
+ * keeps the square wave running on its battery, and a reset while SQW/OUT is low starts the ROM boot loader.
+ * The square wave is enabled only after the boot and rtcSqwEnd() parks SQW/OUT high before every restart done by
+ * the firmware.  A crash, a hardware watchdog reset or a power on may still hit the low half of the second, the
+ * clock has to be reset once more then.
+ */
+#define SUPPORT_RTC_SQW_TICK
+
 #else
 #define SUPPORT_WIFI_NTP_SYNC   // Comment this if you are not going to use WiFi.
 #define SUPPORT_POWER_SAVE_MODE // Comment this if you are not going to use power saving.
+//#define SUPPORT_RTC_SQW_TICK  // Uncomment this if SQW/OUT of the RTC is connected to IODEF_RTC_SQW.
 #endif                          // DOXYGEN
 
 #define UART_BAUDRATE 115200UL ///< UART baudrate for info messages and the VFD Clock debug terminal.
-#define UART_DEBUG 1           ///< Activate the VFD Clock debug terminal.
+#define UART_DEBUG 1           ///< Activate the VFD Clock debug terminal (default of the runtime configuration).
 
 /**
  * \brief Power switch setting.
@@ -111,9 +149,10 @@ typedef enum
 } power_switch_e;
 
 /// The URL of the NTP server to be used for clock synchronization.  You are advised to use the address of a NTP pool.
+/// This is the default of the runtime configuration.
 constexpr char NTP_SERVER_NAME_STR[] = "europe.pool.ntp.org";
 
-// Central European Time (Frankfurt, Paris)
+// Central European Time (Frankfurt, Paris), default of the runtime configuration
 const TimeChangeRule CEST = {"CEST", Last, Sun, Mar, 2, 120}; ///< Rule for the Central European Summer Time.
 const TimeChangeRule CET = {"CET ", Last, Sun, Oct, 3, 60};   ///< Rule for the Central European Standard Time.
 Timezone CE(CEST, CET);                                       ///< Timezone object needed by the local time functions.
@@ -128,7 +167,7 @@ Timezone CE(CEST, CET);                                       ///< Timezone obje
   After this just open a new browser page to enter the WiFiManager configuration page.  You can do a network
   scan and type your new network configuration credentials there.
  */
-const String AP_NAME = "VFD-CLOCK_" + String(ESP.getChipId());
+static char AP_NAME[24]; ///< Filled in by setup(), there is no heap allocation at static initialization.
 const char *AP_PASSWORD = "admin"; ///< \todo TODO: Malfunctional at this moment.
 
 #define IODEF_VFD_DRIVER_BLANKING 16 ///< Blanking input
@@ -136,18 +175,135 @@ const char *AP_PASSWORD = "admin"; ///< \todo TODO: Malfunctional at this moment
 #define IODEF_VFD_DRIVER_CLOCK 12    ///< Clock input
 #define IODEF_VFD_DRIVER_SDATA_IN 13 ///< Serial data input
 #define IODEF_VFD_HEATING 2          ///< Enable input of the switching regulator (heating)
+#define IODEF_RTC_SQW 0              ///< SQW/OUT of the DS1307 (open drain, pulled up), boot strapping pin
+
+#define RTC_SQW_IDLE_MS 10UL ///< Sleeping time of loop() while waiting for the next SQW tick.
+
+/// Tubes with a roll-over transition when their digit changes.  The seconds change too often for this.
+static const uint8_t ROLL_OVER_TUBES = VFD_ALL_TUBES & ~0x03U;
 
 // UDP settings for NTP socket
 static WiFiUDP _udp;
-static const unsigned int UDP_LOCAL_PORT = 2390; //local port to listen for UDP packets
+static const unsigned int UDP_LOCAL_PORT = 2390; //local port to listen for UDP packets (default)
+
+/// Interval of the telemetry datagrams (default).  The collector is not set by default.
+static const uint16_t TELEMETRY_INTERVAL_S = 60U;
+static const uint16_t TELEMETRY_PORT = 4210U;
+static const unsigned long NTP_REPLY_TIMEOUT_MS = 1000UL; ///< Waiting time for a NTP reply
+static const uint8_t NTP_DISCOVERY_BACKOFF = 12U;         ///< Sync rounds without discovery after a failed one
+
+/// Restart if the largest free heap block stays below this size (default).  NTP and WiFi need about 2 KB.
+static const uint16_t LOW_HEAP_BYTES = 3072U;
+
+/// Interval of the NTP sync while the radio is on (the default of TimeLib).
+static const time_t NTP_SYNC_INTERVAL_S = 300;
+/// Interval of the NTP sync while the radio is turned off in idle time.
+static const time_t IDLE_SYNC_INTERVAL_S = 3L * 3600L;
+/// The radio is turned on this time before the display.
+static const time_t RADIO_WAKE_LEAD_S = 120;
+/// Sleeping time of loop() while display and radio are off.
+static const unsigned long IDLE_LOOP_DELAY_MS = 100UL;
+
+/// A warm start within this time after the last NTP sync does not need to wait for a NTP server.
+static const uint32_t WARM_START_MAX_AGE_S = 24UL * 3600UL;
+
+/// Largest UTC offset of a time change rule in minutes, UTC-14 to UTC+14 cover all time zones.
+static const int RULE_OFFSET_MAX_MIN = 840;
+
+// Synchronization state, see rtc_nvram.h
+static rtc_nvram_state_t _sync_state;
+static bool _sync_state_valid;
+static telemetry_sync_source_e _sync_source;
+static uint16_t _rtc_fallbacks;
+static uint16_t _ntp_delay_ms;
+static bool _ntp_from_peer;
+static IPAddress _ntp_peer_ip;
+static uint8_t _ntp_discovery_backoff;
+
+// NTP server for the other clocks, see ntp_server.h
+static WiFiUDP _ntp_server_udp;
+
+// Display state reported by the telemetry, see telemetry_display_e
+static uint8_t _display_state;
+
+// Set by the HTTP server, the sync is done by loop() after the response.
+static bool _sync_requested;
+
+// Schedule of the radio in idle time, see radio_power.h
+static time_t _radio_wake_utc;
+static time_t _radio_deadline_utc;
 
 // Local function prototypes
 static time_t timeProvider(void);
 static time_t initialRtcRead(void);
 static time_t getNtpTime(void);
+static bool query_ntp(IPAddress server_ip, ntp_reference_t *reference, IPAddress *replied_by);
+static void syncRtc(time_t ntp_time);
+static void config_defaults(vfd_config_t *config);
 static bool is_idle_time(int weekday, int hour);
+static time_t seconds_to_display_on(time_t local_time);
+static void manage_radio(time_t time_utc, time_t local_time, bool is_idle);
+static int page_sync(time_t local_time, uint8_t vfd_output[VFD_TUBE_CNT]);
 static void power_switch(power_switch_e switch_setting);
-static void uart_debug(void);
+static void restart_low_memory(void);
+static void restart_clock(void);
+static void send_telemetry(void);
+static bool install_firmware(const char *url, const char *md5);
+static void show_ota_progress(uint8_t percent);
+static void cmd_help(int argc, char *argv[]);
+static void cmd_version(int argc, char *argv[]);
+static void cmd_restart(int argc, char *argv[]);
+static void cmd_status(int argc, char *argv[]);
+static void cmd_config(int argc, char *argv[]);
+static void cmd_stopwatch(int argc, char *argv[]);
+static void cmd_wifi(int argc, char *argv[]);
+static void cmd_log(int argc, char *argv[]);
+static void cmd_postmortem(int argc, char *argv[]);
+static void cmd_memory(int argc, char *argv[]);
+static void cmd_ota(int argc, char *argv[]);
+static void cmd_trace(int argc, char *argv[]);
+static void cmd_isrload(int argc, char *argv[]);
+static bool http_index(const http_request_t *request, http_response_t *response, uint16_t part);
+static bool http_status(const http_request_t *request, http_response_t *response, uint16_t part);
+static bool http_config(const http_request_t *request, http_response_t *response, uint16_t part);
+static bool http_sync(const http_request_t *request, http_response_t *response, uint16_t part);
+static bool http_stopwatch(const http_request_t *request, http_response_t *response, uint16_t part);
+static bool http_authorized(const http_request_t *request, http_response_t *response);
+
+/// Command table of the debug terminal
+static const shell_cmd_t SHELL_COMMANDS[] PROGMEM = {
+    {"help", "list the commands", cmd_help},
+    {"ver", "full version", cmd_version},
+    {"restart", "restart ESP", cmd_restart},
+    {"status", "time, sync state, network and memory", cmd_status},
+    {"config", "[show|set <key> <value>|save|undo|defaults]", cmd_config},
+    {"sw", "[show [mm|ms|off]|start|stop|go|lap|reset|down <s>]", cmd_stopwatch},
+    {"wifi", "erase [confirm]  reconfigure WiFi (smartphone needed)", cmd_wifi},
+    {"log", "[text|hex|off]  event log output", cmd_log},
+    {"pm", "[clear]  post-mortem of the previous run", cmd_postmortem},
+    {"mem", "[reset]  heap and stack watermarks", cmd_memory},
+    {"ota", "<http://host[:port]/path> [md5]  firmware update", cmd_ota},
+    {"trace", "<words>|off  HV5812 words for tools/vfd_trace_analyze.py", cmd_trace},
+    {"isrload", "<s> [erase]  worst-case ISR time under flash load", cmd_isrload},
+};
+
+/// Pages of the display, the configuration refers to them by index.  Append new pages at the end.
+static const display_page_t DISPLAY_PAGES[] PROGMEM = {
+    {"time", displayPageTime},
+    {"date", displayPageDate},
+    {"uptime", displayPageUptime},
+    {"sync", page_sync},
+    {"message", displayPageMessage},
+};
+
+/// Routes of the HTTP server
+static const http_route_t HTTP_ROUTES[] PROGMEM = {
+    {"/", HTTP_HTML, http_index},
+    {"/status", HTTP_JSON, http_status},
+    {"/config", HTTP_JSON, http_config},
+    {"/sync", HTTP_JSON, http_sync},
+    {"/stopwatch", HTTP_JSON, http_stopwatch},
+};
 
 /// Arduino framework standard function.
 void setup()
@@ -160,78 +316,113 @@ void setup()
   // Send greetings message to serial.  Startup VFD tubes and display "  42  ".
   Serial.println(F("\n  ******   VFD Clock - Ver 1.3   ******"));
   Serial.println(F("Running on Espressif Generic ESP8266 ESP-01 1M SoC module"));
-  Serial.printf("ChipId %u, %i MHz clock speed, %u bytes flash @%2.1f MHz\n", ESP.getChipId(),
-                ESP.getCpuFreqMHz(), ESP.getFlashChipSize(), (ESP.getFlashChipSpeed() / 1000000.0));
+  Serial.printf("ChipId %u, %i MHz clock speed, %u bytes flash @%u MHz\n", ESP.getChipId(), ESP.getCpuFreqMHz(),
+                ESP.getFlashChipSize(), ESP.getFlashChipSpeed() / 1000000U);
+  // Post-mortem of the previous run
+  Serial.print(F("Reading post-mortem from RTC user memory..."));
+  Serial.println(postmortemBegin() ? F("\t\t\t[passed]") : F("\t\t\t[power on]"));
+  const postmortem_info_t *postmortem = postmortemInfo();
+  Serial.printf("Boot %u, reset reason: %s\n", postmortem->boot_count, ESP.getResetReason().c_str());
+  eventLog(EV_BOOT, postmortem->boot_count, postmortem->reset_reason);
+  snprintf(AP_NAME, sizeof(AP_NAME), "VFD-CLOCK_%u", ESP.getChipId());
+  // Runtime configuration
+  vfd_config_t defaults;
+  config_defaults(&defaults);
+  Serial.print(F("Loading configuration from flash..."));
+  Serial.println(configBegin(&defaults) ? F("\t\t\t\t[passed]") : F("\t\t\t\t[defaults]"));
+  const vfd_config_t *config = configGet();
+  displayPagesBegin(DISPLAY_PAGES, sizeof(DISPLAY_PAGES) / sizeof(DISPLAY_PAGES[0]));
+  setVfdTubeType(config->tube_type);
+  CE.setRules(config->dst_rule, config->std_rule);
   Serial.println(F("\n -- VFD 8 tubes 7-Seg display startup --"));
   Serial.println(F("Setting blanking inactive and turn on heating"));
-  Serial.println(F("Your display should indicate \"  42  \" now"));
+  Serial.println(F("Your display should scroll \"42nibbles\" now"));
   // I/O mode configuration
   HV5812_init(IODEF_VFD_DRIVER_BLANKING, IODEF_VFD_DRIVER_STROBE, IODEF_VFD_DRIVER_CLOCK, IODEF_VFD_DRIVER_SDATA_IN);
   pinMode(IODEF_VFD_HEATING, OUTPUT); // Heating control
   // External hardware configuration
   power_switch(PWR_ON);
   delay(512UL);
-  // VFD display greeting message "  42  "
-  uint8_t vfd_output[VFD_TUBE_CNT];
-  // Values are 0 to 15 for '0,1,2,...,F'. 16 is ' ' (blank)
-  const uint8_t BLANK = 16; // choosing VFD_BLANK defined in multiplexer.h would be ok, too.
-  vfd_output[0] = BLANK;    // rightmost tube
-  vfd_output[1] = BLANK;
-  vfd_output[2] = 2;
-  vfd_output[3] = 4;
-  vfd_output[4] = BLANK;
-  vfd_output[5] = BLANK; // leftmost tube
-  const unsigned long DISPLAY_DELAY_MILLIS = 4000UL;
-  const unsigned long START_MILLIS = millis();
-  while ((millis() - START_MILLIS) < DISPLAY_DELAY_MILLIS)
-  {
-    setVfd(vfd_output);
-    delay(1UL);
+  // VFD display greeting message played from flash by the background interrupt
+  updateVfd(VFD_OUTPUT_BLANK, -1);
+  setVfdBrightness(config->brightness);
+  startVfdAnimation(&VFD_ANIM_BOOT_SPLASH);
+  while (isVfdAnimationRunning())
+  {
+    delay(16UL);
   }
+  // The background interrupt clashes with the WiFiManager in its server mode.
+  logOffVfd();
+  delay(2UL * VFD_REFRESH_MS_PERIOD);
   clearVfd();
 
-#ifdef SUPPORT_WIFI_NTP_SYNC
-  // WiFiManager: Try last stored WiFi client settings otherwise become a configurable server ;-)
-  // Local intialization. Once its business is done, there is no need to keep it around
-  Serial.println(F("\n -- 42nibbles VFD network startup --"));
-  WiFiManager wifiManager;
-  // reset saved settings
-  //wifiManager.resetSettings();
-  // set custom ip for portal
-  //wifiManager.setAPStaticIPConfig(IPAddress(10,0,1,1), IPAddress(10,0,1,1), IPAddress(255,255,255,0));
-  // fetches ssid and pass from eeprom and tries to connect
-  // if it does not connect it starts an access point with the specified name
-  // here  "AutoConnectAP"
-  // and goes into a blocking loop awaiting configuration
-  wifiManager.autoConnect((const char *)AP_NAME.c_str(), AP_PASSWORD);
-  // or use this for auto generated name ESP + ChipID
-  //wifiManager.autoConnect();
-  // if you get here you have connected to the WiFi
-  Serial.println("connected...yeey :)");
-  // Datagram service will be done by UDP
-  Serial.printf("Creating UDP client port %u...", UDP_LOCAL_PORT);
-  if (_udp.begin(UDP_LOCAL_PORT) == 1)
-  {
-    Serial.println(F("\t\t\t\t\t[passed]"));
+  if (config->flags & CONFIG_WIFI_NTP_SYNC)
+  {
+    // WiFiManager: Try last stored WiFi client settings otherwise become a configurable server ;-)
+    // Local intialization. Once its business is done, there is no need to keep it around
+    Serial.println(F("\n -- 42nibbles VFD network startup --"));
+    WiFiManager wifiManager;
+    // reset saved settings
+    //wifiManager.resetSettings();
+    // set custom ip for portal
+    //wifiManager.setAPStaticIPConfig(IPAddress(10,0,1,1), IPAddress(10,0,1,1), IPAddress(255,255,255,0));
+    // fetches ssid and pass from eeprom and tries to connect
+    // if it does not connect it starts an access point with the specified name
+    // here  "AutoConnectAP"
+    // and goes into a blocking loop awaiting configuration
+    wifiManager.autoConnect(AP_NAME, AP_PASSWORD);
+    // or use this for auto generated name ESP + ChipID
+    //wifiManager.autoConnect();
+    // if you get here you have connected to the WiFi
+    Serial.println("connected...yeey :)");
+    // The credentials are stored now.  From here on the radio is cycled in idle time, each WiFi.mode() and
+    // WiFi.begin() would write the WiFi settings to flash again.
+    WiFi.persistent(false);
+    // Datagram service will be done by UDP
+    Serial.printf("Creating UDP client port %u...", config->udp_local_port);
+    if (_udp.begin(config->udp_local_port) == 1)
+    {
+      Serial.println(F("\t\t\t\t\t[passed]"));
+    }
+    else
+    {
+      Serial.println(F("\t\t\t\t\t[failed]"));
+      Serial.println(F("-- bus error: unable to access clock device --"));
+      Serial.println(F("-- rebooting and going for the next round --"));
+      restart_clock();
+      // never reach this
+    }
+    if (config->flags & CONFIG_NTP_SERVER)
+    {
+      Serial.print(F("Serving NTP to the LAN on UDP port 123..."));
+      Serial.println(ntpServerBegin(_ntp_server_udp) ? F("\t\t\t[passed]") : F("\t\t\t[failed]"));
+    }
+    if (config->flags & CONFIG_HTTP_SERVER)
+    {
+      Serial.printf("Serving status and configuration on http://%s/\n", WiFi.localIP().toString().c_str());
+      httpServerBegin(HTTP_ROUTES, sizeof(HTTP_ROUTES) / sizeof(HTTP_ROUTES[0]));
+    }
   }
   else
   {
-    Serial.println(F("\t\t\t\t\t[failed]"));
-    Serial.println(F("-- bus error: unable to access clock device --"));
-    Serial.println(F("-- rebooting and going for the next round --"));
-    ESP.restart();
-    // never reach this
+    Serial.println(F("\nNo WiFi functionality was configured for this clock\n -- NTP will not sync... --"));
   }
-#else
-  Serial.println(F("\nNo WiFi functionality was intended in this firmware\n -- NTP will not sync... --"));
-#endif
 
   // Startup clock systems
   Serial.println(F("\n -- 42nibbles VFD clock startup --"));
-  Serial.println(F("Installed timezone is 'Europe/Berlin', CEST, CET"));
+  Serial.printf("Installed timezone is %.5s/%.5s\n", config->dst_rule.abbrev, config->std_rule.abbrev);
   Serial.println(F("Starting background clock syncing system"));
   setSyncProvider(&timeProvider);
+#ifdef SUPPORT_RTC_SQW_TICK
+  Serial.print(F("Enabling 1 Hz square wave of the RTC..."));
+  Serial.println(rtcSqwBegin(IODEF_RTC_SQW) ? F("\t\t\t\t[passed]") : F("\t\t\t\t[failed]"));
+#endif
   Serial.println(F("\nRunning clock in endless loop..."));
+  if (config->flags & CONFIG_UART_DEBUG)
+  {
+    Serial.println(F("Debug terminal is active, enter 'help' for the commands."));
+    shellBegin(&Serial, SHELL_COMMANDS, sizeof(SHELL_COMMANDS) / sizeof(SHELL_COMMANDS[0]));
+  }
 }
 
 /// Arduino framework standard function.
@@ -241,15 +432,58 @@ void loop()
   static bool has_idle_time;
   static int old_hour_utc = hour() - 1; // should be processed upcoming
 
-  if (UART_DEBUG == 1)
+  if ((configGet()->flags & CONFIG_UART_DEBUG) && Serial.available() > 0)
+  {
+    shellPoll();
+  }
+  eventLogPoll(Serial);
+  vfdTracePoll(Serial);
+  isrProfilePoll(Serial);
+  ntpServerPoll();
+  httpServerPoll();
+  switch (radioPowerPoll())
+  {
+  case RADIO_CONNECTED:
+    eventLog(EV_RADIO_ON, radioPowerStats()->reconnect_ms);
+    setSyncInterval(NTP_SYNC_INTERVAL_S);
+    _sync_requested = true;
+    break;
+  case RADIO_CONNECT_TIMEOUT:
+    eventLog(EV_RADIO_TIMEOUT, RADIO_CONNECT_TIMEOUT_MS);
+    setSyncInterval(NTP_SYNC_INTERVAL_S);
+    break;
+  default:
+    break;
+  }
+  if (_sync_requested)
   {
-    uart_debug();
+    _sync_requested = false;
+    setSyncProvider(&timeProvider); // syncs at once
   }
 
+  // Seconds are counted by the RTC square wave if possible, else by the system time.
+  time_t time_utc = now();
+#ifdef SUPPORT_RTC_SQW_TICK
+  static time_t armed_time_utc;
+  rtcSqwPoll();
+  if (rtcSqwIsLocked())
+    time_utc = rtcNvramCorrect(&_sync_state, rtcSqwNow());
+#endif
+
   // This has to be processed only when the next second has arrived
-  if (old_time_utc != now())
+  if (old_time_utc != time_utc)
   {
-    old_time_utc = now();
+    old_time_utc = time_utc;
+    // Memory watermarks and high-water marks for the post-mortem
+    if (memMonitorSample(configGet()->low_heap_bytes))
+    {
+      restart_low_memory();
+      // never reach this
+    }
+    vfd_isr_stats_t isr_stats;
+    getVfdIsrStats(&isr_stats);
+    postmortemUpdate(isr_stats.max_us, memMonitorStats()->heap_free);
+    send_telemetry();
     // Variables for time zone calculation
     TimeChangeRule *tcr;
     time_t local_time = CE.toLocal(old_time_utc, &tcr);
@@ -259,39 +493,47 @@ void loop()
       old_hour_utc = hour();
       has_idle_time = is_idle_time(weekday(local_time), hour(local_time));
     }
-    // Display output if necessary
-    if (has_idle_time)
+    // Display output if necessary.  A stopwatch in use is shown even in idle time.
+    _display_state = has_idle_time ? TELEMETRY_DISPLAY_IDLE : 0;
+    if (getVfdStopwatchFormat() != VFD_SW_HIDDEN)
+      _display_state |= TELEMETRY_DISPLAY_STOPWATCH;
+    manage_radio(time_utc, local_time, has_idle_time && getVfdStopwatchFormat() == VFD_SW_HIDDEN);
+    if (has_idle_time && getVfdStopwatchFormat() == VFD_SW_HIDDEN)
     {
       power_switch(PWR_OFF);
     }
     else
     {
       power_switch(PWR_ON);
-      // Display setting
-      int sec = second(local_time);
-      uint8_t vfd_output[VFD_TUBE_CNT]; // used for VFD output
-      if (sec > 55)
-      {
-        vfd_output[0] = year(local_time) % 10;
-        vfd_output[1] = (year(local_time) - 2000) / 10; // indexing tenth of year
-        vfd_output[2] = month(local_time) % 10;
-        vfd_output[3] = month(local_time) / 10;
-        vfd_output[4] = day(local_time) % 10;
-        vfd_output[5] = day(local_time) / 10;
-        updateVfd(vfd_output, 0); // Dots are permanently turned on
-      }
-      else
-      {
-        vfd_output[0] = second(local_time) % 10;
-        vfd_output[1] = second(local_time) / 10;
-        vfd_output[2] = minute(local_time) % 10;
-        vfd_output[3] = minute(local_time) / 10;
-        vfd_output[4] = hour(local_time) % 10;
-        vfd_output[5] = hour(local_time) / 10;
-        updateVfd(vfd_output, 1000); // Blinking dots with a period of 1000 ms
+      _display_state |= TELEMETRY_DISPLAY_ON;
+      // Display setting, only the changed tubes are passed on.
+#ifdef SUPPORT_RTC_SQW_TICK
+      // The frame of this second has already been swapped in by the SQW edge unless we missed it.
+      uint8_t changed_tubes = (armed_time_utc == time_utc) ? displayPagesCommitted() : displayPagesUpdate(local_time);
+      if (rtcSqwIsLocked())
+      { // Prepare the next second, the next SQW edge will show it.
+        armed_time_utc = time_utc + 1;
+        displayPagesArm(CE.toLocal(armed_time_utc));
       }
+#else
+      uint8_t changed_tubes = displayPagesUpdate(local_time);
+#endif
+      // Roll-over transition for changed digits.  Seconds change too often for this.
+      changed_tubes &= ROLL_OVER_TUBES;
+      if (changed_tubes)
+        startVfdAnimation(&VFD_ANIM_ROLL_OVER, changed_tubes);
     }
   }
+#ifdef SUPPORT_RTC_SQW_TICK
+  else
+  {
+    // Nothing to do until the next edge.
+    delay(RTC_SQW_IDLE_MS);
+  }
+#endif
+  // No need to spin while nothing is shown.
+  if (radioPowerState() == RADIO_OFF && !(_display_state & TELEMETRY_DISPLAY_ON))
+    delay(IDLE_LOOP_DELAY_MS);
 }
 
 //********************************************************************
@@ -314,54 +556,85 @@ static time_t timeProvider(void)
       Serial.println(F("\t[failed]"));
       Serial.println(F("-- bus error: unable to access clock device --"));
       Serial.println(F("-- rebooting and going for the next round --"));
-      ESP.restart();
+      restart_clock();
       // never reach this
     }
     else
     {
       Serial.println(F("\t[passed]"));
-      Serial.printf("UTC date in internal RTC is %02i.%02i.%04i UTC\n", day(utc_time), month(utc_time), year(utc_time));
-      Serial.printf("UTC time in internal RTC is %02i:%02i:%02i UTC\n", hour(utc_time), minute(utc_time), second(utc_time));
+      eventLog(EV_RTC_READ, utc_time);
     }
-    // NTP server connection would be an usefull feature but is not mandatory.
-    Serial.printf("Trying NTP server query from (%s)...", NTP_SERVER_NAME_STR);
-    utc_time = getNtpTime();
-    if (utc_time == (time_t)-1)
-    { // NTP not available at the moment but we can have the time from RTC anyway.
-      Serial.println(F("\t\t\t[failed]"));
-      Serial.println(F("Using internal real time clock for this time."));
-      Serial.println(F("(Retrying further NTP queries later.)"));
-      utc_time = RTC.get();
+    runs_first_time = false;
+    // Warm start: The sync state survives in the battery backed RAM of the RTC.
+    _sync_state_valid = rtcNvramLoad(&_sync_state) && _sync_state.schedule_version == configScheduleVersion(configGet());
+    if (_sync_state_valid)
+    {
+      utc_time = rtcNvramCorrect(&_sync_state, utc_time);
+      eventLog(EV_NVRAM_LOADED, _sync_state.last_sync_utc, _sync_state.drift_ppb);
+      if ((uint32_t)(utc_time - _sync_state.last_sync_utc) < WARM_START_MAX_AGE_S)
+      {
+        eventLog(EV_WARM_START, utc_time);
+        _sync_source = TELEMETRY_SYNC_WARM;
+        return utc_time;
+      }
     }
     else
-    { // We got time from the NTP and can now sync the RTC.
-      RTC.set(utc_time);
-      Serial.println(F("\t\t\t[passed]"));
-      Serial.println(F("Time from NTP server received.  Synchronized RTC with time server."));
-      Serial.printf("UTC date from NTP server is %02i.%02i.%04i UTC\n", day(utc_time), month(utc_time), year(utc_time));
-      Serial.printf("UTC time from NTP server is %02i:%02i:%02i UTC\n", hour(utc_time), minute(utc_time), second(utc_time));
+    {
+      eventLog(EV_NVRAM_INVALID);
+      rtcNvramInit(&_sync_state, configScheduleVersion(configGet()));
     }
-    runs_first_time = false;
-    return utc_time;
+    // NTP server connection would be an usefull feature but is not mandatory.
+    // If it is not available at the moment we can have the time from RTC anyway.
   }
 
   // usual way to go
-  utc_time = getNtpTime();
-  if (utc_time != (time_t)-1)
+  const time_t ntp_time = getNtpTime();
+  if (ntp_time != (time_t)-1)
   {
     // Now we can synchronize clocks with time server.
-    RTC.set(utc_time);
-    Serial.printf("Time from NTP server received.  Synchronized RTC with time server @%li UTC.\n", utc_time);
+    utc_time = ntp_time;
+    syncRtc(utc_time);
+    eventLog(EV_NTP_SYNC, utc_time);
+    _sync_source = _ntp_from_peer ? TELEMETRY_SYNC_PEER : TELEMETRY_SYNC_NTP;
+    if (radioPowerSynced(utc_time))
+      eventLog(EV_RADIO_SYNC, radioPowerStats()->first_sync_ms, radioPowerStats()->late_syncs);
   }
   else
   {
     // Use RTC for synchronization, because there was no answer from NTP server.
-    utc_time = RTC.get();
-    Serial.printf("Syncing with internal RTC @%li UTC.\n", utc_time);
+    // The initial round has read the RTC already.
+    if (utc_time == 0)
+      utc_time = rtcNvramCorrect(&_sync_state, RTC.get());
+    eventLog(EV_NTP_FAILED, utc_time);
+    _sync_source = TELEMETRY_SYNC_RTC;
+    _rtc_fallbacks++;
   }
   return utc_time;
 }
 
+/**
+ * \brief Synchronizes the RTC with the time received from a NTP server.
+ * \param ntp_time Time received from the NTP server.
+ *
+ * The RTC is set only if it went off by at least one second.  Offset and drift are kept in the RTC RAM.
+ */
+static void syncRtc(time_t ntp_time)
+{
+  if (rtcNvramOnSync(&_sync_state, RTC.get(), ntp_time))
+  {
+    RTC.set(ntp_time);
+    eventLog(EV_RTC_SET, ntp_time);
+#ifdef SUPPORT_RTC_SQW_TICK
+    rtcSqwResync();
+#endif
+  }
+  if (!rtcNvramStore(&_sync_state))
+  {
+    eventLog(EV_NVRAM_STORE_FAILED);
+  }
+  _sync_state_valid = true;
+}
+
 static time_t initialRtcRead(void)
 {
   // Caution: In case of error RTC.get() returns 0 instead of expected ((time_t) -1)
@@ -387,56 +660,158 @@ static time_t initialRtcRead(void)
 
 static time_t getNtpTime(void)
 {
-  if (_udp.localPort() == 0)
+  if (_udp.localPort() == 0 || !WiFi.isConnected())
   {
-    // Network was turned off by commenting '#define SUPPORT_WIFI_NTP_SYNC'.
+    // Network was turned off by the configuration or the radio is off in idle time.
     return -1;
   }
 
-  while (_udp.parsePacket())
-    ; //discard any previously received packets
+  const vfd_config_t *config = configGet();
+  ntp_reference_t reference;
+  IPAddress replied_by;
+
+  // A NTP server of the LAN is preferred, it is found by a broadcast request.
+  _ntp_from_peer = false;
+  if ((config->flags & CONFIG_NTP_DISCOVERY) && !(config->flags & CONFIG_NTP_SERVER))
+  {
+    if ((uint32_t)_ntp_peer_ip == 0 && _ntp_discovery_backoff > 0)
+    {
+      _ntp_discovery_backoff--;
+    }
+    else
+    {
+      const bool is_discovery = (uint32_t)_ntp_peer_ip == 0;
+      const IPAddress server_ip =
+          is_discovery ? IPAddress((uint32_t)WiFi.localIP() | ~(uint32_t)WiFi.subnetMask()) : _ntp_peer_ip;
+      if (query_ntp(server_ip, &reference, &replied_by))
+      {
+        if (is_discovery)
+          eventLog(EV_NTP_PEER, replied_by[3]);
+        _ntp_peer_ip = replied_by;
+        _ntp_from_peer = true;
+        ntpServerSetReference(&reference);
+        return reference.utc_s;
+      }
+      // No peer, use the configured server for a while.
+      _ntp_peer_ip = IPAddress(0U);
+      _ntp_discovery_backoff = NTP_DISCOVERY_BACKOFF;
+    }
+  }
 
   // Request ntp server ip address
   IPAddress time_server_ip;
-  WiFi.hostByName(NTP_SERVER_NAME_STR, time_server_ip);
-
-  // Doing the NTP request
-  const int NTP_PACKET_SIZE = 48;
-  byte packet_buffer[NTP_PACKET_SIZE];
-  memset(packet_buffer, 0, NTP_PACKET_SIZE);
-  packet_buffer[0] = 0b11100011; // LI, Version, Mode
-  packet_buffer[1] = 0;          // Stratum, or type of clock
-  packet_buffer[2] = 6;          // Polling Interval
-  packet_buffer[3] = 0xec;       // Peer Clock Precision
-  // 8 bytes of zero for Root Delay & Root Dispersion
-  packet_buffer[12] = 49;
-  packet_buffer[13] = 0x4e;
-  packet_buffer[14] = 49;
-  packet_buffer[15] = 52;
-  // timestamp request
-  _udp.beginPacket(time_server_ip, 123); // NTP server port is 123
-  _udp.write(packet_buffer, NTP_PACKET_SIZE);
+  if (WiFi.hostByName(config->ntp_server, time_server_ip) != 1)
+    return (time_t)-1;
+  if (!query_ntp(time_server_ip, &reference, &replied_by))
+    return (time_t)-1;
+  ntpServerSetReference(&reference);
+  return reference.utc_s;
+}
+
+/**
+ * \brief  Queries a NTP server.
+ * \param  server_ip Address of the server, may be a broadcast address.
+ * \param  reference Receives the time of the server.
+ * \param  replied_by Receives the address of the server that replied.
+ * \return false if there was no usable reply within NTP_REPLY_TIMEOUT_MS.
+ */
+static bool query_ntp(IPAddress server_ip, ntp_reference_t *reference, IPAddress *replied_by)
+{
+  while (_udp.parsePacket())
+    ; //discard any previously received packets
+
+  // Doing the NTP request, a reply has to return its random transmit timestamp.
+  uint8_t request[NTP_PACKET_SIZE];
+  uint8_t packet_buffer[NTP_PACKET_SIZE];
+  ntpBuildRequest(request, ESP.random(), ESP.random());
+  _udp.beginPacket(server_ip, NTP_PORT);
+  _udp.write(request, NTP_PACKET_SIZE);
   _udp.endPacket();
 
-  // Handling of NTP reply
-  delay(1000);
-  int rply_size = _udp.parsePacket();
-  if (rply_size)
-  {
-    _udp.read(packet_buffer, NTP_PACKET_SIZE);
-    //the timestamp starts at byte 40 and is two words long
-    unsigned long hword = word(packet_buffer[40], packet_buffer[41]);
-    unsigned long lword = word(packet_buffer[42], packet_buffer[43]);
-    unsigned long secs_since_1900 = hword << 16 | lword;
-    // Unix time starts on Jan 1 1970. In seconds, that's 2208988800. So
-    // we have to subtract seventy years.
-    time_t unix_time = secs_since_1900 - 2208988800UL;
-    return unix_time;
+  // Handling of NTP reply, the round trip time is reported by the telemetry.
+  const unsigned long request_ms = millis();
+  while (millis() - request_ms < NTP_REPLY_TIMEOUT_MS)
+  {
+    if (_udp.parsePacket() >= (int)NTP_PACKET_SIZE)
+    {
+      const unsigned long reply_ms = millis();
+      _udp.read(packet_buffer, NTP_PACKET_SIZE);
+      if (ntpDecodeReply(packet_buffer, request, reply_ms, reply_ms - request_ms, reference))
+      {
+        _ntp_delay_ms = reply_ms - request_ms;
+        *replied_by = _udp.remoteIP();
+        reference->refid = (uint32_t)*replied_by;
+        return true;
+      }
+    }
+    delay(1UL);
   }
-  else
+  return false;
+}
+
+/**
+ * \brief  Renders the page with the sync status: "S", the telemetry_sync_source_e and the minutes since the
+ *         last NTP sync.
+ * \sa     display_pages.h
+ */
+static int page_sync(time_t, uint8_t vfd_output[VFD_TUBE_CNT])
+{
+  const uint32_t age_min = min((uint32_t)(now() - _sync_state.last_sync_utc) / 60U, (uint32_t)9999U);
+
+  vfd_output[5] = getVfdGlyph('S');
+  vfd_output[4] = _sync_source;
+  vfd_output[3] = _sync_state_valid ? age_min / 1000 % 10 : VFD_DASH;
+  vfd_output[2] = _sync_state_valid ? age_min / 100 % 10 : VFD_DASH;
+  vfd_output[1] = _sync_state_valid ? age_min / 10 % 10 : VFD_DASH;
+  vfd_output[0] = _sync_state_valid ? age_min % 10 : VFD_DASH;
+  return -1;
+}
+
+/**
+ * \brief  Fills in the compile time defaults of the runtime configuration.
+ * \param  config Configuration to be filled in.
+ *
+ * This clock is configured for use in the laboratory, which means the display is switched on on workdays
+ * from monday to friday from 8:00 to 19:00 except on tuesday when "Open Lab" is running (8:00 to 23:00)
+ * and on friday (8:00 to 17:00).  On saturday and sunday the display is off.
+ */
+static void config_defaults(vfd_config_t *config)
+{
+  memset(config, 0, sizeof(*config));
+#ifdef SUPPORT_WIFI_NTP_SYNC
+  config->flags |= CONFIG_WIFI_NTP_SYNC;
+#endif
+#ifdef SUPPORT_POWER_SAVE_MODE
+  config->flags |= CONFIG_POWER_SAVE_MODE;
+#endif
+  if (UART_DEBUG == 1)
+    config->flags |= CONFIG_UART_DEBUG;
+  config->flags |= CONFIG_HTTP_SERVER | CONFIG_RADIO_SLEEP;
+  config->tube_type = getVfdTubeType();
+  config->brightness = VFD_BRIGHTNESS_MAX;
+  config->udp_local_port = UDP_LOCAL_PORT;
+  strncpy(config->ntp_server, NTP_SERVER_NAME_STR, sizeof(config->ntp_server) - 1);
+  config->dst_rule = CEST;
+  config->std_rule = CET;
+  // Weekend detection-week end means idle time (on_hour equal to off_hour)
+  for (int day = Sun; day <= Sat; day++)
   {
-    return (time_t)-1;
+    config->on_hour[day - Sun] = 8;
+    config->off_hour[day - Sun] = 19;
   }
+  config->on_hour[Sat - Sun] = config->off_hour[Sat - Sun] = 0;
+  config->on_hour[Sun - Sun] = config->off_hour[Sun - Sun] = 0;
+  config->off_hour[Tue - Sun] = 23; // "Day of the Open Lab" at tuesday
+  config->off_hour[Fri - Sun] = 17; // Friday setting
+  config->low_heap_bytes = LOW_HEAP_BYTES;
+  config->telemetry_port = TELEMETRY_PORT;
+  config->telemetry_interval_s = TELEMETRY_INTERVAL_S;
+  // Time, and the date for the last seconds of each minute
+  config->page[0] = 0;
+  config->page_s[0] = 56;
+  config->page[1] = 1;
+  config->page_s[1] = 4;
+  strncpy(config->message, "HELLO", sizeof(config->message) - 1);
 }
 
 /**
@@ -444,35 +819,79 @@ static time_t getNtpTime(void)
  * \param  weekday The weekday as given by weekday()
  * \param  hour The hour as given by hour()
  * \return true if it is idle time, else false.
+ * \sa     vfd_config_t
  */
 static bool is_idle_time(int weekday, int hour)
 {
-  bool is_idle = false;
+  const vfd_config_t *config = configGet();
 
   // If power saving is not supported we will never have idle time.
-#ifndef SUPPORT_POWER_SAVE_MODE
-  return is_idle;
-#endif
+  if (!(config->flags & CONFIG_POWER_SAVE_MODE))
+    return false;
+  if (weekday < Sun || weekday > Sat)
+    return false;
+  return hour < config->on_hour[weekday - Sun] || hour >= config->off_hour[weekday - Sun];
+}
+
+/**
+ * \brief  Time until the display is turned on by the idle schedule.
+ * \param  local_time Local time.
+ * \return Seconds until the next full hour that is not idle time, 0 if there is none within a week.
+ */
+static time_t seconds_to_display_on(time_t local_time)
+{
+  const time_t hour_start = local_time - local_time % SECS_PER_HOUR;
 
-  switch (weekday)
+  for (time_t hours = 1; hours <= 7 * 24; hours++)
   {
-  case Sat: // Weekend detection-week end means idle time
-  case Sun:
-    is_idle = true;
+    const time_t on_time = hour_start + hours * SECS_PER_HOUR;
+    if (!is_idle_time(weekday(on_time), hour(on_time)))
+      return on_time - local_time;
+  }
+  return 0;
+}
+
+/**
+ * \brief Turns the radio off in idle time and on for the NTP sync and before the display.
+ * \param time_utc Current time.
+ * \param local_time Current local time.
+ * \param is_idle true if the display is off.
+ * \sa    radio_power.h
+ *
+ * The radio stays on if this clock serves NTP to the LAN.  TimeLib must not ask for a sync before the
+ * wake-up, the sync is requested by loop() as soon as the connection is back.
+ */
+static void manage_radio(time_t time_utc, time_t local_time, bool is_idle)
+{
+  const vfd_config_t *config = configGet();
+  const bool may_sleep = is_idle && (config->flags & CONFIG_RADIO_SLEEP) && !(config->flags & CONFIG_NTP_SERVER) &&
+                         _udp.localPort() != 0;
+
+  switch (radioPowerState())
+  {
+  case RADIO_ON:
+  {
+    if (!may_sleep)
+      break;
+    const time_t to_display_on_s = seconds_to_display_on(local_time);
+    if (to_display_on_s != 0 && to_display_on_s <= RADIO_WAKE_LEAD_S)
+      break;
+    _radio_deadline_utc = to_display_on_s != 0 ? time_utc + to_display_on_s : 0;
+    _radio_wake_utc = time_utc + IDLE_SYNC_INTERVAL_S;
+    if (to_display_on_s != 0 && to_display_on_s - RADIO_WAKE_LEAD_S < IDLE_SYNC_INTERVAL_S)
+      _radio_wake_utc = _radio_deadline_utc - RADIO_WAKE_LEAD_S;
+    setSyncInterval(IDLE_SYNC_INTERVAL_S + RADIO_WAKE_LEAD_S);
+    radioPowerOff();
+    eventLog(EV_RADIO_OFF, _radio_wake_utc);
     break;
-  case Tue: // "Day of the Open Lab" at tuesday
-    if (hour < 8 || hour >= 23)
-      is_idle = true;
+  }
+  case RADIO_OFF:
+    if (!may_sleep || time_utc >= _radio_wake_utc)
+      radioPowerWake(_radio_deadline_utc);
     break;
-  case Fri: // Friday setting
-    if (hour < 8 || hour >= 17)
-      is_idle = true;
+  default:
     break;
-  default: // All else
-    if (hour < 8 || hour >= 19)
-      is_idle = true;
   }
-  return is_idle;
 }
 
 /**
@@ -501,78 +920,784 @@ static void power_switch(power_switch_e switch_setting)
   }
 }
 
-static void uart_debug(void)
+/**
+ * \brief  Downloads a firmware image and restarts the clock to install it.
+ * \param  url http://host[:port]/path of the image.
+ * \param  md5 MD5 digest of the image, nullptr to take it from the server.
+ * \return false if the update failed, the running firmware is kept then.
+ * \sa     ota_update.h
+ */
+static bool install_firmware(const char *url, const char *md5)
+{
+  power_switch(PWR_ON);
+  Serial.printf("Firmware update from %s...", url);
+  const ota_result_e result = otaUpdateFromUrl(url, md5, show_ota_progress);
+  eventLog(EV_OTA_RESULT, result);
+  Serial.println(result == OTA_OK ? F("\t[passed]") : F("\t[failed]"));
+  Serial.println(otaResultText(result));
+  if (result != OTA_OK)
+  {
+    displayPagesInvalidate(); // the progress is shown until the next second
+    return false;
+  }
+  restart_clock();
+  return true; // never reach this
+}
+
+// Shows "U- nnn" with the progress in percent.
+static void show_ota_progress(uint8_t percent)
+{
+  uint8_t vfd_output[VFD_TUBE_CNT];
+
+  vfd_output[0] = percent % 10;
+  vfd_output[1] = percent >= 10 ? percent / 10 % 10 : VFD_BLANK;
+  vfd_output[2] = percent >= 100 ? 1 : VFD_BLANK;
+  vfd_output[3] = VFD_BLANK;
+  vfd_output[4] = VFD_DASH;
+  vfd_output[5] = getVfdGlyph('u');
+  updateVfd(vfd_output, -1);
+}
+
+/**
+ * \brief Sends a telemetry datagram if the interval is over.
+ * \sa    telemetry.h
+ */
+static void send_telemetry(void)
+{
+  static unsigned long last_ms;
+  const vfd_config_t *config = configGet();
+
+  if (config->telemetry_ip == 0 || config->telemetry_port == 0 || _udp.localPort() == 0 || !WiFi.isConnected())
+    return;
+  if (millis() - last_ms < config->telemetry_interval_s * 1000UL)
+    return;
+  last_ms = millis();
+
+  telemetry_app_state_t app;
+  app.utc = now();
+  app.last_sync_utc = _sync_state.last_sync_utc;
+  app.rtc_offset_s = _sync_state.offset_s;
+  app.drift_ppb = _sync_state.drift_ppb;
+  app.ntp_delay_ms = _ntp_delay_ms;
+  app.rtc_fallbacks = _rtc_fallbacks;
+  app.sync_source = _sync_source;
+  app.display = _display_state;
+#ifdef SUPPORT_RTC_SQW_TICK
+  if (rtcSqwIsLocked())
+    app.display |= TELEMETRY_DISPLAY_SQW_LOCKED;
+#endif
+  app.brightness = config->brightness;
+  telemetrySend(_udp, IPAddress(config->telemetry_ip), config->telemetry_port, &app);
+}
+
+/**
+ * \brief Restarts the clock before an allocation of the NTP or WiFi code fails.
+ *
+ * The event is kept in the post-mortem, so the restart can be told from a crash.
+ */
+static void restart_low_memory(void)
+{
+  const mem_stats_t *stats = memMonitorStats();
+  eventLog(EV_LOW_MEMORY, stats->block_max, stats->heap_free, stats->fragmentation);
+  Serial.printf("-- low memory: largest free block %u bytes, restarting --\n", stats->block_max);
+  restart_clock();
+}
+
+static void restart_clock(void)
+{
+  logOffVfd();
+  clearVfd();
+#ifdef SUPPORT_RTC_SQW_TICK
+  rtcSqwEnd(); // SQW/OUT drives the boot strapping pin
+#endif
+  ESP.restart();
+}
+
+//********************************************************************
+// Debug terminal commands, see shell.h
+//********************************************************************
+
+static void cmd_help(int, char *[])
+{
+  Serial.println(F("VFD Clock debug terminal - available commands"));
+  shellHelp();
+}
+
+static void cmd_version(int, char *[])
+{
+  Serial.println(ESP.getFullVersion());
+}
+
+static void cmd_restart(int, char *[])
+{
+  restart_clock();
+}
+
+static void cmd_status(int, char *[])
+{
+  const time_t utc_time = now();
+  Serial.printf("UTC %02i.%02i.%04i %02i:%02i:%02i, sync %s\n", day(utc_time), month(utc_time), year(utc_time),
+                hour(utc_time), minute(utc_time), second(utc_time),
+                timeStatus() == timeSet ? "ok" : (timeStatus() == timeNeedsSync ? "pending" : "none"));
+  if (_sync_state_valid)
+    Serial.printf("Last NTP sync @%u UTC, RTC offset %i s, drift %i ppb\n", _sync_state.last_sync_utc,
+                  _sync_state.offset_s, _sync_state.drift_ppb);
+#ifdef SUPPORT_RTC_SQW_TICK
+  Serial.printf("RTC square wave %s, %u ticks\n", rtcSqwIsLocked() ? "locked" : "unlocked", rtcSqwTicks());
+#endif
+  if (_ntp_from_peer)
+    Serial.printf("NTP from LAN peer %s\n", _ntp_peer_ip.toString().c_str());
+  if (configGet()->flags & CONFIG_NTP_SERVER)
+    Serial.printf("NTP server: %u requests served\n", ntpServerServed());
+  Serial.printf("WiFi %s, IP %s, RSSI %i dBm\n", WiFi.isConnected() ? "connected" : "disconnected",
+                WiFi.localIP().toString().c_str(), WiFi.RSSI());
+  const radio_stats_t *radio = radioPowerStats();
+  if (radio->wakes > 0)
+    Serial.printf("Radio off %u s in idle time, %u wake-ups (%u timeouts), reconnect %u ms (max %u), first sync "
+                  "%u ms (max %u), %u late\n",
+                  radio->off_s, radio->wakes, radio->timeouts, radio->reconnect_ms, radio->reconnect_ms_max,
+                  radio->first_sync_ms, radio->first_sync_ms_max, radio->late_syncs);
+  Serial.printf("Uptime %lu s, free heap %u bytes\n", millis() / 1000UL, ESP.getFreeHeap());
+}
+
+static void cmd_wifi(int argc, char *argv[])
+{
+  if (argc < 2 || strcmp(argv[1], "erase") != 0)
+  {
+    Serial.println(F("usage: wifi erase [confirm]"));
+    return;
+  }
+  if (argc < 3 || strcmp(argv[2], "confirm") != 0)
+  {
+    Serial.println(F("W A R N I N G : This will erase your WiFi access credentials."));
+    Serial.println(F("Do you really want to erase them?  -  Then enter 'wifi erase confirm'."));
+    return;
+  }
+  logOffVfd();
+  clearVfd();
+  Serial.println(F("\n\n**********\nErasing your credentials."));
+  Serial.print(F("Do a WiFi scan and login on device "));
+  Serial.print(AP_NAME);
+  Serial.println(F(".\nAfter that open a new browser page."));
+  Serial.println(F("**********\n\n"));
+  WiFiManager wifiManager;
+  wifiManager.resetSettings();
+  delay(1024UL);
+  restart_clock();
+}
+
+static void cmd_stopwatch(int argc, char *argv[])
+{
+  const char *op = argc > 1 ? argv[1] : "";
+
+  if (strcmp(op, "show") == 0)
+  {
+    const char *format = argc > 2 ? argv[2] : "";
+    if (strcmp(format, "ms") == 0)
+      controlVfdStopwatch(VFD_SW_SHOW, VFD_SW_SSS_MMM);
+    else if (strcmp(format, "off") == 0)
+      controlVfdStopwatch(VFD_SW_SHOW, VFD_SW_HIDDEN);
+    else
+      controlVfdStopwatch(VFD_SW_SHOW, VFD_SW_MM_SS_CC);
+  }
+  else if (strcmp(op, "start") == 0)
+    controlVfdStopwatch(VFD_SW_START);
+  else if (strcmp(op, "stop") == 0)
+    controlVfdStopwatch(VFD_SW_STOP);
+  else if (strcmp(op, "go") == 0)
+    controlVfdStopwatch(VFD_SW_TOGGLE);
+  else if (strcmp(op, "lap") == 0)
+    controlVfdStopwatch(VFD_SW_LAP);
+  else if (strcmp(op, "reset") == 0)
+  {
+    Serial.printf("Stopwatch was at %u ms\n", getVfdStopwatchMs());
+    controlVfdStopwatch(VFD_SW_RESET);
+  }
+  else if (strcmp(op, "down") == 0 && argc > 2)
+  {
+    controlVfdStopwatch(VFD_SW_RESET, strtoul(argv[2], nullptr, 10) * 1000UL);
+    controlVfdStopwatch(VFD_SW_START);
+  }
+  else if (argc == 1)
+    Serial.printf("Stopwatch at %u ms\n", getVfdStopwatchMs());
+  else
+    Serial.println(F("usage: sw [show [mm|ms|off]|start|stop|go|lap|reset|down <s>]"));
+}
+
+/// Configuration edited by the config command, stored by 'config save'.
+static vfd_config_t _edit_config;
+static bool _edit_config_valid;
+
+static void print_rule(const char *name, const TimeChangeRule &rule)
+{
+  Serial.printf(" %-10s %.5s %u %u %u %u %i\n", name, rule.abbrev, rule.week, rule.dow, rule.month, rule.hour,
+                rule.offset);
+}
+
+static bool parse_rule(int argc, char *argv[], TimeChangeRule *rule)
+{
+  if (argc < 9)
+    return false;
+  strncpy(rule->abbrev, argv[3], sizeof(rule->abbrev) - 1);
+  rule->abbrev[sizeof(rule->abbrev) - 1] = '\0';
+  rule->week = atoi(argv[4]);
+  rule->dow = atoi(argv[5]);
+  rule->month = atoi(argv[6]);
+  rule->hour = atoi(argv[7]);
+  rule->offset = atoi(argv[8]);
+  return rule->week <= Fourth && rule->dow >= Sun && rule->dow <= Sat && rule->month >= Jan && rule->month <= Dec &&
+         rule->hour < 24 && rule->offset >= -RULE_OFFSET_MAX_MIN && rule->offset <= RULE_OFFSET_MAX_MIN;
+}
+
+static bool set_flag(const char *value, config_flags_e flag)
+{
+  if (strcmp(value, "1") == 0 || strcmp(value, "on") == 0)
+    _edit_config.flags |= flag;
+  else if (strcmp(value, "0") == 0 || strcmp(value, "off") == 0)
+    _edit_config.flags &= ~flag;
+  else
+    return false;
+  return true;
+}
+
+static bool config_set(int argc, char *argv[])
+{
+  if (argc < 4)
+    return false;
+  const char *key = argv[2];
+  const char *value = argv[3];
+  if (strcmp(key, "wifi") == 0)
+    return set_flag(value, CONFIG_WIFI_NTP_SYNC);
+  if (strcmp(key, "powersave") == 0)
+    return set_flag(value, CONFIG_POWER_SAVE_MODE);
+  if (strcmp(key, "debug") == 0)
+    return set_flag(value, CONFIG_UART_DEBUG);
+  if (strcmp(key, "ntpserver") == 0)
+    return set_flag(value, CONFIG_NTP_SERVER);
+  if (strcmp(key, "discovery") == 0)
+    return set_flag(value, CONFIG_NTP_DISCOVERY);
+  if (strcmp(key, "http") == 0)
+    return set_flag(value, CONFIG_HTTP_SERVER);
+  if (strcmp(key, "radiosleep") == 0)
+    return set_flag(value, CONFIG_RADIO_SLEEP);
+  if (strcmp(key, "tube") == 0)
+  {
+    if (strcmp(value, "iv3a") == 0)
+      _edit_config.tube_type = VFD_TUBE_IV3A;
+    else if (strcmp(value, "iv12") == 0)
+      _edit_config.tube_type = VFD_TUBE_IV12;
+    else
+      return false;
+    return true;
+  }
+  if (strcmp(key, "brightness") == 0)
+  {
+    const int brightness = atoi(value);
+    if (brightness < 0 || brightness > VFD_BRIGHTNESS_MAX)
+      return false;
+    _edit_config.brightness = brightness;
+    return true;
+  }
+  if (strcmp(key, "lowheap") == 0)
+  {
+    const long bytes = atol(value);
+    if (bytes < 0 || bytes > 0xFFFF)
+      return false;
+    _edit_config.low_heap_bytes = bytes;
+    return true;
+  }
+  if (strcmp(key, "telemetry") == 0)
+  { // config set telemetry <ip>|off [port [interval s]]
+    IPAddress collector;
+    if (strcmp(value, "off") == 0)
+      collector = IPAddress(0U);
+    else if (!collector.fromString(value))
+      return false;
+    const long port = argc > 4 ? atol(argv[4]) : _edit_config.telemetry_port;
+    const long interval_s = argc > 5 ? atol(argv[5]) : _edit_config.telemetry_interval_s;
+    if (port <= 0 || port > 0xFFFF || interval_s < 10 || interval_s > 0xFFFF)
+      return false;
+    _edit_config.telemetry_ip = (uint32_t)collector;
+    _edit_config.telemetry_port = port;
+    _edit_config.telemetry_interval_s = interval_s;
+    return true;
+  }
+  if (strcmp(key, "port") == 0)
+  {
+    const long port = atol(value);
+    if (port <= 0 || port > 0xFFFF)
+      return false;
+    _edit_config.udp_local_port = port;
+    return true;
+  }
+  if (strcmp(key, "ntp") == 0)
+  {
+    if (strlen(value) >= sizeof(_edit_config.ntp_server))
+      return false;
+    strcpy(_edit_config.ntp_server, value);
+    return true;
+  }
+  if (strcmp(key, "hours") == 0 && argc >= 6)
+  { // config set hours <weekday 1=sunday> <on> <off>
+    const int day = atoi(argv[3]);
+    const int on_hour = atoi(argv[4]);
+    const int off_hour = atoi(argv[5]);
+    if (day < Sun || day > Sat || on_hour < 0 || off_hour < on_hour || off_hour > 24)
+      return false;
+    _edit_config.on_hour[day - Sun] = on_hour;
+    _edit_config.off_hour[day - Sun] = off_hour;
+    return true;
+  }
+  if (strcmp(key, "page") == 0 && argc >= 5)
+  { // config set page <entry 1..4> <page> <s>|off
+    const int entry = atoi(argv[3]) - 1;
+    if (entry < 0 || entry >= (int)CONFIG_PAGE_CNT)
+      return false;
+    if (strcmp(argv[4], "off") == 0)
+    {
+      _edit_config.page_s[entry] = 0;
+      return true;
+    }
+    const int page = displayPageFind(argv[4]);
+    const int seconds = argc > 5 ? atoi(argv[5]) : 0;
+    if (page < 0 || seconds < 1 || seconds > 0xFF)
+      return false;
+    _edit_config.page[entry] = page;
+    _edit_config.page_s[entry] = seconds;
+    return true;
+  }
+  if (strcmp(key, "message") == 0)
+  {
+    if (strlen(value) >= sizeof(_edit_config.message))
+      return false;
+    strcpy(_edit_config.message, value);
+    return true;
+  }
+  if (strcmp(key, "httpkey") == 0)
+  { // config set httpkey <key>|off
+    if (strcmp(value, "off") == 0)
+      value = "";
+    if (strlen(value) >= sizeof(_edit_config.http_key))
+      return false;
+    strcpy(_edit_config.http_key, value);
+    return true;
+  }
+  if (strcmp(key, "dst") == 0)
+    return parse_rule(argc, argv, &_edit_config.dst_rule);
+  if (strcmp(key, "std") == 0)
+    return parse_rule(argc, argv, &_edit_config.std_rule);
+  return false;
+}
+
+// Display and timezone settings take effect at once, the others after a restart.
+static bool save_edit_config()
 {
-  // XXX (hoffmann): Changing the menu system is a bit difficult because
-  // of the security entry requirements for the 'w' option.  This seems
-  // to be effective, but the maintenance is a drag.
-  static int entry_requirements;
-  char user_input;
+  const bool saved = configSave(&_edit_config);
+  setVfdTubeType((vfd_tube_type_e)_edit_config.tube_type);
+  setVfdBrightness(_edit_config.brightness);
+  CE.setRules(_edit_config.dst_rule, _edit_config.std_rule);
+  return saved;
+}
+
+static void cmd_config(int argc, char *argv[])
+{
+  const char *op = argc > 1 ? argv[1] : "show";
 
-  // Easy UART Debug interface
-  if ((user_input = Serial.read()))
+  if (!_edit_config_valid)
   {
-    switch (user_input)
+    _edit_config = *configGet();
+    _edit_config_valid = true;
+  }
+  if (strcmp(op, "show") == 0)
+  {
+    const vfd_config_t *config = &_edit_config;
+    Serial.println(memcmp(config, configGet(), sizeof(*config)) ? F("Configuration (not saved)")
+                                                                 : F("Configuration"));
+    Serial.printf(" wifi       %u\n", (config->flags & CONFIG_WIFI_NTP_SYNC) ? 1 : 0);
+    Serial.printf(" powersave  %u\n", (config->flags & CONFIG_POWER_SAVE_MODE) ? 1 : 0);
+    Serial.printf(" debug      %u\n", (config->flags & CONFIG_UART_DEBUG) ? 1 : 0);
+    Serial.printf(" ntpserver  %u\n", (config->flags & CONFIG_NTP_SERVER) ? 1 : 0);
+    Serial.printf(" discovery  %u\n", (config->flags & CONFIG_NTP_DISCOVERY) ? 1 : 0);
+    Serial.printf(" http       %u\n", (config->flags & CONFIG_HTTP_SERVER) ? 1 : 0);
+    Serial.printf(" radiosleep %u\n", (config->flags & CONFIG_RADIO_SLEEP) ? 1 : 0);
+    Serial.printf(" tube       %s\n", config->tube_type == VFD_TUBE_IV12 ? "iv12" : "iv3a");
+    Serial.printf(" brightness %u\n", config->brightness);
+    Serial.printf(" port       %u\n", config->udp_local_port);
+    Serial.printf(" ntp        %s\n", config->ntp_server);
+    Serial.printf(" lowheap    %u\n", config->low_heap_bytes);
+    Serial.printf(" telemetry  %s %u %u\n", IPAddress(config->telemetry_ip).toString().c_str(),
+                  config->telemetry_port, config->telemetry_interval_s);
+    print_rule("dst", config->dst_rule);
+    print_rule("std", config->std_rule);
+    for (int day = Sun; day <= Sat; day++)
+      Serial.printf(" hours      %i %2u %2u\n", day, config->on_hour[day - Sun], config->off_hour[day - Sun]);
+    for (unsigned entry = 0; entry < CONFIG_PAGE_CNT; entry++)
     {
-      // help screen
-    case 'h':
-      entry_requirements = 1;
-      Serial.println(F("\nVFD Clock debug terminal - available commands"));
-      Serial.println(F(" h\thelp"));
-      Serial.println(F(" v\tfull version"));
-      Serial.println(F(" r\trestart ESP"));
-      Serial.println(F(" w\treconfigure WiFi settings"));
-      Serial.println(F("  \t(smartphone or something like that needed)"));
-      break;
-      // restart ESP
-    case 'r':
-      logOffVfd();
-      clearVfd();
-      ESP.restart();
-      break;
-      // restart ESP
-    case 'v':
-      entry_requirements = 0;
-      Serial.println();
-      Serial.println(ESP.getFullVersion());
-      Serial.println();
-      break;
-      // reconfigure WiFi settings
-    case 'w':
-      if (entry_requirements & 1)
+      char name[sizeof(display_page_t::name)];
+      if (config->page_s[entry] == 0 || !displayPageName(config->page[entry], name, sizeof(name)))
+        strcpy(name, "off");
+      Serial.printf(" page       %u %-7s %u\n", entry + 1, name, config->page_s[entry]);
+    }
+    Serial.printf(" message    %.*s\n", (int)sizeof(config->message), config->message);
+    Serial.printf(" httpkey    %s\n", config->http_key[0] != '\0' ? "(set)" : "off");
+  }
+  else if (strcmp(op, "set") == 0)
+  {
+    if (!config_set(argc, argv))
+    {
+      Serial.println(F("usage: config set wifi|powersave|debug|ntpserver|discovery|http|radiosleep 0|1"));
+      Serial.println(F("       config set tube iv3a|iv12"));
+      Serial.println(F("       config set brightness|port|ntp|lowheap <value>"));
+      Serial.println(F("       config set telemetry <ip>|off [<port> [<interval s>]]"));
+      Serial.println(F("       config set hours <weekday 1=sun..7=sat> <on> <off>"));
+      Serial.println(F("       config set page <entry 1..4> time|date|uptime|sync|message <s>|off"));
+      Serial.println(F("       config set message <text of hex digits and n,i,l,S,o,r,t,u,H>"));
+      Serial.println(F("       config set httpkey <up to 15 characters>|off"));
+      Serial.println(F("       config set dst|std <abbrev> <week> <dow> <month> <hour> <offset min>"));
+    }
+  }
+  else if (strcmp(op, "save") == 0)
+  {
+    Serial.print(F("Saving configuration to flash..."));
+    Serial.println(save_edit_config() ? F("\t\t\t\t[passed]") : F("\t\t\t\t[failed]"));
+  }
+  else if (strcmp(op, "undo") == 0)
+  {
+    _edit_config = *configGet();
+  }
+  else if (strcmp(op, "defaults") == 0)
+  {
+    config_defaults(&_edit_config);
+  }
+  else
+  {
+    Serial.println(F("usage: config [show|set|save|undo|defaults]"));
+  }
+}
+
+static void cmd_log(int argc, char *argv[])
+{
+  const char *mode = argc > 1 ? argv[1] : "";
+
+  if (strcmp(mode, "text") == 0)
+    eventLogSetMode(EVENT_LOG_TEXT);
+  else if (strcmp(mode, "hex") == 0)
+    eventLogSetMode(EVENT_LOG_HEX);
+  else if (strcmp(mode, "off") == 0)
+    eventLogSetMode(EVENT_LOG_OFF);
+  else if (argc == 1)
+    Serial.printf("Event log mode %u, %u records dropped\n", eventLogGetMode(), eventLogDropped());
+  else
+    Serial.println(F("usage: log [text|hex|off]"));
+}
+
+static void cmd_postmortem(int argc, char *argv[])
+{
+  if (argc > 1 && strcmp(argv[1], "clear") == 0)
+  {
+    postmortemClear();
+    return;
+  }
+  const postmortem_info_t *info = postmortemInfo();
+  Serial.printf("Boot %u, reset reason %u (%s)\n", info->boot_count, info->reset_reason,
+                ESP.getResetReason().c_str());
+  if (info->reset_reason == REASON_EXCEPTION_RST || info->reset_reason == REASON_SOFT_WDT_RST ||
+      info->reset_reason == REASON_WDT_RST)
+    Serial.printf("Exception %u @0x%08x, address 0x%08x, uptime %u ms\n", info->exccause, info->epc1,
+                  info->excvaddr, info->crash_uptime_ms);
+  Serial.printf("Previous run: ISR max %u us, heap min %u bytes\n", info->isr_max_us, info->heap_min);
+  postmortem_event_t event;
+  for (unsigned age = 0; postmortemGetEvent(age, &event); age++)
+  {
+    Serial.printf(" boot %u %10u ms  ", event.boot, event.uptime_ms);
+    const char *format = eventLogFormat(event.id);
+    if (format != nullptr)
+      Serial.printf_P(format, event.arg, 0, 0); // only the first argument is kept
+    else
+      Serial.printf("event %u %i", event.id, event.arg);
+    Serial.println();
+  }
+}
+
+static void cmd_memory(int argc, char *argv[])
+{
+  if (argc > 1 && strcmp(argv[1], "reset") == 0)
+  {
+    memMonitorReset();
+    return;
+  }
+  const mem_stats_t *stats = memMonitorStats();
+  Serial.printf("Heap free %u bytes (min %u, max %u)\n", stats->heap_free, stats->heap_free_min, stats->heap_free_max);
+  Serial.printf("Largest block %u bytes (min %u), restart below %u\n", stats->block_max, stats->block_max_min,
+                configGet()->low_heap_bytes);
+  Serial.printf("Fragmentation %u %% (max %u %%)\n", stats->fragmentation, stats->fragmentation_max);
+  Serial.printf("Stack of loop() free %u bytes (min since boot), %u samples\n", stats->stack_free_min, stats->samples);
+}
+
+static void cmd_ota(int argc, char *argv[])
+{
+  if (argc < 2)
+  {
+    Serial.println(F("usage: ota <http://host[:port]/path> [md5]"));
+    return;
+  }
+  install_firmware(argv[1], argc > 2 ? argv[2] : nullptr);
+}
+
+static void cmd_trace(int argc, char *argv[])
+{
+  if (argc > 1 && strcmp(argv[1], "off") == 0)
+    vfdTraceStart(0);
+  else if (argc > 1 && strtoul(argv[1], nullptr, 10) > 0)
+    vfdTraceStart(strtoul(argv[1], nullptr, 10));
+  else
+    Serial.println(F("usage: trace <words>|off"));
+}
+
+static void cmd_isrload(int argc, char *argv[])
+{
+  const unsigned long seconds = argc > 1 ? strtoul(argv[1], nullptr, 10) : 0;
+  if (seconds == 0 || (argc > 2 && strcmp(argv[2], "erase") != 0))
+  {
+    Serial.println(F("usage: isrload <s> [erase]"));
+    return;
+  }
+  if (!isrProfileStart(min(seconds, (unsigned long)ISR_PROFILE_MAX_S), argc > 2))
+    Serial.println(F("no free flash"));
+  else
+    Serial.printf_P(PSTR("Measuring %lu s without and %lu s with flash load\n"), seconds, seconds);
+}
+
+//********************************************************************
+// HTTP routes, see http_server.h
+//********************************************************************
+
+static const char HTTP_INDEX_HEAD[] PROGMEM =
+    "<!DOCTYPE html><html><head><title>VFD Clock</title></head><body><h1>VFD Clock</h1><ul>";
+static const char HTTP_INDEX_LINKS[] PROGMEM =
+    "<li><a href=\"/status\">/status</a></li><li><a href=\"/config\">/config</a></li>"
+    "<li><a href=\"/stopwatch\">/stopwatch</a></li></ul>";
+static const char HTTP_INDEX_USAGE[] PROGMEM =
+    "<p>Set with POST /config?key=&lt;httpkey&gt;&amp;&lt;name&gt;=&lt;value&gt;, values separated by commas, "
+    "e.g. /config?key=secret&amp;hours=3,8,23&amp;brightness=5</p></body></html>";
+
+static bool http_index(const http_request_t *, http_response_t *response, uint16_t part)
+{
+  static PGM_P const PARTS[] = {HTTP_INDEX_HEAD, HTTP_INDEX_LINKS, HTTP_INDEX_USAGE};
+
+  if (part >= sizeof(PARTS) / sizeof(PARTS[0]))
+    return false;
+  httpSend_P(response, PARTS[part]);
+  return true;
+}
+
+static bool http_status(const http_request_t *, http_response_t *response, uint16_t part)
+{
+  static const char *const SYNC_SOURCES[] = {"none", "ntp", "rtc", "warm", "peer"};
+
+  switch (part)
+  {
+  case 0:
+    httpPrintf_P(response, PSTR("{\"utc\":%lu,\"sync\":\"%s\",\"source\":\"%s\",\"last_sync\":%u,"),
+                 (unsigned long)now(), timeStatus() == timeSet ? "ok" : "pending",
+                 SYNC_SOURCES[_sync_source % 5], _sync_state.last_sync_utc);
+    return true;
+  case 1:
+    httpPrintf_P(response, PSTR("\"offset_s\":%i,\"drift_ppb\":%i,\"ntp_delay_ms\":%u,\"rtc_fallbacks\":%u,"),
+                 _sync_state.offset_s, _sync_state.drift_ppb, _ntp_delay_ms, _rtc_fallbacks);
+    return true;
+  case 2:
+    httpPrintf_P(response, PSTR("\"display\":%u,\"uptime_s\":%lu,\"heap_free\":%u,\"rssi\":%i,"), _display_state,
+                 millis() / 1000UL, memMonitorStats()->heap_free, WiFi.RSSI());
+    return true;
+  case 3:
+  {
+    const radio_stats_t *radio = radioPowerStats();
+    httpPrintf_P(response, PSTR("\"radio\":{\"wakes\":%u,\"timeouts\":%u,\"reconnect_ms_max\":%u,"
+                                "\"first_sync_ms_max\":%u,\"late\":%u}}\n"),
+                 radio->wakes, radio->timeouts, radio->reconnect_ms_max, radio->first_sync_ms_max, radio->late_syncs);
+    return true;
+  }
+  default:
+    return false;
+  }
+}
+
+/**
+ * Every parameter is applied like 'config set <name> <value>', commas in the value separate the
+ * arguments.  A valid request is saved at once, unsaved edits of the debug terminal are dropped.
+ */
+static bool http_config(const http_request_t *request, http_response_t *response, uint16_t part)
+{
+  const vfd_config_t *config = configGet();
+
+  switch (part)
+  {
+  case 0:
+  {
+    char name[12];
+    char value[HTTP_QUERY_LEN];
+    char ntp_server[2 * CONFIG_NTP_SERVER_LEN];
+    size_t pos = 0;
+    bool changed = false;
+    if (request->query[0] != '\0' && !http_authorized(request, response))
+      return false;
+    _edit_config = *config;
+    _edit_config_valid = true;
+    while (httpNextParam(request, &pos, name, sizeof(name), value, sizeof(value)))
+    {
+      if (strcmp(name, "key") == 0)
+        continue;
+      char *argv[9] = {(char *)"config", (char *)"set", name};
+      int argc = 3;
+      char *save_ptr;
+      for (char *token = strtok_r(value, ",", &save_ptr); token != nullptr && argc < 9;
+           token = strtok_r(nullptr, ",", &save_ptr))
+        argv[argc++] = token;
+      if (!config_set(argc, argv))
       {
-        if (entry_requirements & 2)
-        {
-          if (entry_requirements & 4)
-          {
-            logOffVfd();
-            clearVfd();
-            entry_requirements = 0;
-            Serial.println(F("\n\n**********\nErasing your credentials."));
-            Serial.print(F("Do a WiFi scan and login on device "));
-            Serial.print(AP_NAME.c_str());
-            Serial.println(".\nAfter that open a new browser page.");
-            Serial.println("**********");
-            Serial.println();
-            Serial.println();
-            WiFiManager wifiManager;
-            wifiManager.resetSettings();
-            delay(1024UL);
-            ESP.restart();
-          }
-          else
-          {
-            entry_requirements |= 4;
-          }
-          Serial.println(F("\nW A R N I N G : This will erase your WiFi access credentials."));
-          Serial.println(F("Do you really want to erase them?  -  Then press 'w' for a third time."));
-        }
-        else
-        {
-          entry_requirements |= 2;
-        }
+        char escaped[6 * sizeof(name)];
+        _edit_config = *config;
+        httpJsonEscape(escaped, sizeof(escaped), name, sizeof(name));
+        httpSetStatus(response, 400);
+        httpPrintf_P(response, PSTR("{\"error\":\"%s\"}\n"), escaped);
+        return false;
       }
-      break;
+      changed = true;
+    }
+    if (changed && !save_edit_config())
+    {
+      httpSetStatus(response, 500);
+      httpSend_P(response, PSTR("{\"error\":\"flash\"}\n"));
+      return false;
+    }
+    httpJsonEscape(ntp_server, sizeof(ntp_server), config->ntp_server, sizeof(config->ntp_server));
+    httpPrintf_P(response, PSTR("{\"flags\":%u,\"tube\":\"%s\",\"brightness\":%u,\"port\":%u,\"ntp\":\"%s\","),
+                 config->flags, config->tube_type == VFD_TUBE_IV12 ? "iv12" : "iv3a", config->brightness,
+                 config->udp_local_port, ntp_server);
+    return true;
+  }
+  case 1:
+  case 2:
+  {
+    const TimeChangeRule &rule = part == 1 ? config->dst_rule : config->std_rule;
+    httpPrintf_P(response, PSTR("\"%s\":[\"%.5s\",%u,%u,%u,%u,%i],"), part == 1 ? "dst" : "std", rule.abbrev,
+                 rule.week, rule.dow, rule.month, rule.hour, rule.offset);
+    return true;
+  }
+  case 3:
+    httpPrintf_P(response, PSTR("\"hours\":[[%u,%u],[%u,%u],[%u,%u],[%u,%u],[%u,%u],[%u,%u],[%u,%u]],"),
+                 config->on_hour[0], config->off_hour[0], config->on_hour[1], config->off_hour[1],
+                 config->on_hour[2], config->off_hour[2], config->on_hour[3], config->off_hour[3],
+                 config->on_hour[4], config->off_hour[4], config->on_hour[5], config->off_hour[5],
+                 config->on_hour[6], config->off_hour[6]);
+    return true;
+  case 4:
+    httpPrintf_P(response, PSTR("\"lowheap\":%u,\"telemetry\":[\"%s\",%u,%u],"), config->low_heap_bytes,
+                 IPAddress(config->telemetry_ip).toString().c_str(), config->telemetry_port,
+                 config->telemetry_interval_s);
+    return true;
+  case 5:
+  {
+    char names[CONFIG_PAGE_CNT][sizeof(display_page_t::name)];
+    char message[6 * CONFIG_MESSAGE_LEN];
+    for (unsigned entry = 0; entry < CONFIG_PAGE_CNT; entry++)
+    {
+      if (config->page_s[entry] == 0 || !displayPageName(config->page[entry], names[entry], sizeof(names[entry])))
+        strcpy(names[entry], "off");
+    }
+    httpJsonEscape(message, sizeof(message), config->message, sizeof(config->message));
+    httpPrintf_P(response, PSTR("\"page\":[[\"%s\",%u],[\"%s\",%u],[\"%s\",%u],[\"%s\",%u]],\"message\":\"%s\"}\n"),
+                 names[0], config->page_s[0], names[1], config->page_s[1], names[2], config->page_s[2], names[3],
+                 config->page_s[3], message);
+    return true;
+  }
+  default:
+    return false;
+  }
+}
+
+static bool http_sync(const http_request_t *request, http_response_t *response, uint16_t part)
+{
+  if (part > 0 || !http_authorized(request, response))
+    return false;
+  _sync_requested = (configGet()->flags & CONFIG_WIFI_NTP_SYNC) != 0;
+  httpPrintf_P(response, PSTR("{\"sync\":\"%s\"}\n"), _sync_requested ? "requested" : "disabled");
+  return true;
+}
+
+static bool http_stopwatch(const http_request_t *request, http_response_t *response, uint16_t part)
+{
+  if (part > 0)
+    return false;
+  if (request->query[0] != '\0' && !http_authorized(request, response))
+    return false;
+  char name[8];
+  char value[8];
+  size_t pos = 0;
+  while (httpNextParam(request, &pos, name, sizeof(name), value, sizeof(value)))
+  {
+    if (strcmp(name, "cmd") != 0)
+      continue;
+    if (strcmp(value, "start") == 0)
+      controlVfdStopwatch(VFD_SW_START);
+    else if (strcmp(value, "stop") == 0)
+      controlVfdStopwatch(VFD_SW_STOP);
+    else if (strcmp(value, "lap") == 0)
+      controlVfdStopwatch(VFD_SW_LAP);
+    else if (strcmp(value, "reset") == 0)
+      controlVfdStopwatch(VFD_SW_RESET);
+    else
+    {
+      char escaped[6 * sizeof(value)];
+      httpJsonEscape(escaped, sizeof(escaped), value, sizeof(value));
+      httpSetStatus(response, 400);
+      httpPrintf_P(response, PSTR("{\"error\":\"%s\"}\n"), escaped);
+      return false;
     }
   }
+  httpPrintf_P(response, PSTR("{\"ms\":%u}\n"), getVfdStopwatchMs());
+  return true;
+}
+
+/**
+ * Requests changing the clock have to be POST requests with the parameter key=<httpkey of the configuration>.
+ * So neither a link nor a form of another web page can change the clock through the browser of the lab.  An
+ * empty key refuses all of them.
+ */
+static bool http_authorized(const http_request_t *request, http_response_t *response)
+{
+  char name[12];
+  char value[CONFIG_HTTP_KEY_LEN + 1];
+  char http_key[CONFIG_HTTP_KEY_LEN + 1];
+  size_t pos = 0;
+  uint8_t differs = 1;
+
+  if (request->method != HTTP_POST)
+  {
+    httpSetStatus(response, 405);
+    httpSend_P(response, PSTR("{\"error\":\"post\"}\n"));
+    return false;
+  }
+  memset(http_key, 0, sizeof(http_key));
+  strncpy(http_key, configGet()->http_key, CONFIG_HTTP_KEY_LEN - 1);
+  while (http_key[0] != '\0' && httpNextParam(request, &pos, name, sizeof(name), value, sizeof(value)))
+  {
+    if (strcmp(name, "key") != 0)
+      continue;
+    // Compared in constant time, a longer value differs in its last byte
+    const size_t len = strlen(value);
+    memset(value + len, 0, sizeof(value) - len);
+    differs = 0;
+    for (size_t i = 0; i < sizeof(value); i++)
+      differs |= value[i] ^ http_key[i];
+    break;
+  }
+  if (differs != 0)
+  {
+    httpSetStatus(response, 403);
+    httpSend_P(response, PSTR("{\"error\":\"key\"}\n"));
+    return false;
+  }
+  return true;
 }
@@ -0,0 +1,152 @@
+#include "mem_monitor.h"
+
+#include <Arduino.h>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include "event_log.h"
+
+extern "C" char _heap_start[]; // Provided by the linker script
+
+// Layout of the umm_malloc heap of the core, see cores/esp8266/umm_malloc/umm_malloc.cpp.  It is private to the
+// core, so platformio.ini pins the platform version and the first walk is checked against the core.
+static const uint32_t UMM_HEAP_END = 0x3FFFC000UL;
+static const uint16_t UMM_FREELIST_MASK = 0x8000U;
+static const uint16_t UMM_BLOCKNO_MASK = 0x7FFFU;
+
+/// Block of the heap, each allocation or free area starts with one.
+typedef struct
+{
+  uint16_t next; ///< Number of the next block, UMM_FREELIST_MASK set if this one is free
+  uint16_t prev; ///< Number of the previous block
+  uint32_t body; ///< Free list links or user data
+} umm_block_t;
+
+/// Use of walk_heap(), it is checked against the core by the first sample.
+typedef enum
+{
+  HEAP_WALK_UNCHECKED,
+  HEAP_WALK_CHECKED,
+  HEAP_WALK_OFF ///< The walk disagreed with the core, only the core is used
+} heap_walk_state_e;
+
+// Local variables
+static mem_stats_t _stats;
+static uint8_t _walk_state = HEAP_WALK_UNCHECKED;
+
+// Local function prototypes
+static bool walk_heap(uint32_t *heap_free, uint16_t *block_max, uint8_t *fragmentation);
+static void check_walk(uint32_t heap_free, uint16_t block_max, uint8_t fragmentation);
+
+bool memMonitorSample(uint16_t threshold_bytes)
+{
+  uint32_t heap_free;
+  uint16_t block_max;
+  uint8_t fragmentation;
+
+  // One walk of the heap for all three values.  The core walks it with the interrupts off, which delays the
+  // display interrupt, so it is used only if the heap changed during the own walk.
+  if (_walk_state == HEAP_WALK_OFF || !walk_heap(&heap_free, &block_max, &fragmentation))
+    ESP.getHeapStats(&heap_free, &block_max, &fragmentation);
+  else if (_walk_state == HEAP_WALK_UNCHECKED)
+    check_walk(heap_free, block_max, fragmentation);
+  if (_stats.samples == 0)
+  {
+    _stats.heap_free_min = _stats.heap_free_max = heap_free;
+    _stats.block_max_min = block_max;
+    _stats.fragmentation_max = fragmentation;
+  }
+  _stats.samples++;
+  _stats.heap_free = heap_free;
+  _stats.block_max = block_max;
+  _stats.fragmentation = fragmentation;
+  if (heap_free < _stats.heap_free_min)
+    _stats.heap_free_min = heap_free;
+  if (heap_free > _stats.heap_free_max)
+    _stats.heap_free_max = heap_free;
+  if (block_max < _stats.block_max_min)
+    _stats.block_max_min = block_max;
+  if (fragmentation > _stats.fragmentation_max)
+    _stats.fragmentation_max = fragmentation;
+  // The core paints the stack of the loop() context, so this is a watermark already.
+  _stats.stack_free_min = ESP.getFreeContStack();
+  // A single dip, e.g. while a TCP connection is set up, is no reason to restart.
+  if (threshold_bytes == 0 || block_max >= threshold_bytes)
+    _stats.low_samples = 0;
+  else if (_stats.low_samples < MEM_MONITOR_LOW_SAMPLES)
+    _stats.low_samples++;
+  return _stats.low_samples >= MEM_MONITOR_LOW_SAMPLES;
+}
+
+const mem_stats_t *memMonitorStats()
+{
+  return &_stats;
+}
+
+void memMonitorReset()
+{
+  const uint32_t stack_free_min = _stats.stack_free_min;
+  memset(&_stats, 0, sizeof(_stats));
+  _stats.stack_free_min = stack_free_min;
+}
+
+//********************************************************************
+// Local functions
+//********************************************************************
+
+// Same walk and metrics as umm_info() of the core, but the interrupts are off only while the header of a block
+// is copied.  In the loop() context the heap is not changed by the tasks of the SDK, only an interrupt handler
+// could do so.  Then the block numbers may not ascend any more and the walk fails.
+static bool walk_heap(uint32_t *heap_free, uint16_t *block_max, uint8_t *fragmentation)
+{
+  const umm_block_t *heap = reinterpret_cast<const umm_block_t *>(_heap_start);
+  const uint32_t block_cnt = (UMM_HEAP_END - (uint32_t)(uintptr_t)_heap_start) / sizeof(umm_block_t);
+  uint32_t free_blocks = 0;
+  uint32_t free_blocks_square = 0;
+  uint32_t free_blocks_max = 0;
+  uint32_t block = 0;
+
+  for (;;)
+  {
+    noInterrupts();
+    const uint16_t header = heap[block].next;
+    interrupts();
+    const uint32_t next = header & UMM_BLOCKNO_MASK;
+    if (next == 0)
+      break; // End of the heap
+    if (next <= block || next >= block_cnt)
+      return false;
+    if (block > 0 && (header & UMM_FREELIST_MASK))
+    {
+      const uint32_t size = next - block;
+      free_blocks += size;
+      free_blocks_square += size * size;
+      if (size > free_blocks_max)
+        free_blocks_max = size;
+    }
+    block = next;
+  }
+  *heap_free = free_blocks * sizeof(umm_block_t);
+  const uint32_t block_max_bytes = free_blocks_max * sizeof(umm_block_t);
+  *block_max = block_max_bytes > UINT16_MAX ? UINT16_MAX : (uint16_t)block_max_bytes;
+  *fragmentation = free_blocks == 0 ? 0 : 100U - (uint32_t)sqrtf((float)free_blocks_square) * 100U / free_blocks;
+  return true;
+}
+
+// Compares a walk with the figures of the core.  Nothing is allocated in between, the fragmentation may differ
+// by the rounding.  A core with another heap layout turns the walk off for good.
+static void check_walk(uint32_t heap_free, uint16_t block_max, uint8_t fragmentation)
+{
+  uint32_t core_heap_free;
+  uint16_t core_block_max;
+  uint8_t core_fragmentation;
+
+  ESP.getHeapStats(&core_heap_free, &core_block_max, &core_fragmentation);
+  if (heap_free == core_heap_free && block_max == core_block_max && abs(fragmentation - core_fragmentation) <= 1)
+  {
+    _walk_state = HEAP_WALK_CHECKED;
+    return;
+  }
+  _walk_state = HEAP_WALK_OFF;
+  eventLog(EV_HEAP_WALK_OFF, heap_free, core_heap_free);
+}
@@ -0,0 +1,57 @@
+/**
+  \file   mem_monitor.h
+  \brief  Watermarks of the heap and the stack of the loop() context.
+
+  The WiFi stack, the WiFiManager and the NTP client allocate from the heap
+  where it cannot be seen from the application.  memMonitorSample() is called
+  once a second and keeps minima and maxima of the free heap, the largest free
+  block, the fragmentation and the free stack of the loop() context.  A sample
+  walks the heap once, the interrupts are turned off only while the header of a
+  block is copied.  The walk follows the heap layout of the core version pinned
+  in platformio.ini.  The first sample compares it with ESP.getHeapStats(), if
+  they disagree only the core is used from then on.  The stack watermark is kept
+  by the core.
+
+  An allocation fails if there is no block large enough, even if the total of
+  free heap would be sufficient.  So the low memory check of memMonitorSample()
+  is done on the largest free block, the caller is expected to restart the
+  clock in a clean way before an allocation in the NTP or WiFi code fails.
+*/
+#ifndef MEM_MONITOR_H
+#define MEM_MONITOR_H
+
+#include <cstdint>
+
+/// Count of consecutive low samples needed to report low memory.
+const uint8_t MEM_MONITOR_LOW_SAMPLES = 3U;
+
+/// Watermarks of the memory usage
+typedef struct
+{
+  uint32_t samples;           ///< Count of samples since the last reset
+  uint32_t heap_free;         ///< Free heap of the last sample
+  uint32_t heap_free_min;     ///< Least free heap
+  uint32_t heap_free_max;     ///< Most free heap
+  uint16_t block_max;         ///< Largest free block of the last sample
+  uint16_t block_max_min;     ///< Least size of the largest free block
+  uint8_t fragmentation;      ///< Fragmentation of the last sample in percent
+  uint8_t fragmentation_max;  ///< Worst fragmentation in percent
+  uint8_t low_samples;        ///< Consecutive samples below the threshold
+  uint8_t reserved;           ///< Always 0
+  uint32_t stack_free_min;    ///< Least free stack of the loop() context since boot
+} mem_stats_t;
+
+/**
+ * \brief Takes a sample.  To be called from loop() once a second.
+ * \param threshold_bytes Least size of the largest free block, 0 disables the check.
+ * \return true if the largest free block was below the threshold for MEM_MONITOR_LOW_SAMPLES samples.
+ */
+bool memMonitorSample(uint16_t threshold_bytes);
+
+/// Watermarks since the last reset.
+const mem_stats_t *memMonitorStats();
+
+/// Starts the minima and maxima over.  The stack watermark is kept.
+void memMonitorReset();
+
+#endif // MEM_MONITOR_H
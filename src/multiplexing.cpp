@@ -4,30 +4,35 @@
 #include "hv5812.h"
 #include <Ticker.h>
 #include <cstdbool>
+#include <climits>
 #include <cstring>
+#include "spsc_ring.h"
 
 // Don't change this.  It's only for the internal build logic.
-#define VFR_TUBE_IV3A 1
-#define VFR_TUBE_IV12 2
+#define VFR_TUBE_IV3A VFD_TUBE_IV3A
+#define VFR_TUBE_IV12 VFD_TUBE_IV12
 
 //********************************************************************
 // User configurable area - depends on clock hardware
 //********************************************************************
 
+// Default if there is no tube type given by setVfdTubeType().
 // !!!You must select exactly ONE of these!!!
 #define ACTIVE_VFR_TUBE VFR_TUBE_IV3A
 //#define ACTIVE_VFR_TUBE VFR_TUBE_IV12
 
+/// Constant tables read by the ISR are kept in RAM, the flash cache is off while the flash is written.
+#define VFD_ISR_DATA __attribute__((section(".data.vfd_isr")))
+
 /// PINS of Gate muxing of shift reg
-const uint8_t GATE[3] = {16, 17, 18};
+const uint8_t GATE[3] VFD_ISR_DATA = {16, 17, 18};
 
 // XX.XX.XX -> dot position
 #define MONAT_DP 0x00008000L
 #define TAG_DP 0x00000080L
 
-#if ACTIVE_VFR_TUBE == VFR_TUBE_IV3A
 /*Elements of the IV3A-tubes */
-const uint8_t SEG_7[33] = {
+const uint8_t SEG_7_IV3A[33] VFD_ISR_DATA = {
     //  HDCBAGFE   H=decimal point not in every tube
     0b01111011, // 0
     0b00110000, // 1
@@ -55,16 +60,16 @@ const uint8_t SEG_7[33] = {
     0b00110000, // l
     0b01001111, // E
     0b01101110, // S
-    0b00000000, // dark
-    0b00000000, // dark
-    0b00000000, // dark
-    0b00000000, // dark
-    0b00000000, // dark
-    0b00000000  // dark
+    0b00000100, // -
+    0b01100101, // o
+    0b00000101, // r
+    0b01000111, // t
+    0b01100001, // u
+    0b00110111  // H
 };
-#elif ACTIVE_VFR_TUBE == VFR_TUBE_IV12
+
 /*Elements of the IV22b-tubes */
-const uint8_t SEG_7[33] = {
+const uint8_t SEG_7_IV12[33] VFD_ISR_DATA = {
     //  HGFEDCBA   H=decimal point not in every tube
     0b01110111, // 0
     0b00100100, // 1
@@ -92,29 +97,139 @@ const uint8_t SEG_7[33] = {
     0b00100100, // l
     0b01011011, // E
     0b01101011, // S
-    0b00000000, // dark
-    0b00000000, // dark
-    0b00000000, // dark
-    0b00000000, // dark
-    0b00000000, // dark
-    0b00000000  // dark
+    0b00001000, // -
+    0b01111000, // o
+    0b00011000, // r
+    0b01011010, // t
+    0b01110000, // u
+    0b00111110  // H
 };
-#endif
 
 // Local constants
 static const uint16_t US_PRO_MS = 1000;
 static const uint8_t TICKS_PRO_US = 5; // 5 ticks/us if timer1_enable(TIM_DIV16,...)
 static const uint32_t TIMER_TICKS = VFD_REFRESH_MS_PERIOD * US_PRO_MS * TICKS_PRO_US;
+static const uint8_t VFD_CMD_QUEUE_LEN = 8; // Must be a power of two
+static const uint8_t VFD_CMD_DRAIN_MAX = VFD_CMD_QUEUE_LEN; // Commands handled per slot at most
+static const uint32_t CYCLES_PRO_MS = F_CPU / US_PRO_MS;
+static const uint32_t CYCLES_PRO_US = F_CPU / (US_PRO_MS * US_PRO_MS);
+static const uint32_t SLOT_CYCLES = VFD_REFRESH_MS_PERIOD * CYCLES_PRO_MS;
+static const uint16_t VFD_TRACE_RING_LEN = 64; // Must be a power of two, 160 ms at full brightness
+static const uint32_t VFD_TRACE_WORD_MASK = 0x000FFFFFUL;
+static const uint8_t VFD_TRACE_SEQ_SHIFT = 20;
+
+/// Types of the commands passed from the application to the display ISR.
+typedef enum
+{
+  VFD_CMD_SET_FRAME,       ///< Replace the digits of all tubes and resync the dots
+  VFD_CMD_SET_TUBES,       ///< Replace the digits of some tubes, the dots keep their phase
+  VFD_CMD_ARM_FRAME,       ///< Store a frame to be shown by commitVfdFrame()
+  VFD_CMD_SET_BLINK,       ///< Change the dot blinking behaviour
+  VFD_CMD_SET_BRIGHTNESS,  ///< Change the on-time per multiplex slot
+  VFD_CMD_START_ANIMATION, ///< Start or stop playing a flash resident animation
+  VFD_CMD_STOPWATCH,       ///< Control the stopwatch
+  VFD_CMD_SHUTDOWN         ///< Stop the background interrupt
+} vfd_cmd_type_e;
+
+/// Display command as it is stored in the command queue.
+typedef struct
+{
+  uint8_t type; ///< One of vfd_cmd_type_e
+  union {
+    uint8_t frame[VFD_TUBE_CNT];      ///< VFD_CMD_SET_FRAME
+    struct
+    {
+      uint8_t frame[VFD_TUBE_CNT];
+      uint8_t tube_mask;
+    } tubes; ///< VFD_CMD_SET_TUBES
+    int16_t dot_blink_ms_half_period; ///< VFD_CMD_SET_BLINK
+    uint8_t brightness;               ///< VFD_CMD_SET_BRIGHTNESS
+    struct
+    {
+      uint8_t frame[VFD_TUBE_CNT];
+      int16_t dot_blink_ms_half_period;
+    } armed; ///< VFD_CMD_ARM_FRAME
+    struct
+    {
+      const vfd_animation_t *animation; ///< nullptr stops the animation
+      uint8_t tube_mask;
+      uint8_t sequence; ///< Identifies the animation for isVfdAnimationRunning()
+    } start;                            ///< VFD_CMD_START_ANIMATION
+    struct
+    {
+      uint32_t arg;
+      uint8_t op; ///< One of vfd_stopwatch_op_e
+    } stopwatch;  ///< VFD_CMD_STOPWATCH
+  } arg;
+} vfd_cmd_t;
+
+/// RAM copy of an animation, the ISR never reads the frames from flash.
+typedef struct
+{
+  vfd_animation_t animation; ///< Descriptor pointing to frames
+  uint8_t frames[VFD_ANIM_FRAMES_MAX][VFD_TUBE_CNT];
+} vfd_anim_copy_t;
+
+// Local variables shared between application and ISR
+static const uint8_t *_seg_7 = (ACTIVE_VFR_TUBE == VFR_TUBE_IV12) ? SEG_7_IV12 : SEG_7_IV3A;
+static SpscRing<vfd_cmd_t, VFD_CMD_QUEUE_LEN> _cmd_queue;
+static volatile bool _isr_running;
+static volatile uint8_t _anim_finished_sequence;
+static volatile uint8_t _anim_taken_sequence; // Start command consumed last by the ISR
+static vfd_anim_copy_t _anim_copies[2]; // The ISR plays one while the next one is prepared
+static volatile uint32_t _sw_ms;
+static volatile bool _armed_commit_pending;
+static volatile uint32_t _isr_max_cycles;
+static volatile uint32_t _isr_max_jitter_cycles;
+static volatile uint32_t _isr_slots;
+static volatile uint32_t _isr_peak_cycles; // Maxima of getVfdIsrPeak()
+static volatile uint32_t _isr_peak_jitter_cycles;
+static volatile uint32_t _isr_peak_slots;
+static uint32_t _isr_slot_ccount; // 0 after a start of the ISR
+static SpscRing<vfd_trace_word_t, VFD_TRACE_RING_LEN> _trace_ring;
+static volatile uint32_t _trace_remaining;
+static uint16_t _trace_seq;
+
+// Local variables of the application side
+static int _posted_dot_blink_ms_period = INT_MIN;
+static uint8_t _anim_started_sequence;
+static uint8_t _anim_copy_posted;
+static vfd_stopwatch_format_e _sw_posted_format = VFD_SW_HIDDEN;
 
-// Local variables
-static bool _has_to_be_configured = true;
+// Local variables owned by the ISR
 static uint8_t _vfd_output[VFD_TUBE_CNT];
 static int _dot_blink_ms_half_period;
-static bool _vfd_update_necessary;
-static bool _vfd_log_off_necessary;
+static bool _dot_resync_necessary;
+static uint32_t _on_ticks = TIMER_TICKS;
+static uint8_t _armed_output[VFD_TUBE_CNT];
+static int _armed_dot_blink_ms_half_period;
+static bool _armed_is_valid;
+static const vfd_animation_t *_anim;
+static uint8_t _anim_tube_mask;
+static uint8_t _anim_sequence;
+static uint16_t _anim_frame;
+static uint16_t _anim_ms_counter;
+static uint8_t _sw_format;
+static bool _sw_running;
+static bool _sw_counts_down;
+static bool _sw_lap_shown;
+static uint32_t _sw_lap_ms;
+static uint32_t _sw_last_ccount;
+static uint32_t _sw_cycle_acc;
 
 // Local function prototypes
+static bool vfd_post(const vfd_cmd_t &cmd);
+static int16_t vfd_half_period(int dot_blink_ms_period);
+static void vfd_start_isr();
+static bool ICACHE_RAM_ATTR vfd_drain_commands();
+static void ICACHE_RAM_ATTR vfd_step_animation();
+static uint8_t ICACHE_RAM_ATTR vfd_glyph(uint8_t tube);
+static void ICACHE_RAM_ATTR vfd_control_stopwatch(uint8_t op, uint32_t arg);
+static void ICACHE_RAM_ATTR vfd_step_stopwatch();
+static uint8_t ICACHE_RAM_ATTR vfd_stopwatch_digit(uint8_t tube);
+static void ICACHE_RAM_ATTR vfd_refresh_slot();
 static void ICACHE_RAM_ATTR vfd_refresh_callback();
+static void ICACHE_RAM_ATTR vfd_output_word(long content_sreg);
 
 void clearVfd()
 {
@@ -125,9 +240,16 @@ void clearVfd()
 
 void logOffVfd()
 {
-  // This will be recognized by the callback function of the interrupt.
-  _vfd_log_off_necessary = true;
-  _has_to_be_configured = true;
+  // Nothing to stop if the interrupt is not running.  Only the ISR itself
+  // clears this flag and only after it has consumed a shutdown command.
+  if (!_isr_running)
+    return;
+  vfd_cmd_t cmd;
+  cmd.type = VFD_CMD_SHUTDOWN;
+  // The ISR drains the whole queue within one slot, so waiting is bounded.
+  while (!_cmd_queue.push(cmd))
+    yield();
+  _posted_dot_blink_ms_period = INT_MIN;
 }
 
 void setVfd(const uint8_t vfd_output[VFD_TUBE_CNT])
@@ -135,7 +257,7 @@ void setVfd(const uint8_t vfd_output[VFD_TUBE_CNT])
   static uint8_t mux_gate;
 
   // Compute value for the output shift register
-  long content_sreg = ((SEG_7[vfd_output[mux_gate]] << 8) | SEG_7[vfd_output[mux_gate + 3]] | (1 << GATE[mux_gate]));
+  long content_sreg = ((_seg_7[vfd_output[mux_gate]] << 8) | _seg_7[vfd_output[mux_gate + 3]] | (1 << GATE[mux_gate]));
   // Send this to shift register for output
   HV5812_vfdDriver(content_sreg);
   // Select gate for the next round
@@ -145,57 +267,473 @@ void setVfd(const uint8_t vfd_output[VFD_TUBE_CNT])
 
 void updateVfd(const uint8_t vfd_output[VFD_TUBE_CNT], int dot_blink_ms_period)
 {
-  // Parameter copy for interrupt handler function
-  // TODO: Maybe we should lock timer interrupt while doing this?
-  memcpy(_vfd_output, vfd_output, sizeof(vfd_output[0]) * VFD_TUBE_CNT);
-  // The dot thing is special
-  if (dot_blink_ms_period < 0)
-    _dot_blink_ms_half_period = -1;
-  else
-    _dot_blink_ms_half_period = dot_blink_ms_period / 2;
-  // Sync with interrupt
-  _vfd_update_necessary = true;
-  // This has to be done only once
-  if (_has_to_be_configured)
-  {
-    timer1_isr_init();
-    timer1_attachInterrupt(vfd_refresh_callback);
-    timer1_enable(TIM_DIV16, TIM_EDGE, TIM_SINGLE);
-    timer1_write(TIMER_TICKS); // 5 ms refresh rate for VFD tubes
-    _has_to_be_configured = false;
+  vfd_cmd_t cmd;
+
+  // The dot thing is special and only sent if it was changed
+  if (dot_blink_ms_period != _posted_dot_blink_ms_period)
+  {
+    cmd.type = VFD_CMD_SET_BLINK;
+    cmd.arg.dot_blink_ms_half_period = vfd_half_period(dot_blink_ms_period);
+    if (vfd_post(cmd))
+      _posted_dot_blink_ms_period = dot_blink_ms_period;
   }
+  // Frame copy is done by the queue, the ISR never sees a half written frame
+  cmd.type = VFD_CMD_SET_FRAME;
+  memcpy(cmd.arg.frame, vfd_output, sizeof(vfd_output[0]) * VFD_TUBE_CNT);
+  vfd_post(cmd);
+}
+
+void updateVfdTubes(const uint8_t vfd_output[VFD_TUBE_CNT], uint8_t tube_mask)
+{
+  vfd_cmd_t cmd;
+
+  cmd.type = VFD_CMD_SET_TUBES;
+  memcpy(cmd.arg.tubes.frame, vfd_output, sizeof(vfd_output[0]) * VFD_TUBE_CNT);
+  cmd.arg.tubes.tube_mask = tube_mask & VFD_ALL_TUBES;
+  vfd_post(cmd);
+}
+
+uint8_t getVfdGlyph(char c)
+{
+  static const char LETTERS[] = "nilS-ortuH";
+  static const uint8_t LETTER_GLYPHS[] = {19, 20, 23, 25, 26, 27, 28, 29, 30, 31};
+
+  if (c >= '0' && c <= '9')
+    return c - '0';
+  if (c >= 'A' && c <= 'F')
+    return c - 'A' + 10;
+  if (c >= 'a' && c <= 'f')
+    return c - 'a' + 10;
+  if (c == '\0')
+    return VFD_BLANK;
+  const char *letter = strchr(LETTERS, c);
+  if (letter == nullptr)
+    letter = strchr(LETTERS, c ^ 0x20); // the other case
+  return letter != nullptr ? LETTER_GLYPHS[letter - LETTERS] : VFD_BLANK;
+}
+
+void setVfdTubeType(uint8_t tube_type)
+{
+  // A single aligned pointer store, the ISR sees either the old or the new table.
+  _seg_7 = (tube_type == VFD_TUBE_IV12) ? SEG_7_IV12 : SEG_7_IV3A;
+}
+
+uint8_t getVfdTubeType()
+{
+  return (_seg_7 == SEG_7_IV12) ? VFD_TUBE_IV12 : VFD_TUBE_IV3A;
+}
+
+void armVfdFrame(const uint8_t vfd_output[VFD_TUBE_CNT], int dot_blink_ms_period)
+{
+  vfd_cmd_t cmd;
+
+  cmd.type = VFD_CMD_ARM_FRAME;
+  memcpy(cmd.arg.armed.frame, vfd_output, sizeof(vfd_output[0]) * VFD_TUBE_CNT);
+  cmd.arg.armed.dot_blink_ms_half_period = vfd_half_period(dot_blink_ms_period);
+  // The blinking of the armed frame replaces the one given by updateVfd().
+  if (vfd_post(cmd))
+    _posted_dot_blink_ms_period = dot_blink_ms_period;
+}
+
+void ICACHE_RAM_ATTR commitVfdFrame()
+{
+  _armed_commit_pending = true;
+}
+
+void setVfdBrightness(uint8_t brightness)
+{
+  vfd_cmd_t cmd;
+
+  cmd.type = VFD_CMD_SET_BRIGHTNESS;
+  cmd.arg.brightness = min(brightness, VFD_BRIGHTNESS_MAX);
+  vfd_post(cmd);
+}
+
+void startVfdAnimation(const vfd_animation_t *animation, uint8_t tube_mask)
+{
+  vfd_cmd_t cmd;
+
+  cmd.type = VFD_CMD_START_ANIMATION;
+  cmd.arg.start.animation = nullptr;
+  if (animation != nullptr)
+  {
+    // The other copy is free once the ISR has taken the animation started before.
+    while (_isr_running && _anim_taken_sequence != _anim_started_sequence)
+      yield();
+    vfd_anim_copy_t *copy = &_anim_copies[_anim_copy_posted ^ 1U];
+    copy->animation = *animation;
+    copy->animation.frames = copy->frames;
+    copy->animation.frame_cnt = min(animation->frame_cnt, VFD_ANIM_FRAMES_MAX);
+    memcpy_P(copy->frames, animation->frames, copy->animation.frame_cnt * sizeof(copy->frames[0]));
+    cmd.arg.start.animation = &copy->animation;
+  }
+  cmd.arg.start.tube_mask = tube_mask & VFD_ALL_TUBES;
+  cmd.arg.start.sequence = animation ? ++_anim_started_sequence : _anim_started_sequence;
+  if (!vfd_post(cmd) && animation)
+    _anim_started_sequence--; // Dropped, so it never runs
+  else if (animation)
+    _anim_copy_posted ^= 1U;
+}
+
+bool isVfdAnimationRunning()
+{
+  return _anim_finished_sequence != _anim_started_sequence;
+}
+
+void controlVfdStopwatch(vfd_stopwatch_op_e op, uint32_t arg)
+{
+  vfd_cmd_t cmd;
+
+  cmd.type = VFD_CMD_STOPWATCH;
+  cmd.arg.stopwatch.op = op;
+  cmd.arg.stopwatch.arg = arg;
+  if (vfd_post(cmd) && op == VFD_SW_SHOW)
+    _sw_posted_format = (vfd_stopwatch_format_e)arg;
+}
+
+vfd_stopwatch_format_e getVfdStopwatchFormat()
+{
+  return _sw_posted_format;
+}
+
+uint32_t getVfdStopwatchMs()
+{
+  return _sw_ms;
+}
+
+void getVfdIsrStats(vfd_isr_stats_t *stats, bool reset)
+{
+  stats->max_us = _isr_max_cycles / CYCLES_PRO_US;
+  stats->max_jitter_us = _isr_max_jitter_cycles / CYCLES_PRO_US;
+  stats->slots = _isr_slots;
+  if (reset)
+  { // A run of the ISR in between is lost, which does not matter for maxima.
+    _isr_max_cycles = 0;
+    _isr_max_jitter_cycles = 0;
+    _isr_slots = 0;
+  }
+}
+
+void getVfdIsrPeak(vfd_isr_stats_t *stats, bool reset)
+{
+  stats->max_us = _isr_peak_cycles / CYCLES_PRO_US;
+  stats->max_jitter_us = _isr_peak_jitter_cycles / CYCLES_PRO_US;
+  stats->slots = _isr_peak_slots;
+  if (reset)
+  {
+    _isr_peak_cycles = 0;
+    _isr_peak_jitter_cycles = 0;
+    _isr_peak_slots = 0;
+  }
+}
+
+void startVfdTrace(uint32_t word_cnt)
+{
+  _trace_remaining = word_cnt; // a single aligned store
+}
+
+bool getVfdTraceWord(vfd_trace_word_t *word)
+{
+  return _trace_ring.pop(*word);
+}
+
+bool isVfdTraceRunning()
+{
+  return _trace_remaining != 0;
 }
 
 //********************************************************************
 // Local functions
 //********************************************************************
 
-// This callback function should be called by timer ISR.
+// Queue a command and make sure there is an ISR consuming it.
+static bool vfd_post(const vfd_cmd_t &cmd)
+{
+  bool is_posted = _cmd_queue.push(cmd);
+  // Checked after the push: If the ISR is still running it will see the new
+  // command before it is able to stop.
+  if (!_isr_running)
+    vfd_start_isr();
+  return is_posted;
+}
+
+// Dot period as it is used by the ISR.
+static int16_t vfd_half_period(int dot_blink_ms_period)
+{
+  if (dot_blink_ms_period < 0)
+    return -1;
+  return (int16_t)min(dot_blink_ms_period / 2, (int)INT16_MAX);
+}
+
+static void vfd_start_isr()
+{
+  _isr_running = true;
+  _isr_slot_ccount = 0;
+  timer1_isr_init();
+  timer1_attachInterrupt(vfd_refresh_callback);
+  timer1_enable(TIM_DIV16, TIM_EDGE, TIM_SINGLE);
+  timer1_write(TIMER_TICKS); // 5 ms refresh rate for VFD tubes
+}
+
+// Apply queued commands in order.  Returns false if the ISR has been stopped.
+static bool ICACHE_RAM_ATTR vfd_drain_commands()
+{
+  vfd_cmd_t cmd;
+
+  for (uint8_t i = 0; i < VFD_CMD_DRAIN_MAX && _cmd_queue.pop(cmd); i++)
+  {
+    switch (cmd.type)
+    {
+    case VFD_CMD_SET_FRAME:
+      memcpy(_vfd_output, cmd.arg.frame, sizeof(_vfd_output));
+      _dot_resync_necessary = true;
+      break;
+    case VFD_CMD_SET_TUBES:
+      for (uint8_t tube = 0; tube < VFD_TUBE_CNT; tube++)
+      {
+        if (cmd.arg.tubes.tube_mask & (1U << tube))
+          _vfd_output[tube] = cmd.arg.tubes.frame[tube];
+      }
+      break;
+    case VFD_CMD_ARM_FRAME:
+      memcpy(_armed_output, cmd.arg.armed.frame, sizeof(_armed_output));
+      _armed_dot_blink_ms_half_period = cmd.arg.armed.dot_blink_ms_half_period;
+      _armed_is_valid = true;
+      break;
+    case VFD_CMD_SET_BLINK:
+      _dot_blink_ms_half_period = cmd.arg.dot_blink_ms_half_period;
+      break;
+    case VFD_CMD_SET_BRIGHTNESS:
+      _on_ticks = (TIMER_TICKS * cmd.arg.brightness) / VFD_BRIGHTNESS_MAX;
+      break;
+    case VFD_CMD_START_ANIMATION:
+      _anim_finished_sequence = _anim_sequence; // A replaced animation is done
+      _anim = cmd.arg.start.animation;
+      _anim_tube_mask = cmd.arg.start.tube_mask;
+      _anim_sequence = cmd.arg.start.sequence;
+      _anim_taken_sequence = _anim_sequence;
+      _anim_frame = 0;
+      _anim_ms_counter = 0;
+      if (_anim == nullptr || _anim->frame_cnt == 0)
+      {
+        _anim = nullptr;
+        _anim_finished_sequence = _anim_sequence;
+      }
+      break;
+    case VFD_CMD_STOPWATCH:
+      vfd_control_stopwatch(cmd.arg.stopwatch.op, cmd.arg.stopwatch.arg);
+      break;
+    case VFD_CMD_SHUTDOWN:
+      // Commands queued behind the shutdown mean the display is wanted again.
+      if (_cmd_queue.empty())
+      {
+        _anim = nullptr;
+        _anim_finished_sequence = _anim_sequence;
+        timer1_disable();
+        timer1_detachInterrupt();
+        _isr_running = false;
+        return false;
+      }
+      break;
+    }
+  }
+  return true;
+}
+
+// Advance the animation.  Frames change only on a multiplex boundary.
+static void ICACHE_RAM_ATTR vfd_step_animation()
+{
+  if (_anim == nullptr)
+    return;
+  if (_anim_ms_counter < _anim->frame_ms_period)
+    return;
+  _anim_ms_counter = 0;
+  if (++_anim_frame >= _anim->frame_cnt)
+  {
+    if (_anim->flags & VFD_ANIM_LOOP)
+    {
+      _anim_frame = 0;
+    }
+    else
+    {
+      _anim = nullptr;
+      _anim_finished_sequence = _anim_sequence;
+    }
+  }
+}
+
+// Glyph of a tube, taken from the animation frame if there is one.
+static uint8_t ICACHE_RAM_ATTR vfd_glyph(uint8_t tube)
+{
+  if (_sw_format != VFD_SW_HIDDEN)
+    return vfd_stopwatch_digit(tube);
+  if (_anim != nullptr && (_anim_tube_mask & (1U << tube)))
+  {
+    uint8_t glyph = _anim->frames[_anim_frame][tube];
+    if (glyph != VFD_KEEP)
+      return glyph;
+  }
+  return _vfd_output[tube];
+}
+
+static void ICACHE_RAM_ATTR vfd_control_stopwatch(uint8_t op, uint32_t arg)
+{
+  switch (op)
+  {
+  case VFD_SW_SHOW:
+    _sw_format = (arg <= VFD_SW_SSS_MMM) ? (uint8_t)arg : (uint8_t)VFD_SW_HIDDEN;
+    break;
+  case VFD_SW_TOGGLE:
+    if (_sw_running)
+    {
+      _sw_running = false;
+      break;
+    }
+    // fall through
+  case VFD_SW_START:
+    if (!_sw_running && !(_sw_counts_down && _sw_ms == 0))
+    {
+      _sw_last_ccount = ESP.getCycleCount();
+      _sw_running = true;
+    }
+    break;
+  case VFD_SW_STOP:
+    _sw_running = false;
+    break;
+  case VFD_SW_LAP:
+    _sw_lap_ms = _sw_ms;
+    _sw_lap_shown = !_sw_lap_shown;
+    break;
+  case VFD_SW_RESET:
+    _sw_running = false;
+    _sw_lap_shown = false;
+    _sw_cycle_acc = 0;
+    _sw_counts_down = (arg != 0);
+    _sw_ms = arg;
+    break;
+  }
+}
+
+// Count the elapsed milliseconds by the CPU cycle counter.  It wraps after
+// some seconds, but the interrupt reads it every few milliseconds.
+static void ICACHE_RAM_ATTR vfd_step_stopwatch()
+{
+  if (!_sw_running)
+    return;
+  const uint32_t ccount = ESP.getCycleCount();
+  _sw_cycle_acc += ccount - _sw_last_ccount;
+  _sw_last_ccount = ccount;
+  const uint32_t elapsed_ms = _sw_cycle_acc / CYCLES_PRO_MS;
+  if (elapsed_ms == 0)
+    return;
+  _sw_cycle_acc -= elapsed_ms * CYCLES_PRO_MS;
+  if (!_sw_counts_down)
+  {
+    _sw_ms = _sw_ms + elapsed_ms;
+  }
+  else if (elapsed_ms < _sw_ms)
+  {
+    _sw_ms = _sw_ms - elapsed_ms;
+  }
+  else
+  {
+    _sw_ms = 0;
+    _sw_running = false;
+  }
+}
+
+// Digit of a single tube.  Only the tubes of the active slot are computed.
+static uint8_t ICACHE_RAM_ATTR vfd_stopwatch_digit(uint8_t tube)
+{
+  static const uint32_t MS_DIVISOR[VFD_TUBE_CNT] VFD_ISR_DATA = {1UL, 10UL, 100UL, 1000UL, 10000UL, 100000UL};
+  const uint32_t ms = _sw_lap_shown ? _sw_lap_ms : _sw_ms;
+
+  if (_sw_format == VFD_SW_SSS_MMM)
+    return (ms / MS_DIVISOR[tube]) % 10;
+  // MM:SS.cc
+  const uint32_t cs = ms / 10;
+  switch (tube)
+  {
+  case 0:
+    return cs % 10;
+  case 1:
+    return (cs / 10) % 10;
+  case 2:
+    return (cs / 100) % 10;
+  case 3:
+    return (cs / 1000) % 6;
+  case 4:
+    return (cs / 6000) % 10;
+  default:
+    return (cs / 60000) % 10;
+  }
+}
+
+// This callback function should be called by timer ISR.  It measures the time of each run.
 static void ICACHE_RAM_ATTR vfd_refresh_callback()
+{
+  const uint32_t ccount = ESP.getCycleCount();
+  vfd_refresh_slot();
+  const uint32_t cycles = ESP.getCycleCount() - ccount;
+  if (cycles > _isr_max_cycles)
+    _isr_max_cycles = cycles;
+  if (cycles > _isr_peak_cycles)
+    _isr_peak_cycles = cycles;
+}
+
+static void ICACHE_RAM_ATTR vfd_refresh_slot()
 {
   static bool dot_is_on = true;
   static int ms_counter_for_dot_logic;
   static uint8_t mux_gate;
+  static bool blank_phase_pending;
 
-  // If we should stop this we do it here and now.
-  if (_vfd_log_off_necessary)
+  // Second part of a dimmed slot: turn everything off for the rest of it.
+  if (blank_phase_pending)
   {
-    timer1_disable();
-    timer1_detachInterrupt();
-    _vfd_log_off_necessary = false;
+    blank_phase_pending = false;
+    vfd_output_word(0);
+    timer1_write(TIMER_TICKS - _on_ticks);
+    return;
+  }
+
+  // The slots should start VFD_REFRESH_MS_PERIOD apart.
+  const uint32_t slot_ccount = ESP.getCycleCount();
+  if (_isr_slot_ccount != 0)
+  {
+    const uint32_t interval = slot_ccount - _isr_slot_ccount;
+    const uint32_t jitter = interval > SLOT_CYCLES ? interval - SLOT_CYCLES : SLOT_CYCLES - interval;
+    if (jitter > _isr_max_jitter_cycles)
+      _isr_max_jitter_cycles = jitter;
+    if (jitter > _isr_peak_jitter_cycles)
+      _isr_peak_jitter_cycles = jitter;
+  }
+  _isr_slot_ccount = slot_ccount | 1U; // never 0
+  _isr_slots++;
+  _isr_peak_slots++;
+
+  // Each slot starts with applying the commands of the application.
+  if (!vfd_drain_commands())
     return;
-    // Never reached...
+  // An armed frame is swapped in on the first slot after the commit.
+  if (_armed_commit_pending)
+  {
+    _armed_commit_pending = false;
+    if (_armed_is_valid)
+    {
+      memcpy(_vfd_output, _armed_output, sizeof(_vfd_output));
+      _dot_blink_ms_half_period = _armed_dot_blink_ms_half_period;
+      _dot_resync_necessary = true;
+      _armed_is_valid = false;
+    }
   }
 
   // Logic for toggling tube dots
   if (_dot_blink_ms_half_period > 0)
   { // If there is a valid period defined this means toggling
     // Dot synchronization with output
-    if (_vfd_update_necessary == true)
-    {
-      _vfd_update_necessary = false;
+    if (_dot_resync_necessary)
       ms_counter_for_dot_logic = _dot_blink_ms_half_period;
-    }
     // Count the time until next toggle
     ms_counter_for_dot_logic += VFD_REFRESH_MS_PERIOD;
     if (ms_counter_for_dot_logic >= _dot_blink_ms_half_period)
@@ -212,9 +750,24 @@ static void ICACHE_RAM_ATTR vfd_refresh_callback()
   { // It there is no period defined this means turn on
     dot_is_on = true;
   }
+  _dot_resync_necessary = false;
+  // Stopwatch timing
+  vfd_step_stopwatch();
+  // Animation timing
+  if (_anim != nullptr)
+  {
+    _anim_ms_counter += VFD_REFRESH_MS_PERIOD;
+    if (mux_gate == 0)
+      vfd_step_animation();
+  }
   // Compute value for the output shift register
-  long content_sreg = ((SEG_7[_vfd_output[mux_gate]] << 8) | SEG_7[_vfd_output[mux_gate + 3]] | (1 << GATE[mux_gate]));
-  if (dot_is_on)
+  long content_sreg = ((_seg_7[vfd_glyph(mux_gate)] << 8) | _seg_7[vfd_glyph(mux_gate + 3)] | (1 << GATE[mux_gate]));
+  if (_sw_format == VFD_SW_SSS_MMM)
+  { // SSS.mmm, the only separator follows the units of the seconds on tube 3
+    if (mux_gate == 0)
+      content_sreg |= TAG_DP;
+  }
+  else if (dot_is_on || _sw_format != VFD_SW_HIDDEN) // Stopwatch shows fixed separators
   {
     if (mux_gate == 1)
       content_sreg |= TAG_DP;
@@ -222,9 +775,31 @@ static void ICACHE_RAM_ATTR vfd_refresh_callback()
       content_sreg |= MONAT_DP;
   }
   // Send this to shift register for output
-  HV5812_vfdDriver(content_sreg);
+  vfd_output_word(_on_ticks > 0 ? content_sreg : 0);
   // Select gate for the next round
   if (++mux_gate > 2)
     mux_gate = 0;
-  timer1_write(TIMER_TICKS); // 5 ms refresh rate for VFD tubes
+  // Dimmed slots are split into an on and an off part.
+  if (_on_ticks > 0 && _on_ticks < TIMER_TICKS)
+  {
+    blank_phase_pending = true;
+    timer1_write(_on_ticks);
+  }
+  else
+  {
+    timer1_write(TIMER_TICKS); // 5 ms refresh rate for VFD tubes
+  }
+}
+
+// Sends a word to the HV5812 and records it if a trace is running.
+static void ICACHE_RAM_ATTR vfd_output_word(long content_sreg)
+{
+  HV5812_vfdDriver(content_sreg);
+  if (_trace_remaining == 0)
+    return;
+  _trace_remaining = _trace_remaining - 1;
+  vfd_trace_word_t traced;
+  traced.ccount = ESP.getCycleCount();
+  traced.word = ((uint32_t)content_sreg & VFD_TRACE_WORD_MASK) | ((uint32_t)_trace_seq++ << VFD_TRACE_SEQ_SHIFT);
+  _trace_ring.push(traced); // a dropped word is a gap of the sequence number
 }
@@ -38,21 +38,129 @@
   library.
 
   When using the function updateVfd() you also have control over the decimal dots.
+
+  The application never touches the state of the background interrupt directly.
+  updateVfd(), setVfdBrightness() and logOffVfd() put typed commands into a
+  lock-free single-producer/single-consumer queue.  The interrupt drains this
+  queue at the start of each multiplex slot, so the commands take effect in the
+  order they were given and without disabling interrupts.  All of these
+  functions must be called from the same context, usually loop().
+
+  Precomputed frame sequences stored in flash can be played back by the background
+  interrupt with startVfdAnimation().  The interrupt steps through the frames on
+  its own, so loop() stays free while e.g. a text is scrolling.  Frames of scrolling
+  texts are generated ahead of time by <kbd>tools/vfd_text2frames.py</kbd>.
+
+  For lab timers the background interrupt can also show a stopwatch or countdown
+  with a resolution of milliseconds, see controlVfdStopwatch().  The digits are
+  derived from the CPU cycle counter inside the interrupt, so there is no need
+  to call updateVfd() at a high rate.
+
+  A frame can be prepared ahead of time with armVfdFrame() and be made visible
+  later with commitVfdFrame(), which is safe to be called from an interrupt
+  service routine such as the edge interrupt of an external 1 Hz clock.
+
+  The background interrupt runs while the flash is written and its cache is off,
+  so its code, the HV5812 driver and every table it reads reside in IRAM or DRAM.
+  tools/isr_sections.py checks this after each build.
 */
 #ifndef MULTIPLEXING_H
 #define MULTIPLEXING_H
 
 #include <cstdint>
 
+/// Supported tube types, they differ in the wiring of their segments.
+typedef enum
+{
+  VFD_TUBE_IV3A = 1, ///< ИВ-3А
+  VFD_TUBE_IV12 = 2  ///< ИВ-12
+} vfd_tube_type_e;
+
 /// Count of accessible VFD tubes connected to the multiplexer.
 const unsigned VFD_TUBE_CNT = 6U;
 /// Special 'blank character' value for multiplexer() array for turning tube temporarily off.
 const uint8_t VFD_BLANK = 16;
 /// Refreshed tubes each 5 milliseconds.
 const uint8_t VFD_REFRESH_MS_PERIOD = 5;
+/// Special glyph value in animation frames for showing the digit given by updateVfd().
+const uint8_t VFD_KEEP = 0xFF;
+/// Glyph value of a single horizontal bar (segment G).
+const uint8_t VFD_DASH = 26;
+/// Tube mask selecting all tubes for startVfdAnimation().
+const uint8_t VFD_ALL_TUBES = (1U << VFD_TUBE_CNT) - 1U;
+/// Flag of vfd_animation_t: Restart with the first frame after the last one.
+const uint8_t VFD_ANIM_LOOP = 0x01;
+/// Frames of an animation played at most, the frames are copied to RAM by startVfdAnimation().
+const uint16_t VFD_ANIM_FRAMES_MAX = 32;
+/// Brightness value for the full on-time of each multiplex slot.
+const uint8_t VFD_BRIGHTNESS_MAX = 8;
 /// VFD output for a all blank display.
 const uint8_t VFD_OUTPUT_BLANK[VFD_TUBE_CNT] = {VFD_BLANK, VFD_BLANK, VFD_BLANK, VFD_BLANK, VFD_BLANK, VFD_BLANK};
 
+/**
+ * \brief Precomputed frame sequence for startVfdAnimation().
+ *
+ * Each frame holds one glyph value per tube in the same order as the vfd_output array
+ * of updateVfd().  Besides the digits 0 to 15 and VFD_BLANK there are some letters
+ * (see SEG_7 in multiplexing.cpp and <kbd>tools/vfd_text2frames.py</kbd>) and the
+ * special value VFD_KEEP.  The frames must be stored in PROGMEM, startVfdAnimation()
+ * copies them together with the descriptor.
+ */
+typedef struct
+{
+  const uint8_t (*frames)[VFD_TUBE_CNT]; ///< Frame table in PROGMEM
+  uint16_t frame_cnt;                    ///< Count of frames in the table
+  uint16_t frame_ms_period;              ///< Display time of each frame
+  uint8_t flags;                         ///< VFD_ANIM_LOOP or 0
+} vfd_animation_t;
+
+/**
+ * \brief Display formats of the stopwatch.
+ * \sa    controlVfdStopwatch()
+ */
+typedef enum
+{
+  VFD_SW_HIDDEN = 0, ///< Stopwatch keeps counting but the tubes show the digits of updateVfd()
+  VFD_SW_MM_SS_CC,   ///< Minutes, seconds and hundredths of a second
+  VFD_SW_SSS_MMM     ///< Seconds and milliseconds
+} vfd_stopwatch_format_e;
+
+/**
+ * \brief Operations of the stopwatch.
+ * \sa    controlVfdStopwatch()
+ */
+typedef enum
+{
+  VFD_SW_SHOW,   ///< Select the display format given by arg (vfd_stopwatch_format_e)
+  VFD_SW_START,  ///< Start counting
+  VFD_SW_STOP,   ///< Stop counting
+  VFD_SW_TOGGLE, ///< Start if stopped, stop if running
+  VFD_SW_LAP,    ///< Freeze the display at the current value or release a frozen display
+  VFD_SW_RESET   ///< Stop and set to zero.  If arg is not zero count down from arg milliseconds.
+} vfd_stopwatch_op_e;
+
+/**
+ * \brief Timing statistics of the display ISR.
+ * \sa    getVfdIsrStats()
+ * \sa    getVfdIsrPeak()
+ */
+typedef struct
+{
+  uint32_t max_us;        ///< Longest run of the ISR
+  uint32_t max_jitter_us; ///< Largest deviation of a slot start from VFD_REFRESH_MS_PERIOD
+  uint32_t slots;         ///< Count of slots since the last reset of the statistics
+} vfd_isr_stats_t;
+
+/**
+ * \brief HV5812 word as recorded by the trace.
+ * \sa    startVfdTrace()
+ */
+typedef struct
+{
+  uint32_t ccount; ///< CPU cycle count when the word was latched
+  uint32_t word;   ///< Bits 0 to 19 are the word shifted out, bits 20 to 31 a sequence number
+} vfd_trace_word_t;
+
 #ifdef __cplusplus
 extern "C"
 {
@@ -67,9 +175,155 @@ extern "C"
   /**
    * \brief Turns off the background interrupt mechanism used by updateVfd().
    * \sa    updateVfd()
+   *
+   * The shutdown is queued behind all commands given before.  If updateVfd() is called
+   * again before the interrupt has processed the shutdown, the display simply keeps running.
    */
   void logOffVfd();
 
+  /**
+   * \brief Selects the segment wiring of the connected tubes.
+   * \param tube_type One of vfd_tube_type_e.
+   *
+   * The default is chosen by ACTIVE_VFR_TUBE in multiplexing.cpp.
+   */
+  void setVfdTubeType(uint8_t tube_type);
+
+  /**
+   * \brief Tells the segment wiring in use.
+   * \return One of vfd_tube_type_e.
+   */
+  uint8_t getVfdTubeType();
+
+  /**
+   * \brief Prepares the next frame without showing it.
+   * \param vfd_output[] Array of digits to be displayed.
+   * \param dot_blink_ms_period Control of dot blinking behaviour.
+   * \sa    updateVfd()
+   * \sa    commitVfdFrame()
+   *
+   * The parameters are the same as for updateVfd().  The frame becomes visible on the
+   * first multiplex boundary after commitVfdFrame() has been called.  Each armed frame
+   * is shown at most once, arming again replaces a frame not committed yet.
+   */
+  void armVfdFrame(const uint8_t vfd_output[VFD_TUBE_CNT], int dot_blink_ms_period = 0);
+
+  /**
+   * \brief Shows the frame prepared by armVfdFrame().
+   * \sa    armVfdFrame()
+   *
+   * This function may be called from an interrupt service routine.  It does nothing if
+   * there is no armed frame when the background interrupt processes the request.
+   */
+  void commitVfdFrame();
+
+  /**
+   * \brief Sets the brightness of the background driven display.
+   * \param brightness On-time of each multiplex slot in steps of 1/VFD_BRIGHTNESS_MAX.
+   * \sa    VFD_BRIGHTNESS_MAX
+   * \sa    updateVfd()
+   *
+   * Values above VFD_BRIGHTNESS_MAX are limited to VFD_BRIGHTNESS_MAX.  A value of 0
+   * turns the tubes off while the background interrupt keeps running.
+   */
+  void setVfdBrightness(uint8_t brightness);
+
+  /**
+   * \brief Plays a precomputed frame sequence in the background.
+   * \param animation Animation to be played or nullptr to stop a running animation.
+   * \param tube_mask Bit n set means tube n shows the animation, the others keep their digits.
+   * \sa    vfd_animation_t
+   * \sa    isVfdAnimationRunning()
+   *
+   * The frames are copied from flash to RAM, at most VFD_ANIM_FRAMES_MAX of them, so the
+   * background interrupt never touches the flash.  It advances the frames on a multiplex
+   * boundary, so the frame period has a resolution of three multiplex slots.  Starting an
+   * animation waits until the background interrupt has taken over the one started before.
+   * Within the selected tubes a glyph value of VFD_KEEP shows the digit given by
+   * updateVfd().  After the last frame of a non looping animation the tubes show the
+   * digits given by updateVfd() again.  This allows transitions like
+   * \code{.c}
+    updateVfd(new_output, 1000);
+    startVfdAnimation(&VFD_ANIM_ROLL_OVER, changed_tubes_mask);
+    \endcode
+   */
+  void startVfdAnimation(const vfd_animation_t *animation, uint8_t tube_mask = VFD_ALL_TUBES);
+
+  /**
+   * \brief Tells if the animation started last is still being played.
+   * \return true until the background interrupt has shown the last frame.
+   */
+  bool isVfdAnimationRunning();
+
+  /**
+   * \brief Controls the stopwatch of the background interrupt.
+   * \param op Operation to be done.
+   * \param arg Display format for VFD_SW_SHOW, countdown preset in milliseconds for VFD_SW_RESET.
+   * \sa    vfd_stopwatch_op_e
+   * \sa    vfd_stopwatch_format_e
+   *
+   * The stopwatch is measured with the CPU cycle counter by the interrupt and is rendered
+   * directly into the multiplexed output, only the two tubes of the active multiplex
+   * slot are encoded each time.  While it is shown the digits given by updateVfd() and
+   * running animations are hidden.  A countdown stops by itself when it reaches zero.
+   */
+  void controlVfdStopwatch(vfd_stopwatch_op_e op, uint32_t arg = 0);
+
+  /**
+   * \brief Tells the display format of the stopwatch selected last.
+   * \return VFD_SW_HIDDEN if the tubes show the digits of updateVfd().
+   */
+  vfd_stopwatch_format_e getVfdStopwatchFormat();
+
+  /**
+   * \brief Current value of the stopwatch.
+   * \return Elapsed time or remaining time of a countdown in milliseconds.
+   */
+  uint32_t getVfdStopwatchMs();
+
+  /**
+   * \brief Timing statistics of the display ISR.
+   * \param stats Receives the statistics.
+   * \param reset If true the statistics start over.
+   *
+   * The ISR measures itself with the CPU cycle counter, which costs a few cycles per run.
+   */
+  void getVfdIsrStats(vfd_isr_stats_t *stats, bool reset = false);
+
+  /**
+   * \brief Same as getVfdIsrStats(), but with statistics of their own.
+   * \param stats Receives the statistics.
+   * \param reset If true the statistics start over.
+   *
+   * Meant for a measurement over a given time, which must not be disturbed by the
+   * telemetry resetting the statistics of getVfdIsrStats().
+   */
+  void getVfdIsrPeak(vfd_isr_stats_t *stats, bool reset = false);
+
+  /**
+   * \brief Records the next words sent to the HV5812 by the background interrupt.
+   * \param word_cnt Count of words to be recorded, 0 stops a running trace.
+   * \sa    getVfdTraceWord()
+   *
+   * The interrupt puts each word with the cycle count of its latch pulse into a small ring,
+   * which has to be drained by getVfdTraceWord() from loop().  Words not fitting the ring are
+   * dropped, they show up as gaps of the sequence number.
+   */
+  void startVfdTrace(uint32_t word_cnt);
+
+  /**
+   * \brief Fetches the oldest recorded word.
+   * \param word Receives the word.
+   * \return false if there is no recorded word.
+   */
+  bool getVfdTraceWord(vfd_trace_word_t *word);
+
+  /**
+   * \brief Tells if there are words left to be recorded.
+   * \return true until the count given to startVfdTrace() has been recorded.
+   */
+  bool isVfdTraceRunning();
+
   /**
    * \brief Output digits to VFD display.
    * \param vfd_output[] Array of digits to be displayed.
@@ -161,6 +415,24 @@ extern "C"
    */
   void updateVfd(const uint8_t vfd_output[VFD_TUBE_CNT], int dot_blink_ms_period=0);
 
+  /**
+   * \brief Output digits to some of the VFD tubes.
+   * \param vfd_output[] Array of digits as for updateVfd(), only the selected elements are used.
+   * \param tube_mask Bit n set means tube n gets the digit vfd_output[n].
+   * \sa    updateVfd()
+   *
+   * Unlike updateVfd() the blinking dots keep their phase, so this is the way to change only
+   * the digits that have changed since the last update.
+   */
+  void updateVfdTubes(const uint8_t vfd_output[VFD_TUBE_CNT], uint8_t tube_mask);
+
+  /**
+   * \brief Glyph value of a character.
+   * \param c Hex digit or one of the letters of SEG_7 in multiplexing.cpp, e.g. 'H', 'n' or 'S'.
+   * \return Glyph value for updateVfd(), VFD_BLANK if there is no glyph for the character.
+   */
+  uint8_t getVfdGlyph(char c);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,178 @@
+#include "ntp_server.h"
+
+#include <Arduino.h>
+#include <cstring>
+
+// Packet layout
+static const uint8_t LI_ALARM = 3U;
+static const uint8_t VERSION = 4U;
+static const uint8_t MODE_CLIENT = 3U;
+static const uint8_t MODE_SERVER = 4U;
+static const int8_t PRECISION = -10; // about a millisecond
+static const int8_t CLIENT_PRECISION = -20;
+static const uint8_t CLIENT_POLL = 6U; // 64 s
+static const size_t OFFSET_ROOT_DELAY = 4U;
+static const size_t OFFSET_ROOT_DISPERSION = 8U;
+static const size_t OFFSET_REFID = 12U;
+static const size_t OFFSET_REFERENCE_TS = 16U;
+static const size_t OFFSET_ORIGINATE_TS = 24U;
+static const size_t OFFSET_RECEIVE_TS = 32U;
+static const size_t OFFSET_TRANSMIT_TS = 40U;
+static const uint32_t SECONDS_1900_TO_1970 = 2208988800UL;
+static const uint32_t DISPERSION_PPM = 15U; // frequency tolerance of millis()
+
+// Local variables
+static WiFiUDP *_udp;
+static uint8_t _packet[NTP_PACKET_SIZE] __attribute__((aligned(4)));
+static ntp_reference_t _reference;
+static bool _reference_is_valid;
+static uint32_t _served;
+
+// Local function prototypes
+static void time_at(uint32_t at_millis, uint32_t *utc_s, uint16_t *utc_ms);
+static void put_u32(uint8_t *p, uint32_t value);
+static uint32_t get_u32(const uint8_t *p);
+static void put_timestamp(uint8_t *p, uint32_t utc_s, uint16_t utc_ms);
+
+bool ntpServerBegin(WiFiUDP &udp)
+{
+  if (udp.begin(NTP_PORT) != 1)
+    return false;
+  _udp = &udp;
+  return true;
+}
+
+void ntpServerSetReference(const ntp_reference_t *reference)
+{
+  _reference = *reference;
+  _reference_is_valid = true;
+}
+
+void ntpServerPoll()
+{
+  if (_udp == nullptr || _udp->parsePacket() == 0)
+    return;
+  // Receive timestamp as early as possible
+  const uint32_t receive_millis = millis();
+  const IPAddress client_ip = _udp->remoteIP();
+  const uint16_t client_port = _udp->remotePort();
+  if (_udp->read(_packet, NTP_PACKET_SIZE) != (int)NTP_PACKET_SIZE || (_packet[0] & 0x07) != MODE_CLIENT)
+    return; // not a client request
+
+  const uint32_t age_ms = millis() - _reference.at_millis;
+  const bool is_synchronized = _reference_is_valid && age_ms / 1000UL < NTP_SERVER_MAX_AGE_S;
+  uint32_t utc_s;
+  uint16_t utc_ms;
+
+  // The transmit timestamp of the client becomes the originate timestamp.
+  memcpy(&_packet[OFFSET_ORIGINATE_TS], &_packet[OFFSET_TRANSMIT_TS], 8U);
+  const uint8_t client_version = (_packet[0] >> 3) & 0x07;
+  if (is_synchronized)
+  {
+    _packet[0] = (client_version << 3) | MODE_SERVER;
+    _packet[1] = _reference.stratum + 1U;
+    // Dispersion grows with the age of the reference, 2^-16 s units
+    const uint32_t dispersion = (uint32_t)(((uint64_t)age_ms * DISPERSION_PPM * 65536ULL) / 1000000000ULL);
+    put_u32(&_packet[OFFSET_ROOT_DELAY], _reference.root_delay);
+    put_u32(&_packet[OFFSET_ROOT_DISPERSION], _reference.root_dispersion + dispersion);
+    memcpy(&_packet[OFFSET_REFID], &_reference.refid, 4U);
+    put_timestamp(&_packet[OFFSET_REFERENCE_TS], _reference.utc_s, _reference.utc_ms);
+    time_at(receive_millis, &utc_s, &utc_ms);
+    put_timestamp(&_packet[OFFSET_RECEIVE_TS], utc_s, utc_ms);
+  }
+  else
+  {
+    _packet[0] = (LI_ALARM << 6) | (client_version << 3) | MODE_SERVER;
+    _packet[1] = NTP_STRATUM_UNSYNC;
+    memset(&_packet[OFFSET_ROOT_DELAY], 0, OFFSET_ORIGINATE_TS - OFFSET_ROOT_DELAY);
+    memset(&_packet[OFFSET_RECEIVE_TS], 0, 8U);
+  }
+  _packet[2] = max(_packet[2], (uint8_t)6U); // poll interval, at least 64 s
+  _packet[3] = (uint8_t)PRECISION;
+  if (is_synchronized)
+  {
+    time_at(millis(), &utc_s, &utc_ms);
+    put_timestamp(&_packet[OFFSET_TRANSMIT_TS], utc_s, utc_ms);
+  }
+  else
+  {
+    memset(&_packet[OFFSET_TRANSMIT_TS], 0, 8U);
+  }
+  _udp->beginPacket(client_ip, client_port);
+  _udp->write(_packet, NTP_PACKET_SIZE);
+  if (_udp->endPacket() == 1)
+    _served++;
+}
+
+uint32_t ntpServerServed()
+{
+  return _served;
+}
+
+void ntpBuildRequest(uint8_t packet[NTP_PACKET_SIZE], uint32_t nonce_s, uint32_t nonce_frac)
+{
+  memset(packet, 0, NTP_PACKET_SIZE);
+  packet[0] = (LI_ALARM << 6) | (VERSION << 3) | MODE_CLIENT; // not synchronized
+  packet[2] = CLIENT_POLL;
+  packet[3] = (uint8_t)CLIENT_PRECISION;
+  memcpy(&packet[OFFSET_REFID], "1N14", 4U);
+  put_u32(&packet[OFFSET_TRANSMIT_TS], nonce_s);
+  put_u32(&packet[OFFSET_TRANSMIT_TS + 4U], nonce_frac);
+}
+
+bool ntpDecodeReply(const uint8_t packet[NTP_PACKET_SIZE], const uint8_t request[NTP_PACKET_SIZE],
+                    uint32_t at_millis, uint32_t delay_ms, ntp_reference_t *reference)
+{
+  const uint8_t leap = packet[0] >> 6;
+  const uint8_t stratum = packet[1];
+
+  if (leap == LI_ALARM || stratum == 0 || stratum >= NTP_STRATUM_UNSYNC)
+    return false;
+  // A reply to an older request or a spoofed one
+  if (memcmp(&packet[OFFSET_ORIGINATE_TS], &request[OFFSET_TRANSMIT_TS], 8U) != 0)
+    return false;
+  const uint32_t transmit_s = get_u32(&packet[OFFSET_TRANSMIT_TS]);
+  const uint32_t transmit_frac = get_u32(&packet[OFFSET_TRANSMIT_TS + 4U]);
+  // The reply has been underway for about half of the round trip.
+  const uint32_t utc_ms = (uint32_t)(((uint64_t)transmit_frac * 1000ULL) >> 32) + delay_ms / 2U;
+  reference->utc_s = transmit_s - SECONDS_1900_TO_1970 + utc_ms / 1000U;
+  reference->utc_ms = utc_ms % 1000U;
+  reference->at_millis = at_millis;
+  reference->stratum = stratum;
+  reference->refid = 0;
+  reference->root_delay = get_u32(&packet[OFFSET_ROOT_DELAY]) + (delay_ms * 65536UL) / 1000UL;
+  reference->root_dispersion = get_u32(&packet[OFFSET_ROOT_DISPERSION]);
+  return true;
+}
+
+//********************************************************************
+// Local functions
+//********************************************************************
+
+// Time of the reference clock at a given millis()
+static void time_at(uint32_t at_millis, uint32_t *utc_s, uint16_t *utc_ms)
+{
+  const uint32_t ms = _reference.utc_ms + (at_millis - _reference.at_millis);
+  *utc_s = _reference.utc_s + ms / 1000U;
+  *utc_ms = ms % 1000U;
+}
+
+// Big endian as used by NTP
+static void put_u32(uint8_t *p, uint32_t value)
+{
+  p[0] = value >> 24;
+  p[1] = value >> 16;
+  p[2] = value >> 8;
+  p[3] = value;
+}
+
+static uint32_t get_u32(const uint8_t *p)
+{
+  return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static void put_timestamp(uint8_t *p, uint32_t utc_s, uint16_t utc_ms)
+{
+  put_u32(p, utc_s + SECONDS_1900_TO_1970);
+  put_u32(p + 4, (uint32_t)(((uint64_t)utc_ms << 32) / 1000U));
+}
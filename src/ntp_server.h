@@ -0,0 +1,95 @@
+/**
+  \file   ntp_server.h
+  \brief  NTP server for the other clocks in the LAN.
+
+  A clock synchronized with a NTP server of the internet is able to pass its
+  time on to the other clocks of the lab, so only one clock needs to query the
+  pool servers.  The server answers NTP client requests (mode 3) on UDP port
+  123 with a stratum one higher than its upstream server.  The timestamps are
+  derived from the time of the last upstream synchronization and millis(), so
+  they have a resolution of a millisecond.
+
+  A request is read into a static buffer and the reply is built in place, so
+  the receive path does not allocate memory apart from the buffers of the
+  network stack.  A server that has not been synchronized recently answers
+  with the leap indicator "alarm" and stratum 16, so a client does not use it.
+
+  The peers are pointed to the server by its address as NTP server name in the
+  configuration or find it by a broadcast request, see CONFIG_NTP_DISCOVERY.
+*/
+#ifndef NTP_SERVER_H
+#define NTP_SERVER_H
+
+#include <ESP8266WiFi.h>
+#include <WiFiUdp.h>
+#include <cstdint>
+
+/// UDP port of NTP
+const uint16_t NTP_PORT = 123U;
+/// Size of a NTP packet without extensions
+const size_t NTP_PACKET_SIZE = 48U;
+/// Stratum of an unsynchronized server
+const uint8_t NTP_STRATUM_UNSYNC = 16U;
+/// The server stops serving this long after the last upstream synchronization.
+const uint32_t NTP_SERVER_MAX_AGE_S = 3UL * 3600UL;
+
+/// Upstream synchronization as taken from the reply of the upstream server
+typedef struct
+{
+  uint32_t utc_s;          ///< Time of the upstream server, seconds
+  uint16_t utc_ms;         ///< Time of the upstream server, milliseconds
+  uint32_t at_millis;      ///< millis() matching the time above
+  uint8_t stratum;         ///< Stratum of the upstream server
+  uint32_t refid;          ///< Address of the upstream server (network byte order as in the packet)
+  uint32_t root_delay;     ///< Root delay to the reference clock, NTP short format
+  uint32_t root_dispersion; ///< Root dispersion, NTP short format
+} ntp_reference_t;
+
+/**
+ * \brief Starts serving NTP.
+ * \param udp Socket to be bound to NTP_PORT.
+ * \return false if the port could not be bound.
+ */
+bool ntpServerBegin(WiFiUDP &udp);
+
+/**
+ * \brief Sets the reference after a synchronization with the upstream server.
+ * \param reference Upstream synchronization.
+ */
+void ntpServerSetReference(const ntp_reference_t *reference);
+
+/**
+ * \brief Answers a pending request.  To be called from loop().
+ *
+ * Returns at once if no request is pending.
+ */
+void ntpServerPoll();
+
+/// Count of requests answered since boot.
+uint32_t ntpServerServed();
+
+/**
+ * \brief Builds the request to a NTP server.
+ * \param packet Receives the request.
+ * \param nonce_s Random value, e.g. ESP.random().
+ * \param nonce_frac Another random value.
+ *
+ * The client has no time of its own to send, so the transmit timestamp is set to the random values.  The
+ * server returns it as originate timestamp, which binds the reply to this request.
+ */
+void ntpBuildRequest(uint8_t packet[NTP_PACKET_SIZE], uint32_t nonce_s, uint32_t nonce_frac);
+
+/**
+ * \brief Decodes the reply of a NTP server.
+ * \param packet Reply as received.
+ * \param request Request built by ntpBuildRequest().
+ * \param at_millis millis() when the reply was received.
+ * \param delay_ms Round trip time of the request.
+ * \param reference Receives the synchronization, the server address is not filled in.
+ * \return false if the reply is not usable, e.g. the server is not synchronized or it does not answer the
+ *         request.
+ */
+bool ntpDecodeReply(const uint8_t packet[NTP_PACKET_SIZE], const uint8_t request[NTP_PACKET_SIZE],
+                    uint32_t at_millis, uint32_t delay_ms, ntp_reference_t *reference);
+
+#endif // NTP_SERVER_H
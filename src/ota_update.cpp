@@ -0,0 +1,193 @@
+#include "ota_update.h"
+
+#include <ESP8266WiFi.h>
+#include <Updater.h>
+#include <WiFiClient.h>
+#include <cctype>
+#include <cstring>
+
+static const size_t MD5_HEX_LEN = 32U;
+static const size_t HOST_LEN = 64U;
+static const size_t LINE_LEN = 128U;
+
+// Local variables
+static uint8_t _chunk[OTA_CHUNK_SIZE];
+
+// Local function prototypes
+static bool parse_url(const char *url, char host[HOST_LEN], uint16_t *port, const char **path);
+static bool read_line(Stream &stream, char *line, size_t size);
+static bool is_md5(const char *md5);
+
+ota_result_e otaUpdateFromUrl(const char *url, const char *md5, ota_progress_t progress)
+{
+  char host[HOST_LEN];
+  uint16_t port;
+  const char *path;
+  char line[LINE_LEN];
+  char header_md5[MD5_HEX_LEN + 1] = "";
+  long content_length = -1;
+  WiFiClient client;
+
+  if (!parse_url(url, host, &port, &path))
+    return OTA_ERR_URL;
+  if (!client.connect(host, port))
+    return OTA_ERR_CONNECT;
+  client.printf("GET %s HTTP/1.0\r\nHost: %s\r\nConnection: close\r\n\r\n", path, host);
+
+  // Status line and the headers needed
+  if (!read_line(client, line, sizeof(line)) || strncmp(line, "HTTP/1.", 7) != 0 || atoi(line + 9) != 200)
+    return OTA_ERR_HTTP;
+  while (read_line(client, line, sizeof(line)) && line[0] != '\0')
+  {
+    if (strncasecmp(line, "Content-Length:", 15) == 0)
+      content_length = atol(line + 15);
+    else if (strncasecmp(line, "X-MD5:", 6) == 0)
+    {
+      const char *value = line + 6;
+      while (*value == ' ')
+        value++;
+      strncpy(header_md5, value, MD5_HEX_LEN);
+      header_md5[MD5_HEX_LEN] = '\0';
+    }
+  }
+  if (content_length <= 0)
+    return OTA_ERR_HTTP;
+  return otaUpdateFromStream(client, content_length, md5 != nullptr ? md5 : header_md5, progress);
+}
+
+ota_result_e otaUpdateFromStream(Stream &stream, size_t size, const char *md5, ota_progress_t progress)
+{
+  if (md5 == nullptr || !is_md5(md5))
+    return OTA_ERR_NO_MD5;
+  // Fails if the image does not fit into the free flash
+  if (!Update.begin(size))
+    return OTA_ERR_SPACE;
+  Update.setMD5(md5);
+
+  size_t written = 0;
+  uint8_t percent = 0;
+  unsigned long last_data_ms = millis();
+  if (progress != nullptr)
+    progress(0);
+  while (written < size)
+  {
+    const int available = stream.available();
+    if (available <= 0)
+    {
+      if (millis() - last_data_ms > OTA_TIMEOUT_MS)
+      {
+        Update.end(); // discarded, the image is incomplete
+        return OTA_ERR_TIMEOUT;
+      }
+      delay(1UL);
+      continue;
+    }
+    const size_t len = stream.readBytes(_chunk, min((size_t)available, min(sizeof(_chunk), size - written)));
+    if (Update.write(_chunk, len) != len)
+    {
+      Update.end();
+      return OTA_ERR_WRITE;
+    }
+    written += len;
+    last_data_ms = millis();
+    const uint8_t new_percent = (uint64_t)written * 100U / size;
+    if (progress != nullptr && new_percent != percent)
+      progress(new_percent);
+    percent = new_percent;
+  }
+  // The boot loader gets the copy command only if the MD5 digest matches.
+  return Update.end() ? OTA_OK : OTA_ERR_VERIFY;
+}
+
+const __FlashStringHelper *otaResultText(ota_result_e result)
+{
+  switch (result)
+  {
+  case OTA_OK:
+    return F("image verified, restart to install");
+  case OTA_ERR_URL:
+    return F("URL not supported, use http://host[:port]/path");
+  case OTA_ERR_CONNECT:
+    return F("server not reachable");
+  case OTA_ERR_HTTP:
+    return F("no image, HTTP status or Content-Length missing");
+  case OTA_ERR_NO_MD5:
+    return F("MD5 digest of the image unknown");
+  case OTA_ERR_SPACE:
+    return F("image too large for the free flash");
+  case OTA_ERR_WRITE:
+    return F("flash write failed");
+  case OTA_ERR_TIMEOUT:
+    return F("transfer stalled");
+  case OTA_ERR_VERIFY:
+    return F("MD5 digest mismatch, image discarded");
+  }
+  return F("unknown error");
+}
+
+//********************************************************************
+// Local functions
+//********************************************************************
+
+static bool parse_url(const char *url, char host[HOST_LEN], uint16_t *port, const char **path)
+{
+  static const char SCHEME[] = "http://";
+
+  if (strncmp(url, SCHEME, sizeof(SCHEME) - 1) != 0)
+    return false;
+  const char *start = url + sizeof(SCHEME) - 1;
+  const char *end = start + strcspn(start, ":/");
+  if (end == start || (size_t)(end - start) >= HOST_LEN)
+    return false;
+  memcpy(host, start, end - start);
+  host[end - start] = '\0';
+  *port = 80;
+  if (*end == ':')
+  {
+    const long value = strtol(end + 1, const_cast<char **>(&end), 10);
+    if (value <= 0 || value > 0xFFFF)
+      return false;
+    *port = value;
+  }
+  *path = *end == '/' ? end : "/";
+  return *end == '/' || *end == '\0';
+}
+
+// Reads a header line without the line end.  false on timeout.
+static bool read_line(Stream &stream, char *line, size_t size)
+{
+  size_t len = 0;
+  unsigned long start_ms = millis();
+
+  while (millis() - start_ms < OTA_TIMEOUT_MS)
+  {
+    const int c = stream.read();
+    if (c < 0)
+    {
+      delay(1UL);
+      continue;
+    }
+    if (c == '\n')
+    {
+      if (len > 0 && line[len - 1] == '\r')
+        len--;
+      line[len] = '\0';
+      return true;
+    }
+    if (len < size - 1)
+      line[len++] = c;
+  }
+  return false;
+}
+
+static bool is_md5(const char *md5)
+{
+  if (strlen(md5) != MD5_HEX_LEN)
+    return false;
+  for (size_t i = 0; i < MD5_HEX_LEN; i++)
+  {
+    if (!isxdigit((unsigned char)md5[i]))
+      return false;
+  }
+  return true;
+}
@@ -0,0 +1,71 @@
+/**
+  \file   ota_update.h
+  \brief  Firmware update over the network.
+
+  The image is streamed in chunks of OTA_CHUNK_SIZE bytes from the network
+  straight into the free flash behind the running firmware, it is never kept in
+  RAM as a whole.  The MD5 digest is computed on the fly by the Updater of the
+  core.  The boot loader is told to copy the new image only if the digest
+  matches, otherwise the running firmware stays untouched.  So an update is
+  refused unless its MD5 digest is known in advance.
+
+  The image has to fit into the free flash.  On the 1 MB ESP-01 the linker
+  script without file system is used, which leaves about 470 KB for an image.
+
+  The multiplexing ISR keeps running during the update, so the display is able
+  to show the progress.
+*/
+#ifndef OTA_UPDATE_H
+#define OTA_UPDATE_H
+
+#include <Arduino.h>
+#include <cstdint>
+
+/// Size of the chunks passed to the Updater.
+const size_t OTA_CHUNK_SIZE = 512U;
+/// An update is aborted if no data has been received for this time.
+const unsigned long OTA_TIMEOUT_MS = 10000UL;
+
+/// Result of an update
+typedef enum
+{
+  OTA_OK = 0,      ///< Image written and verified, it is installed by the next restart
+  OTA_ERR_URL,     ///< URL not understood, only http://host[:port]/path is supported
+  OTA_ERR_CONNECT, ///< Server not reachable
+  OTA_ERR_HTTP,    ///< Server did not answer with 200 and a Content-Length
+  OTA_ERR_NO_MD5,  ///< MD5 digest neither given nor sent by the server
+  OTA_ERR_SPACE,   ///< Image does not fit into the free flash
+  OTA_ERR_WRITE,   ///< Flash could not be written
+  OTA_ERR_TIMEOUT, ///< Transfer stalled
+  OTA_ERR_VERIFY   ///< MD5 digest does not match, the update was discarded
+} ota_result_e;
+
+/**
+ * \brief Progress notification.
+ * \param percent 0 to 100.
+ */
+typedef void (*ota_progress_t)(uint8_t percent);
+
+/**
+ * \brief Downloads and installs an image.
+ * \param url http://host[:port]/path of the image.
+ * \param md5 MD5 digest of the image as 32 hex digits.  If nullptr the header X-MD5 of the server is used.
+ * \param progress Called for each percent of progress, may be nullptr.
+ * \return OTA_OK if the image is going to be installed by the next restart.
+ */
+ota_result_e otaUpdateFromUrl(const char *url, const char *md5, ota_progress_t progress);
+
+/**
+ * \brief Installs an image read from a stream, e.g. an upload to the HTTP server.
+ * \param stream Stream delivering the image.
+ * \param size Size of the image.
+ * \param md5 MD5 digest of the image as 32 hex digits.
+ * \param progress Called for each percent of progress, may be nullptr.
+ * \return OTA_OK if the image is going to be installed by the next restart.
+ */
+ota_result_e otaUpdateFromStream(Stream &stream, size_t size, const char *md5, ota_progress_t progress);
+
+/// Short description of a result.
+const __FlashStringHelper *otaResultText(ota_result_e result);
+
+#endif // OTA_UPDATE_H
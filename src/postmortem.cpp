@@ -0,0 +1,132 @@
+#include "postmortem.h"
+
+#include <cstddef>
+#include <cstring>
+
+// Layout in the RTC user memory, offsets in blocks of four bytes
+static const uint32_t RTC_USER_OFFSET = 32U; // eboot command of the OTA update is in front
+static const uint32_t RTC_USER_BLOCKS = 128U;
+static const uint32_t RECORD_MAGIC = 0x4E42504DUL; // "MPBN"
+static const uint16_t RECORD_VERSION = 1U;
+
+/// Record as it is kept in the RTC user memory.  All members are words.
+typedef struct
+{
+  uint32_t magic;
+  uint32_t version;
+  uint32_t boot_count;
+  uint32_t head; // count of events recorded so far
+  uint32_t crash_uptime_ms;
+  uint32_t isr_max_us;
+  uint32_t heap_min;
+  postmortem_event_t events[POSTMORTEM_EVENT_CNT];
+} record_t;
+
+static_assert(sizeof(postmortem_event_t) % 4U == 0U, "Events must be stored in whole blocks");
+static_assert(RTC_USER_OFFSET + sizeof(record_t) / 4U <= RTC_USER_BLOCKS, "Record exceeds the RTC user memory");
+
+// Local variables
+static record_t _record; // copy of the RTC user memory
+static postmortem_info_t _info;
+
+// Local function prototypes
+static void store(const void *member, size_t size);
+
+// Called by the core after an exception or a software watchdog reset, before the reset.
+extern "C" void custom_crash_callback(struct rst_info *rst_info, uint32_t stack, uint32_t stack_end)
+{
+  (void)stack;
+  (void)stack_end;
+  if (_record.magic != RECORD_MAGIC)
+    return;
+  (void)rst_info; // the core passes it on to the next boot anyway
+  _record.crash_uptime_ms = millis();
+  store(&_record.crash_uptime_ms, sizeof(_record.crash_uptime_ms));
+}
+
+bool postmortemBegin()
+{
+  const bool is_valid = ESP.rtcUserMemoryRead(RTC_USER_OFFSET, (uint32_t *)&_record, sizeof(_record)) &&
+                        _record.magic == RECORD_MAGIC && _record.version == RECORD_VERSION;
+  if (!is_valid)
+  {
+    memset(&_record, 0, sizeof(_record));
+    _record.magic = RECORD_MAGIC;
+    _record.version = RECORD_VERSION;
+  }
+  // The reset cause comes from the core, the rest from the previous run.
+  const rst_info *reset_info = ESP.getResetInfoPtr();
+  _info.boot_count = ++_record.boot_count;
+  _info.reset_reason = reset_info->reason;
+  _info.exccause = reset_info->exccause;
+  _info.epc1 = reset_info->epc1;
+  _info.excvaddr = reset_info->excvaddr;
+  _info.crash_uptime_ms = _record.crash_uptime_ms;
+  _info.isr_max_us = _record.isr_max_us;
+  _info.heap_min = _record.heap_min;
+  // New run
+  _record.crash_uptime_ms = 0;
+  _record.isr_max_us = 0;
+  _record.heap_min = UINT32_MAX;
+  store(&_record, sizeof(_record));
+  return is_valid;
+}
+
+void postmortemEvent(uint8_t id, int32_t arg)
+{
+  postmortem_event_t &event = _record.events[_record.head % POSTMORTEM_EVENT_CNT];
+  event.uptime_ms = millis();
+  event.boot = _record.boot_count;
+  event.id = id;
+  event.reserved = 0;
+  event.arg = arg;
+  store(&event, sizeof(event));
+  _record.head++;
+  store(&_record.head, sizeof(_record.head));
+}
+
+void postmortemUpdate(uint32_t isr_max_us, uint32_t heap_free)
+{
+  if (isr_max_us > _record.isr_max_us)
+  {
+    _record.isr_max_us = isr_max_us;
+    store(&_record.isr_max_us, sizeof(_record.isr_max_us));
+  }
+  if (heap_free < _record.heap_min)
+  {
+    _record.heap_min = heap_free;
+    store(&_record.heap_min, sizeof(_record.heap_min));
+  }
+}
+
+const postmortem_info_t *postmortemInfo()
+{
+  return &_info;
+}
+
+bool postmortemGetEvent(unsigned age, postmortem_event_t *event)
+{
+  if (age >= POSTMORTEM_EVENT_CNT || age >= _record.head)
+    return false;
+  *event = _record.events[(_record.head - 1U - age) % POSTMORTEM_EVENT_CNT];
+  return true;
+}
+
+void postmortemClear()
+{
+  _record.boot_count = 0;
+  _record.head = 0;
+  memset(_record.events, 0, sizeof(_record.events));
+  store(&_record, sizeof(_record));
+}
+
+//********************************************************************
+// Local functions
+//********************************************************************
+
+// Write a member of _record through to the RTC user memory.
+static void store(const void *member, size_t size)
+{
+  const size_t offset = (const uint8_t *)member - (const uint8_t *)&_record;
+  ESP.rtcUserMemoryWrite(RTC_USER_OFFSET + offset / 4U, (uint32_t *)member, size);
+}
@@ -0,0 +1,84 @@
+/**
+  \file   postmortem.h
+  \brief  Crash and reset post-mortem kept in the RTC user memory of the ESP8266.
+
+  The user memory of the RTC survives soft resets, exceptions and watchdog
+  resets, but not a loss of power.  It keeps the last significant events, the
+  cause of the last reset and the high-water marks of the ISR duration and the
+  heap usage of the previous run.  So the reason of a crash can be read from the
+  debug terminal or the telemetry after the reset, without a serial console
+  having been attached at the time of the crash.
+
+  Only the words changed are written, an event costs four words.  Events of the
+  event log are mirrored into the ring, see event_log.h.  The first
+  128 bytes of the user memory are left for the OTA boot loader command.
+*/
+#ifndef POSTMORTEM_H
+#define POSTMORTEM_H
+
+#include <Arduino.h>
+#include <cstdint>
+
+/// Count of events kept in the ring.
+const unsigned POSTMORTEM_EVENT_CNT = 12U;
+
+/// Event kept in the ring.
+typedef struct
+{
+  uint32_t uptime_ms; ///< millis() when the event was recorded
+  uint16_t boot;      ///< Boot count when the event was recorded
+  uint8_t id;         ///< event_id_e, see event_log.h
+  uint8_t reserved;   ///< Always 0
+  int32_t arg;        ///< First argument of the event
+} postmortem_event_t;
+
+/// Post-mortem of the previous run as found at boot.
+typedef struct
+{
+  uint32_t boot_count;      ///< Count of boots since the last power on
+  uint32_t reset_reason;    ///< REASON_* of rst_info, see user_interface.h
+  uint32_t exccause;        ///< Exception cause if reset by an exception
+  uint32_t epc1;            ///< PC of the exception
+  uint32_t excvaddr;        ///< Virtual address of the exception
+  uint32_t crash_uptime_ms; ///< Uptime of the crash, 0 if there was no crash
+  uint32_t isr_max_us;      ///< Longest run of the display ISR of the previous run
+  uint32_t heap_min;        ///< Least free heap of the previous run
+} postmortem_info_t;
+
+/**
+ * \brief Loads the post-mortem at boot and starts a new run.
+ * \return true if the RTC user memory held a valid post-mortem, false after a power on.
+ */
+bool postmortemBegin();
+
+/**
+ * \brief Records a significant event in the ring.
+ * \param id Event ID, see event_log.h.
+ * \param arg First argument of the event.
+ */
+void postmortemEvent(uint8_t id, int32_t arg);
+
+/**
+ * \brief Updates the high-water marks of this run.
+ * \param isr_max_us Longest run of the display ISR.
+ * \param heap_free Free heap.
+ *
+ * Only a new high-water mark is written.
+ */
+void postmortemUpdate(uint32_t isr_max_us, uint32_t heap_free);
+
+/// Post-mortem of the previous run.
+const postmortem_info_t *postmortemInfo();
+
+/**
+ * \brief Reads an event of the ring.
+ * \param age 0 for the newest event.
+ * \param event Receives the event.
+ * \return false if there is no event of that age.
+ */
+bool postmortemGetEvent(unsigned age, postmortem_event_t *event);
+
+/// Erases the events and the boot count.
+void postmortemClear();
+
+#endif // POSTMORTEM_H
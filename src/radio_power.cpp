@@ -0,0 +1,85 @@
+#include "radio_power.h"
+
+#include <Arduino.h>
+#include <ESP8266WiFi.h>
+
+// Local variables
+static radio_state_e _state;
+static radio_stats_t _stats;
+static unsigned long _off_ms;
+static unsigned long _wake_ms;
+static time_t _deadline_utc;
+static bool _sync_pending;
+
+void radioPowerOff()
+{
+  if (_state == RADIO_OFF)
+    return;
+  // WiFi.disconnect() would erase the stored credentials, turning the mode off keeps them.  setup() has
+  // turned off WiFi.persistent(), so this does not write to flash.
+  WiFi.mode(WIFI_OFF);
+  WiFi.forceSleepBegin();
+  _state = RADIO_OFF;
+  _sync_pending = false;
+  _off_ms = millis();
+}
+
+void radioPowerWake(time_t deadline_utc)
+{
+  if (_state != RADIO_OFF)
+    return;
+  _stats.off_s += (millis() - _off_ms) / 1000UL;
+  WiFi.forceSleepWake();
+  WiFi.mode(WIFI_STA);
+  WiFi.begin();
+  _state = RADIO_WAKING;
+  _stats.wakes++;
+  _wake_ms = millis();
+  _deadline_utc = deadline_utc;
+  _sync_pending = true;
+}
+
+radio_event_e radioPowerPoll()
+{
+  if (_state != RADIO_WAKING)
+    return RADIO_NO_EVENT;
+  const unsigned long elapsed_ms = millis() - _wake_ms;
+  if (WiFi.isConnected())
+  {
+    _state = RADIO_ON;
+    _stats.reconnect_ms = min(elapsed_ms, (unsigned long)UINT16_MAX);
+    if (_stats.reconnect_ms > _stats.reconnect_ms_max)
+      _stats.reconnect_ms_max = _stats.reconnect_ms;
+    return RADIO_CONNECTED;
+  }
+  if (elapsed_ms < RADIO_CONNECT_TIMEOUT_MS)
+    return RADIO_NO_EVENT;
+  // The station keeps on trying in the background.
+  _state = RADIO_ON;
+  _sync_pending = false;
+  _stats.timeouts++;
+  return RADIO_CONNECT_TIMEOUT;
+}
+
+bool radioPowerSynced(time_t utc)
+{
+  if (!_sync_pending)
+    return false;
+  _sync_pending = false;
+  _stats.first_sync_ms = min(millis() - _wake_ms, (unsigned long)UINT16_MAX);
+  if (_stats.first_sync_ms > _stats.first_sync_ms_max)
+    _stats.first_sync_ms_max = _stats.first_sync_ms;
+  if (_deadline_utc != 0 && utc > _deadline_utc)
+    _stats.late_syncs++;
+  return true;
+}
+
+radio_state_e radioPowerState()
+{
+  return _state;
+}
+
+const radio_stats_t *radioPowerStats()
+{
+  return &_stats;
+}
@@ -0,0 +1,84 @@
+/**
+  \file   radio_power.h
+  \brief  Radio shutdown in idle time with wake-ups for the NTP sync.
+
+  In idle time the display is off, but the WiFi radio used to stay associated
+  with the access point all the time.  radioPowerOff() turns the radio off, the
+  time is kept by the system clock and the drift corrected RTC meanwhile.
+  radioPowerWake() turns it on again for a scheduled NTP sync or shortly before
+  the display is turned on.  radioPowerPoll() watches the reconnect.
+
+  The latency from the wake-up to the connection and to the first NTP sync is
+  measured, so it can be checked that the display comes back on time.  A sync
+  is late if it is done after the deadline given to radioPowerWake().
+
+  The WiFi credentials are kept, the station reconnects with the stored
+  configuration.
+*/
+#ifndef RADIO_POWER_H
+#define RADIO_POWER_H
+
+#include <cstdint>
+#include <ctime>
+
+/// A reconnect not done within this time is given up, the radio stays on.
+const unsigned long RADIO_CONNECT_TIMEOUT_MS = 20000UL;
+
+/// State of the radio
+typedef enum
+{
+  RADIO_ON = 0, ///< Radio is on, the station may be connected or not
+  RADIO_OFF,    ///< Radio is turned off
+  RADIO_WAKING  ///< Radio is on and waiting for the connection
+} radio_state_e;
+
+/// Result of radioPowerPoll()
+typedef enum
+{
+  RADIO_NO_EVENT = 0,    ///< Nothing happened
+  RADIO_CONNECTED,       ///< Connection is back after a wake-up
+  RADIO_CONNECT_TIMEOUT  ///< No connection within RADIO_CONNECT_TIMEOUT_MS after a wake-up
+} radio_event_e;
+
+/// Statistics of the wake-ups since boot
+typedef struct
+{
+  uint16_t wakes;              ///< Count of wake-ups
+  uint16_t timeouts;           ///< Wake-ups without connection
+  uint16_t late_syncs;         ///< First syncs done after the deadline
+  uint16_t reconnect_ms;       ///< Wake-up to connection, last wake-up
+  uint16_t reconnect_ms_max;   ///< Wake-up to connection, worst case
+  uint16_t first_sync_ms;      ///< Wake-up to first NTP sync, last wake-up
+  uint16_t first_sync_ms_max;  ///< Wake-up to first NTP sync, worst case
+  uint32_t off_s;              ///< Total time with the radio turned off
+} radio_stats_t;
+
+/// Turns the radio off.
+void radioPowerOff();
+
+/**
+ * \brief Turns the radio on and reconnects.
+ * \param deadline_utc The first sync is counted late after this time, 0 if there is no deadline.
+ */
+void radioPowerWake(time_t deadline_utc);
+
+/**
+ * \brief Watches the reconnect.  To be called from loop().
+ * \return Event of this call.
+ */
+radio_event_e radioPowerPoll();
+
+/**
+ * \brief Records the first NTP sync after a wake-up.  Further calls are ignored.
+ * \param utc Time of the sync.
+ * \return true if this was the first sync after a wake-up.
+ */
+bool radioPowerSynced(time_t utc);
+
+/// Current state of the radio.
+radio_state_e radioPowerState();
+
+/// Statistics since boot.
+const radio_stats_t *radioPowerStats();
+
+#endif // RADIO_POWER_H
@@ -0,0 +1,134 @@
+#include "rtc_nvram.h"
+
+#include <Arduino.h>
+#include <Wire.h>
+#include <cstring>
+#include "crc.h"
+
+// DS1307 RAM layout
+static const uint8_t DS1307_I2C_ADDRESS = 0x68;
+static const uint8_t DS1307_RAM_REGISTER = 0x08;
+static const uint8_t DS1307_RAM_SIZE = 56;
+
+// Record layout, all values little endian
+static const uint8_t RECORD_MAGIC = 0x42;
+static const uint8_t RECORD_VERSION = 1;
+static const uint8_t RECORD_SIZE = 22; // magic, version, 18 bytes payload, crc
+static_assert(RECORD_SIZE <= DS1307_RAM_SIZE, "Record exceeds the RTC RAM");
+
+// Local function prototypes
+static void put_u32(uint8_t *p, uint32_t value);
+static uint32_t get_u32(const uint8_t *p);
+
+void rtcNvramInit(rtc_nvram_state_t *state, uint16_t schedule_version)
+{
+  memset(state, 0, sizeof(*state));
+  state->schedule_version = schedule_version;
+}
+
+bool rtcNvramLoad(rtc_nvram_state_t *state)
+{
+  uint8_t record[RECORD_SIZE];
+
+  Wire.beginTransmission(DS1307_I2C_ADDRESS);
+  Wire.write(DS1307_RAM_REGISTER);
+  if (Wire.endTransmission() != 0)
+    return false;
+  // One burst for the whole record
+  if (Wire.requestFrom(DS1307_I2C_ADDRESS, (size_t)RECORD_SIZE) != RECORD_SIZE)
+    return false;
+  for (uint8_t i = 0; i < RECORD_SIZE; i++)
+    record[i] = Wire.read();
+
+  if (record[0] != RECORD_MAGIC || record[1] != RECORD_VERSION)
+    return false;
+  const uint16_t crc = record[RECORD_SIZE - 2] | (record[RECORD_SIZE - 1] << 8);
+  if (crc16Ccitt(record, RECORD_SIZE - 2) != crc)
+    return false;
+
+  state->last_sync_utc = get_u32(&record[2]);
+  state->rtc_set_utc = get_u32(&record[6]);
+  state->offset_s = (int32_t)get_u32(&record[10]);
+  state->drift_ppb = (int32_t)get_u32(&record[14]);
+  state->schedule_version = record[18] | (record[19] << 8);
+  return true;
+}
+
+bool rtcNvramStore(const rtc_nvram_state_t *state)
+{
+  uint8_t record[RECORD_SIZE];
+
+  record[0] = RECORD_MAGIC;
+  record[1] = RECORD_VERSION;
+  put_u32(&record[2], state->last_sync_utc);
+  put_u32(&record[6], state->rtc_set_utc);
+  put_u32(&record[10], (uint32_t)state->offset_s);
+  put_u32(&record[14], (uint32_t)state->drift_ppb);
+  record[18] = state->schedule_version & 0xFF;
+  record[19] = state->schedule_version >> 8;
+  const uint16_t crc = crc16Ccitt(record, RECORD_SIZE - 2);
+  record[RECORD_SIZE - 2] = crc & 0xFF;
+  record[RECORD_SIZE - 1] = crc >> 8;
+
+  Wire.beginTransmission(DS1307_I2C_ADDRESS);
+  Wire.write(DS1307_RAM_REGISTER);
+  Wire.write(record, RECORD_SIZE);
+  return Wire.endTransmission() == 0;
+}
+
+bool rtcNvramOnSync(rtc_nvram_state_t *state, time_t rtc_utc, time_t ntp_utc)
+{
+  const int32_t offset_s = (int32_t)(rtc_utc - ntp_utc);
+
+  state->offset_s = offset_s;
+  state->last_sync_utc = ntp_utc;
+  // Nothing known about the RTC, so it is set without estimating a drift.
+  if (state->rtc_set_utc == 0 || rtc_utc == 0)
+  {
+    state->rtc_set_utc = ntp_utc;
+    return true;
+  }
+  // The RTC is still right within its resolution.
+  if (offset_s == 0)
+    return false;
+  const int32_t span_s = (int32_t)(ntp_utc - state->rtc_set_utc);
+  if (span_s >= (int32_t)RTC_NVRAM_DRIFT_MIN_SPAN_S)
+  {
+    const int64_t drift_ppb = (int64_t)offset_s * 1000000000LL / span_s;
+    if (drift_ppb >= -RTC_NVRAM_DRIFT_MAX_PPB && drift_ppb <= RTC_NVRAM_DRIFT_MAX_PPB)
+    {
+      // Smoothing, the offset has a resolution of one second only.
+      if (state->drift_ppb == 0)
+        state->drift_ppb = (int32_t)drift_ppb;
+      else
+        state->drift_ppb = (int32_t)((3LL * state->drift_ppb + drift_ppb) / 4);
+    }
+  }
+  state->rtc_set_utc = ntp_utc;
+  return true;
+}
+
+time_t rtcNvramCorrect(const rtc_nvram_state_t *state, time_t rtc_utc)
+{
+  if (state->rtc_set_utc == 0 || rtc_utc <= (time_t)state->rtc_set_utc)
+    return rtc_utc;
+  const int64_t span_s = rtc_utc - (time_t)state->rtc_set_utc;
+  return rtc_utc - (time_t)(span_s * state->drift_ppb / 1000000000LL);
+}
+
+//********************************************************************
+// Local functions
+//********************************************************************
+
+static void put_u32(uint8_t *p, uint32_t value)
+{
+  p[0] = value & 0xFF;
+  p[1] = (value >> 8) & 0xFF;
+  p[2] = (value >> 16) & 0xFF;
+  p[3] = value >> 24;
+}
+
+static uint32_t get_u32(const uint8_t *p)
+{
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
@@ -0,0 +1,76 @@
+/**
+  \file   rtc_nvram.h
+  \brief  Synchronization state kept in the battery backed RAM of the DS1307.
+
+  The DS1307 has 56 bytes of RAM at the registers 0x08 to 0x3F which keep their
+  content as long as the RTC is running on its battery.  The firmware stores the
+  state of its time synchronization there, so after a reboot the clock is able
+  to correct the drift of the RTC right away and does not need to wait for a NTP
+  server before it can trust the time.
+
+  The record is protected by a CRC and is read in a single I2C burst.
+*/
+#ifndef RTC_NVRAM_H
+#define RTC_NVRAM_H
+
+#include <TimeLib.h>
+#include <cstdint>
+
+/// A drift is estimated only over spans of at least this length.
+const uint32_t RTC_NVRAM_DRIFT_MIN_SPAN_S = 6UL * 3600UL;
+/// Drift estimates beyond this are treated as a RTC that was set wrong.
+const int32_t RTC_NVRAM_DRIFT_MAX_PPB = 500000L;
+
+/// Synchronization state as it is kept in the RTC RAM.
+typedef struct
+{
+  uint32_t last_sync_utc;    ///< Time of the last successful NTP synchronization
+  uint32_t rtc_set_utc;      ///< Time the RTC was set last, reference of the drift
+  int32_t offset_s;          ///< RTC minus NTP time seen at the last synchronization
+  int32_t drift_ppb;         ///< Estimated drift of the RTC, positive if running fast
+  uint16_t schedule_version; ///< Version of the idle schedule and timezone rules
+} rtc_nvram_state_t;
+
+/**
+ * \brief Initializes a state for a cold start.
+ * \param state State to be initialized.
+ * \param schedule_version Version of the active idle schedule and timezone rules.
+ */
+void rtcNvramInit(rtc_nvram_state_t *state, uint16_t schedule_version);
+
+/**
+ * \brief Reads the state from the RTC RAM.
+ * \param state Receives the state.
+ * \return false if there was no valid record or the RTC could not be accessed.
+ */
+bool rtcNvramLoad(rtc_nvram_state_t *state);
+
+/**
+ * \brief Writes the state to the RTC RAM.
+ * \param state State to be written.
+ * \return false if the RTC could not be accessed.
+ */
+bool rtcNvramStore(const rtc_nvram_state_t *state);
+
+/**
+ * \brief Updates offset and drift after a NTP synchronization.
+ * \param state State to be updated.
+ * \param rtc_utc Time read from the RTC right before.
+ * \param ntp_utc Time received from the NTP server.
+ * \return true if the RTC has to be set to ntp_utc.
+ *
+ * The RTC is set only if it has gone off by at least one second, which is its
+ * resolution.  The drift is estimated from this offset and the time since the RTC
+ * has been set last.
+ */
+bool rtcNvramOnSync(rtc_nvram_state_t *state, time_t rtc_utc, time_t ntp_utc);
+
+/**
+ * \brief Corrects a time read from the RTC by the estimated drift.
+ * \param state Current state.
+ * \param rtc_utc Time read from the RTC.
+ * \return Corrected time.
+ */
+time_t rtcNvramCorrect(const rtc_nvram_state_t *state, time_t rtc_utc);
+
+#endif // RTC_NVRAM_H
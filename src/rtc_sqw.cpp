@@ -0,0 +1,105 @@
+#include "rtc_sqw.h"
+
+#include <Arduino.h>
+#include <DS1307RTC.h>
+#include <Wire.h>
+#include "multiplexing.h"
+
+// DS1307 register settings
+static const uint8_t DS1307_I2C_ADDRESS = 0x68;
+static const uint8_t DS1307_CONTROL_REGISTER = 0x07;
+static const uint8_t DS1307_CONTROL_SQWE_1HZ = 0x10; // SQWE set, RS1 and RS0 cleared
+static const uint8_t DS1307_CONTROL_OUT_HIGH = 0x80; // SQWE cleared, OUT set: the open drain is released
+
+// Local function prototypes
+static bool write_control(uint8_t control);
+
+// Local variables shared with the edge interrupt
+static volatile uint32_t _sqw_ticks;
+
+// Local variables of the loop() context
+static bool _is_locked;
+static bool _resync_necessary;
+static uint32_t _resync_ticks;
+static uint32_t _anchor_ticks;
+static time_t _anchor_utc;
+static uint8_t _pin;
+static bool _is_enabled;
+
+bool rtcSqwBegin(uint8_t pin)
+{
+  if (!write_control(DS1307_CONTROL_SQWE_1HZ))
+    return false;
+  _pin = pin;
+  _is_enabled = true;
+  pinMode(pin, INPUT_PULLUP);
+  attachInterrupt(digitalPinToInterrupt(pin), rtcSqwEdge, FALLING);
+  rtcSqwResync();
+  return true;
+}
+
+bool rtcSqwEnd()
+{
+  if (!_is_enabled)
+    return true;
+  detachInterrupt(digitalPinToInterrupt(_pin));
+  _is_enabled = false;
+  _is_locked = false;
+  return write_control(DS1307_CONTROL_OUT_HIGH);
+}
+
+void ICACHE_RAM_ATTR rtcSqwEdge()
+{
+  _sqw_ticks = _sqw_ticks + 1;
+  commitVfdFrame();
+}
+
+void rtcSqwResync()
+{
+  _resync_ticks = _sqw_ticks;
+  _resync_necessary = true;
+}
+
+void rtcSqwPoll()
+{
+  if (!_resync_necessary)
+    return;
+  const uint32_t ticks = _sqw_ticks;
+  if (ticks == _resync_ticks)
+    return; // Wait for the next edge, there is almost a second for reading the RTC then.
+  // Caution: In case of error RTC.get() returns 0
+  const time_t utc_time = RTC.get();
+  if (utc_time == 0 || ticks != _sqw_ticks)
+    return; // Failed or an edge came in between, so try again.
+  _anchor_ticks = ticks;
+  _anchor_utc = utc_time;
+  _is_locked = true;
+  _resync_necessary = false;
+}
+
+bool rtcSqwIsLocked()
+{
+  return _is_locked;
+}
+
+uint32_t rtcSqwTicks()
+{
+  return _sqw_ticks;
+}
+
+time_t rtcSqwNow()
+{
+  return _anchor_utc + (time_t)(_sqw_ticks - _anchor_ticks);
+}
+
+//********************************************************************
+// Local functions
+//********************************************************************
+
+static bool write_control(uint8_t control)
+{
+  Wire.beginTransmission(DS1307_I2C_ADDRESS);
+  Wire.write(DS1307_CONTROL_REGISTER);
+  Wire.write(control);
+  return Wire.endTransmission() == 0;
+}
@@ -0,0 +1,88 @@
+/**
+  \file   rtc_sqw.h
+  \brief  Seconds tick derived from the 1 Hz square wave output of the DS1307.
+
+  The DS1307 is able to put out a temperature stable 1 Hz square wave on its
+  SQW/OUT pin.  Its falling edge is synchronous with the update of the seconds
+  register.  When this pin is connected to a GPIO, an edge interrupt counts the
+  seconds and swaps in the frame prepared by armVfdFrame().  So the second
+  transitions of the display are phase locked to the RTC and loop() has nothing
+  to do between two ticks.
+
+  The seconds counter is anchored to the time of the RTC right after an edge.
+  This has to be repeated whenever the RTC has been set, see rtcSqwResync().
+
+  The edge handler rtcSqwEdge() is not hidden, so edges can be injected by a
+  test or by any other 1 Hz source.
+
+  The DS1307 keeps its control register and drives SQW/OUT while running on its
+  battery.  If SQW/OUT is wired to a boot strapping pin like GPIO0, a reset
+  during the low half of the square wave starts the ROM boot loader instead of
+  the firmware.  rtcSqwEnd() parks the output high and has to be called before
+  every intended restart.  It cannot help after a crash, a hardware watchdog
+  reset or a loss of power, see SUPPORT_RTC_SQW_TICK in main.cpp.
+
+  The ticks come from the crystal of the DS1307, so rtcSqwNow() is off by the
+  same drift as the RTC itself.  The caller corrects it like any other time
+  read from the RTC, see rtcNvramCorrect().
+*/
+#ifndef RTC_SQW_H
+#define RTC_SQW_H
+
+#include <TimeLib.h>
+#include <cstdint>
+
+/**
+ * \brief Enables the 1 Hz output of the DS1307 and attaches the edge interrupt.
+ * \param pin GPIO connected to SQW/OUT.  The output is open drain, so a pull-up is needed.
+ * \return false if the DS1307 could not be configured.
+ */
+bool rtcSqwBegin(uint8_t pin);
+
+/**
+ * \brief Disables the square wave and releases SQW/OUT, so it is pulled high.
+ * \return false if the DS1307 could not be configured.
+ */
+bool rtcSqwEnd();
+
+/**
+ * \brief Handles a falling edge of SQW/OUT.
+ *
+ * Advances the seconds counter and shows the frame prepared by armVfdFrame().
+ */
+void rtcSqwEdge();
+
+/**
+ * \brief Requests a new anchor of the seconds counter on the next tick.
+ *
+ * Must be called after the RTC has been set, e.g. after a NTP synchronization.
+ */
+void rtcSqwResync();
+
+/**
+ * \brief Anchors the seconds counter if requested.  To be called from loop().
+ *
+ * The RTC is read over I2C only right after a tick has been seen and only if an
+ * anchor is necessary.
+ */
+void rtcSqwPoll();
+
+/**
+ * \brief Tells if the seconds counter has been anchored to the RTC.
+ * \return true if rtcSqwNow() is valid.
+ */
+bool rtcSqwIsLocked();
+
+/**
+ * \brief Count of edges since rtcSqwBegin().
+ * \return Edge count.
+ */
+uint32_t rtcSqwTicks();
+
+/**
+ * \brief UTC time given by the seconds counter.
+ * \return Time of the last tick, only valid if rtcSqwIsLocked().
+ */
+time_t rtcSqwNow();
+
+#endif // RTC_SQW_H
@@ -0,0 +1,142 @@
+#include "shell.h"
+
+#include <cstring>
+
+// Control characters used for line editing
+static const char CTRL_C = 0x03;
+static const char CTRL_U = 0x15;
+static const char BACKSPACE = 0x08;
+static const char DEL = 0x7F;
+
+// Local variables
+static Stream *_stream;
+static const shell_cmd_t *_commands;
+static size_t _command_cnt;
+static char _line[SHELL_LINE_LEN];
+static size_t _line_len;
+static char _last_char;
+
+// Local function prototypes
+static void prompt();
+static void execute();
+
+void shellBegin(Stream *stream, const shell_cmd_t *commands, size_t command_cnt)
+{
+  _stream = stream;
+  _commands = commands;
+  _command_cnt = command_cnt;
+  _line_len = 0;
+  prompt();
+}
+
+void shellPoll()
+{
+  if (_stream == nullptr)
+    return;
+  // Bounded by the bytes received so far, a command ends the round.
+  while (_stream->available() > 0)
+  {
+    const int c = _stream->read();
+    if (c < 0)
+      break;
+    const char last_char = _last_char;
+    _last_char = c;
+    switch (c)
+    {
+    case '\n':
+      if (last_char == '\r')
+        break; // CR LF is a single line end
+      // fall through
+    case '\r':
+      _stream->println();
+      execute();
+      prompt();
+      return;
+    case BACKSPACE:
+    case DEL:
+      if (_line_len > 0)
+      {
+        _line_len--;
+        _stream->print(F("\b \b"));
+      }
+      break;
+    case CTRL_U:
+      while (_line_len > 0)
+      {
+        _line_len--;
+        _stream->print(F("\b \b"));
+      }
+      break;
+    case CTRL_C:
+      _line_len = 0;
+      _stream->println(F("^C"));
+      prompt();
+      break;
+    default:
+      if (c >= ' ' && _line_len < SHELL_LINE_LEN - 1)
+      {
+        _line[_line_len++] = c;
+        _stream->write((uint8_t)c);
+      }
+      break;
+    }
+  }
+}
+
+void shellHelp()
+{
+  char name[SHELL_NAME_LEN];
+
+  for (size_t i = 0; i < _command_cnt; i++)
+  {
+    strncpy_P(name, _commands[i].name, sizeof(name));
+    name[sizeof(name) - 1] = '\0';
+    _stream->printf(" %-10s ", name);
+    _stream->println(FPSTR(_commands[i].usage));
+  }
+}
+
+//********************************************************************
+// Local functions
+//********************************************************************
+
+static void prompt()
+{
+  _stream->print(F("vfd> "));
+}
+
+static void execute()
+{
+  char *argv[SHELL_ARGV_CNT];
+  int argc = 0;
+
+  // Split into arguments, the line buffer is reused for them.
+  _line[_line_len] = '\0';
+  _line_len = 0;
+  char *save_ptr = nullptr;
+  for (char *token = strtok_r(_line, " \t", &save_ptr); token != nullptr;
+       token = strtok_r(nullptr, " \t", &save_ptr))
+  {
+    if (argc == SHELL_ARGV_CNT)
+    {
+      _stream->printf_P(PSTR("Too many arguments, at most %d are accepted.\n"), SHELL_ARGV_CNT - 1);
+      return;
+    }
+    argv[argc++] = token;
+  }
+  if (argc == 0)
+    return;
+
+  for (size_t i = 0; i < _command_cnt; i++)
+  {
+    if (strcmp_P(argv[0], _commands[i].name) == 0)
+    {
+      shell_handler_t handler = reinterpret_cast<shell_handler_t>(pgm_read_ptr(&_commands[i].handler));
+      handler(argc, argv);
+      return;
+    }
+  }
+  _stream->print(F("Unknown command '"));
+  _stream->print(argv[0]);
+  _stream->println(F("', try 'help'."));
+}
@@ -0,0 +1,65 @@
+/**
+  \file   shell.h
+  \brief  Non-blocking line oriented command shell for the debug terminal.
+
+  Received bytes are collected in a fixed line buffer with simple line editing
+  (backspace, Ctrl-U to kill the line, Ctrl-C to cancel).  A complete line is
+  split into arguments and looked up in a constant command table kept in flash.
+  The bytes themselves are buffered by the receive ring of the UART driver, so
+  shellPoll() has nothing to do unless bytes have arrived.
+
+  Example of a command table:
+  \code{.cpp}
+  static void cmd_hello(int argc, char *argv[]);
+  static const shell_cmd_t COMMANDS[] PROGMEM = {
+      {"hello", "[name]  say hello", cmd_hello},
+  };
+  shellBegin(&Serial, COMMANDS, sizeof(COMMANDS) / sizeof(COMMANDS[0]));
+  \endcode
+*/
+#ifndef SHELL_H
+#define SHELL_H
+
+#include <Arduino.h>
+#include <cstddef>
+
+/// Maximum length of a command line.
+const size_t SHELL_LINE_LEN = 80U;
+/// Maximum count of arguments including the command name, "config set dst" takes 9.
+const int SHELL_ARGV_CNT = 10;
+/// Maximum length of a command name including the terminating zero.
+const size_t SHELL_NAME_LEN = 12U;
+/// Maximum length of the usage text including the terminating zero.
+const size_t SHELL_USAGE_LEN = 60U;
+
+/// Command handler, argv[0] is the name of the command.
+typedef void (*shell_handler_t)(int argc, char *argv[]);
+
+/// Entry of the command table.  The table has to be kept in PROGMEM.
+typedef struct
+{
+  char name[SHELL_NAME_LEN];   ///< Name of the command
+  char usage[SHELL_USAGE_LEN]; ///< Arguments and short description shown by shellHelp()
+  shell_handler_t handler;     ///< Function to be called
+} shell_cmd_t;
+
+/**
+ * \brief Starts the shell.
+ * \param stream Stream of the terminal, usually Serial.
+ * \param commands Command table in PROGMEM.
+ * \param command_cnt Count of entries in the command table.
+ */
+void shellBegin(Stream *stream, const shell_cmd_t *commands, size_t command_cnt);
+
+/**
+ * \brief Processes received bytes.  To be called from loop().
+ *
+ * Returns at once if nothing has been received.  At most one command is executed
+ * per call.
+ */
+void shellPoll();
+
+/// Prints the command table.
+void shellHelp();
+
+#endif // SHELL_H
@@ -0,0 +1,84 @@
+/**
+  \file   spsc_ring.h
+  \brief  Lock-free single-producer/single-consumer ring buffer.
+
+  The ring is meant for handing data from the Arduino loop() context to an
+  interrupt service routine (or the other way round) without disabling
+  interrupts.  Exactly one context may call push() and exactly one context may
+  call pop().  The ESP8266 has a single core, so compiler fences are sufficient
+  to order the payload copy against the index update.
+
+  All methods are forced inline, so an ISR placed in IRAM by ICACHE_RAM_ATTR
+  does not call out to flash resident code when it uses the ring.
+*/
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <atomic>
+#include <cstdint>
+
+#define SPSC_RING_INLINE inline __attribute__((always_inline))
+
+/**
+ * \brief Fixed size single-producer/single-consumer ring.
+ * \tparam T Element type.  It is copied by value.
+ * \tparam N Count of elements.  Must be a power of two and at most 32768.
+ */
+template <typename T, uint16_t N>
+class SpscRing
+{
+  static_assert(N > 0U && (N & (N - 1U)) == 0U, "SpscRing size must be a power of two");
+  static_assert(N <= 32768U, "SpscRing size must fit the 16 bit index arithmetic");
+
+public:
+  /**
+   * \brief Appends an element.  Producer side only.
+   * \param item Element to be copied into the ring.
+   * \return false if the ring was full and the element was dropped.
+   */
+  SPSC_RING_INLINE bool push(const T &item)
+  {
+    const uint16_t head = _head;
+    if ((uint16_t)(head - _tail) >= N)
+      return false;
+    _items[head & (N - 1U)] = item;
+    // Payload has to be complete before the consumer can see the new head.
+    std::atomic_signal_fence(std::memory_order_release);
+    _head = head + 1U;
+    return true;
+  }
+
+  /**
+   * \brief Removes the oldest element.  Consumer side only.
+   * \param item Receives the element.
+   * \return false if the ring was empty.
+   */
+  SPSC_RING_INLINE bool pop(T &item)
+  {
+    const uint16_t tail = _tail;
+    if (tail == _head)
+      return false;
+    std::atomic_signal_fence(std::memory_order_acquire);
+    item = _items[tail & (N - 1U)];
+    // Slot must be read completely before the producer may reuse it.
+    std::atomic_signal_fence(std::memory_order_release);
+    _tail = tail + 1U;
+    return true;
+  }
+
+  /// Count of elements waiting in the ring.  Exact only from the consumer side.
+  SPSC_RING_INLINE uint16_t size() const { return (uint16_t)(_head - _tail); }
+
+  /// True if there are no elements waiting in the ring.
+  SPSC_RING_INLINE bool empty() const { return _head == _tail; }
+
+  /// Capacity of the ring.
+  static constexpr uint16_t capacity() { return N; }
+
+private:
+  T _items[N];
+  volatile uint16_t _head = 0U;
+  volatile uint16_t _tail = 0U;
+};
+
+#endif // SPSC_RING_H
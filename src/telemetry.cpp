@@ -0,0 +1,59 @@
+#include "telemetry.h"
+
+#include <Arduino.h>
+#include <cstring>
+#include "mem_monitor.h"
+#include "multiplexing.h"
+#include "postmortem.h"
+#include "radio_power.h"
+
+static_assert(TELEMETRY_PACKET_SIZE == 70U, "Telemetry layout changed, update the version and the collector");
+
+// Local variables
+static uint32_t _seq;
+
+bool telemetrySend(WiFiUDP &udp, IPAddress collector, uint16_t port, const telemetry_app_state_t *app)
+{
+  telemetry_packet_t packet;
+  vfd_isr_stats_t isr_stats;
+  const mem_stats_t *mem_stats = memMonitorStats();
+  const postmortem_info_t *postmortem = postmortemInfo();
+  const radio_stats_t *radio = radioPowerStats();
+
+  memset(&packet, 0, sizeof(packet));
+  packet.magic = TELEMETRY_MAGIC;
+  packet.version = TELEMETRY_VERSION;
+  packet.sync_source = app->sync_source;
+  packet.chip_id = ESP.getChipId();
+  packet.seq = _seq++;
+  packet.uptime_s = millis() / 1000UL;
+  packet.utc = app->utc;
+  packet.last_sync_utc = app->last_sync_utc;
+  packet.rtc_offset_s = app->rtc_offset_s;
+  packet.drift_ppb = app->drift_ppb;
+  packet.ntp_delay_ms = app->ntp_delay_ms;
+  packet.rtc_fallbacks = app->rtc_fallbacks;
+  getVfdIsrStats(&isr_stats, true);
+  packet.isr_max_us = min(isr_stats.max_us, (uint32_t)UINT16_MAX);
+  packet.isr_jitter_us = min(isr_stats.max_jitter_us, (uint32_t)UINT16_MAX);
+  packet.heap_free = mem_stats->heap_free;
+  packet.heap_free_min = mem_stats->heap_free_min;
+  packet.block_max = mem_stats->block_max;
+  packet.block_max_min = mem_stats->block_max_min;
+  packet.stack_free_min = min(mem_stats->stack_free_min, (uint32_t)UINT16_MAX);
+  packet.fragmentation_max = mem_stats->fragmentation_max;
+  packet.display = app->display;
+  packet.brightness = app->brightness;
+  packet.reset_reason = postmortem->reset_reason;
+  packet.boot_count = postmortem->boot_count;
+  packet.radio_wakes = radio->wakes;
+  packet.radio_timeouts = radio->timeouts;
+  packet.reconnect_ms_max = radio->reconnect_ms_max;
+  packet.first_sync_ms_max = radio->first_sync_ms_max;
+  packet.late_syncs = radio->late_syncs;
+
+  if (udp.beginPacket(collector, port) != 1)
+    return false;
+  udp.write(reinterpret_cast<const uint8_t *>(&packet), sizeof(packet));
+  return udp.endPacket() == 1;
+}
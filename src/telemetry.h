@@ -0,0 +1,109 @@
+/**
+  \file   telemetry.h
+  \brief  Fixed layout telemetry datagram sent to a collector.
+
+  Once a minute the clock sends a single UDP datagram of TELEMETRY_PACKET_SIZE
+  bytes to the collector given by the runtime configuration.  The datagram is
+  a packed little endian struct, it is filled in from the counters of the other
+  modules without any string formatting.  tools/vfd_collector.py receives and
+  decodes the datagrams of all clocks.
+
+  The layout is versioned.  New members have to be appended and the version
+  incremented, the collector decodes the members it knows.
+*/
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <ESP8266WiFi.h>
+#include <WiFiUdp.h>
+#include <cstdint>
+
+/// Magic of the datagram, "NB" in little endian.
+const uint16_t TELEMETRY_MAGIC = 0x424E;
+/// Version of the datagram layout.
+const uint8_t TELEMETRY_VERSION = 2U;
+
+/// Source of the last synchronization of the system time
+typedef enum
+{
+  TELEMETRY_SYNC_NONE = 0, ///< Not synchronized yet
+  TELEMETRY_SYNC_NTP,      ///< NTP server
+  TELEMETRY_SYNC_RTC,      ///< RTC as fallback, no NTP reply
+  TELEMETRY_SYNC_WARM,     ///< Drift corrected RTC at a warm start
+  TELEMETRY_SYNC_PEER      ///< NTP server of the LAN, see ntp_server.h
+} telemetry_sync_source_e;
+
+/// Bits of telemetry_app_state_t::display
+typedef enum
+{
+  TELEMETRY_DISPLAY_ON = 0x01,        ///< Display and heating are on
+  TELEMETRY_DISPLAY_IDLE = 0x02,      ///< It is idle time
+  TELEMETRY_DISPLAY_STOPWATCH = 0x04, ///< Stopwatch is shown
+  TELEMETRY_DISPLAY_SQW_LOCKED = 0x08 ///< Seconds are counted by the RTC square wave
+} telemetry_display_e;
+
+/// State of the application to be reported
+typedef struct
+{
+  uint32_t utc;           ///< System time
+  uint32_t last_sync_utc; ///< Time of the last NTP synchronization
+  int32_t rtc_offset_s;   ///< RTC minus NTP time at the last synchronization
+  int32_t drift_ppb;      ///< Estimated drift of the RTC
+  uint16_t ntp_delay_ms;  ///< Round trip time of the last NTP query
+  uint16_t rtc_fallbacks; ///< Count of synchronizations with the RTC because NTP failed
+  uint8_t sync_source;    ///< telemetry_sync_source_e
+  uint8_t display;        ///< Combination of telemetry_display_e
+  uint8_t brightness;     ///< 0 to VFD_BRIGHTNESS_MAX
+} telemetry_app_state_t;
+
+/// Datagram as it is sent.  All members little endian.
+typedef struct __attribute__((packed))
+{
+  uint16_t magic;              ///< TELEMETRY_MAGIC
+  uint8_t version;             ///< TELEMETRY_VERSION
+  uint8_t sync_source;         ///< telemetry_sync_source_e
+  uint32_t chip_id;            ///< Identifies the clock
+  uint32_t seq;                ///< Sequence number since boot
+  uint32_t uptime_s;           ///< Seconds since boot
+  uint32_t utc;                ///< System time
+  uint32_t last_sync_utc;      ///< Time of the last NTP synchronization
+  int32_t rtc_offset_s;        ///< RTC minus NTP time at the last synchronization
+  int32_t drift_ppb;           ///< Estimated drift of the RTC
+  uint16_t ntp_delay_ms;       ///< Round trip time of the last NTP query
+  uint16_t rtc_fallbacks;      ///< Synchronizations with the RTC because NTP failed
+  uint16_t isr_max_us;         ///< Longest run of the display ISR in this interval
+  uint16_t isr_jitter_us;      ///< Largest jitter of the display ISR in this interval
+  uint32_t heap_free;          ///< Free heap
+  uint32_t heap_free_min;      ///< Least free heap
+  uint16_t block_max;          ///< Largest free heap block
+  uint16_t block_max_min;      ///< Least size of the largest free heap block
+  uint16_t stack_free_min;     ///< Least free stack of the loop() context
+  uint8_t fragmentation_max;   ///< Worst heap fragmentation in percent
+  uint8_t display;             ///< Combination of telemetry_display_e
+  uint8_t brightness;          ///< 0 to VFD_BRIGHTNESS_MAX
+  uint8_t reset_reason;        ///< Cause of the last reset, see postmortem.h
+  uint16_t boot_count;         ///< Boots since the last power on
+  // Version 2
+  uint16_t radio_wakes;        ///< Wake-ups of the radio in idle time, see radio_power.h
+  uint16_t radio_timeouts;     ///< Wake-ups without connection
+  uint16_t reconnect_ms_max;   ///< Worst time from wake-up to connection
+  uint16_t first_sync_ms_max;  ///< Worst time from wake-up to the first NTP sync
+  uint16_t late_syncs;         ///< First syncs done after the display was due
+} telemetry_packet_t;
+
+/// Size of the datagram.
+const size_t TELEMETRY_PACKET_SIZE = sizeof(telemetry_packet_t);
+
+/**
+ * \brief Sends a telemetry datagram.
+ * \param udp Socket to be used.
+ * \param collector Address of the collector.
+ * \param port UDP port of the collector.
+ * \param app State of the application.
+ * \return false if the datagram could not be sent.
+ *
+ * The ISR statistics start over with each datagram.
+ */
+bool telemetrySend(WiFiUDP &udp, IPAddress collector, uint16_t port, const telemetry_app_state_t *app);
+
+#endif // TELEMETRY_H
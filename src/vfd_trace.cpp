@@ -0,0 +1,91 @@
+#include "vfd_trace.h"
+
+#include "event_log.h"
+#include "multiplexing.h"
+
+/// Maximum length of an output line.
+static const size_t VFD_TRACE_LINE_LEN = 40U;
+
+// Local variables
+static bool _is_active;
+static event_log_mode_e _log_mode;
+static char _line[VFD_TRACE_LINE_LEN];
+static size_t _line_len;
+static size_t _line_pos;
+
+// Local function prototypes
+static size_t format_word(const vfd_trace_word_t &word, char *line, size_t size);
+
+void vfdTraceStart(uint32_t word_cnt)
+{
+  if (word_cnt == 0)
+  { // The words recorded so far are still put out.
+    startVfdTrace(0);
+    return;
+  }
+  if (!_is_active)
+  { // Event log lines would be mixed with the trace.
+    _log_mode = eventLogGetMode();
+    eventLogSetMode(EVENT_LOG_OFF);
+  }
+  _is_active = true;
+  _line_pos = 0;
+  _line_len = snprintf(_line, sizeof(_line), "\n#S %u %u %u %u\n", VFD_TRACE_VERSION, ESP.getCpuFreqMHz(),
+                       getVfdTubeType(), (unsigned)sizeof(vfd_trace_word_t));
+  startVfdTrace(word_cnt);
+}
+
+void vfdTracePoll(HardwareSerial &out)
+{
+  if (!_is_active)
+    return;
+  for (;;)
+  {
+    if (_line_pos == _line_len)
+    {
+      vfd_trace_word_t word;
+      if (!getVfdTraceWord(&word))
+      {
+        if (!isVfdTraceRunning())
+        { // Done, the event log takes over again.
+          _is_active = false;
+          eventLogSetMode(_log_mode);
+        }
+        return;
+      }
+      _line_pos = 0;
+      _line_len = format_word(word, _line, sizeof(_line));
+    }
+    // Never more than the FIFO takes without blocking
+    const int room = out.availableForWrite();
+    if (room <= 0)
+      return;
+    const size_t len = min((size_t)room, _line_len - _line_pos);
+    out.write((const uint8_t *)&_line[_line_pos], len);
+    _line_pos += len;
+  }
+}
+
+//********************************************************************
+// Local functions
+//********************************************************************
+
+static size_t format_word(const vfd_trace_word_t &word, char *line, size_t size)
+{
+  static const char HEX_DIGITS[] = "0123456789abcdef";
+  const uint8_t *bytes = (const uint8_t *)&word;
+  size_t len = 0;
+
+  if (size < 2 * sizeof(word) + 4)
+    return 0;
+  line[len++] = '#';
+  line[len++] = 'T';
+  for (size_t i = 0; i < sizeof(word); i++)
+  {
+    line[len++] = HEX_DIGITS[bytes[i] >> 4];
+    line[len++] = HEX_DIGITS[bytes[i] & 0x0F];
+  }
+  line[len++] = '\n';
+  line[len] = '\0';
+  return len;
+}
@@ -0,0 +1,41 @@
+/**
+  \file   vfd_trace.h
+  \brief  Capture of the words sent to the HV5812 for the timing analysis.
+
+  A change of the multiplexing or of the HV5812 timing used to be checked by
+  looking at the tubes for flicker or ghosting.  vfdTraceStart() lets the
+  background interrupt record the next words it latches into the HV5812, each
+  with the cycle count of its latch pulse (see startVfdTrace()).
+  vfdTracePoll() puts them out on the UART as lines "#T" followed by a
+  vfd_trace_word_t in hex, after a line "#S version cpu_mhz tube_type size".
+
+  tools/vfd_trace_analyze.py turns a capture of the terminal into a compact
+  binary trace file and computes the on-time of each tube and segment, the
+  jitter of the gate period, the blank time between the gates and any overlap
+  of the gates.  The results can be compared with a golden trace recorded
+  from a known good firmware, a regression makes the tool fail.
+
+  The event log output is suspended while the trace is put out.
+*/
+#ifndef VFD_TRACE_H
+#define VFD_TRACE_H
+
+#include <Arduino.h>
+#include <cstdint>
+
+/// Version of the trace output, to be checked by the analyzer.
+const unsigned VFD_TRACE_VERSION = 1U;
+
+/**
+ * \brief Starts a capture.
+ * \param word_cnt Count of words to be captured, 0 stops a running capture.
+ */
+void vfdTraceStart(uint32_t word_cnt);
+
+/**
+ * \brief Puts out the captured words as far as the UART has room.  To be called from loop().
+ * \param out UART to be used.
+ */
+void vfdTracePoll(HardwareSerial &out);
+
+#endif // VFD_TRACE_H
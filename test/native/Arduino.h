@@ -0,0 +1,150 @@
+/**
+ * \file   Arduino.h
+ * \brief  Stand-in of the Arduino core for the native unit tests.
+ *
+ * Only the parts used by the units under test are provided.  The state of the mocks is kept in functions
+ * with a static local, each test program is a single translation unit.
+ */
+#ifndef NATIVE_ARDUINO_H
+#define NATIVE_ARDUINO_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+using std::max;
+using std::min;
+
+#ifndef F_CPU
+#define F_CPU 80000000L
+#endif
+#define ICACHE_RAM_ATTR
+#define INPUT_PULLUP 0x02
+#define FALLING 0x02
+
+// Dividers of timer1
+#define TIM_DIV1 0
+#define TIM_DIV16 1
+#define TIM_DIV256 3
+#define TIM_EDGE 0
+#define TIM_SINGLE 0
+#define TIM_LOOP 1
+
+typedef void (*mock_isr_t)(void);
+
+/// State of the mocked io lines, of the system timer, of the cycle counter and of timer1
+struct mock_arduino_t
+{
+  uint8_t pin_mode[17];
+  mock_isr_t isr[17];
+  uint32_t millis;
+  uint64_t cycles;           ///< Cycle counter without wrap around
+  uint32_t cycles_per_read;  ///< The cycle counter advances by this on each read, the run time of the code
+  mock_isr_t timer1_isr;
+  uint32_t timer1_div;       ///< Cycles per tick
+  uint64_t timer1_due;       ///< Cycle count of the next interrupt
+  bool timer1_armed;
+};
+
+static inline mock_arduino_t &mockArduino()
+{
+  static mock_arduino_t state;
+  return state;
+}
+
+/// Reset reasons of rst_info
+enum rst_reason
+{
+  REASON_DEFAULT_RST = 0,
+  REASON_WDT_RST = 1,
+  REASON_EXCEPTION_RST = 2,
+  REASON_SOFT_WDT_RST = 3,
+  REASON_SOFT_RESTART = 4,
+  REASON_DEEP_SLEEP_AWAKE = 5,
+  REASON_EXT_SYS_RST = 6
+};
+
+/// Reset information passed from the ROM to the core, see user_interface.h
+struct rst_info
+{
+  uint32_t reason;
+  uint32_t exccause;
+  uint32_t epc1;
+  uint32_t epc2;
+  uint32_t epc3;
+  uint32_t excvaddr;
+  uint32_t depc;
+};
+
+/// Parts of the ESP class of the core.  The RTC user memory survives a reset simulated by the test.
+class EspClass
+{
+public:
+  uint32_t rtc_user_memory[128];
+  rst_info reset_info;
+
+  bool rtcUserMemoryRead(uint32_t offset, uint32_t *data, size_t size)
+  {
+    if (offset * 4U + size > sizeof(rtc_user_memory))
+      return false;
+    memcpy(data, reinterpret_cast<const uint8_t *>(rtc_user_memory) + offset * 4U, size);
+    return true;
+  }
+  bool rtcUserMemoryWrite(uint32_t offset, uint32_t *data, size_t size)
+  {
+    if (offset * 4U + size > sizeof(rtc_user_memory))
+      return false;
+    memcpy(reinterpret_cast<uint8_t *>(rtc_user_memory) + offset * 4U, data, size);
+    return true;
+  }
+  rst_info *getResetInfoPtr() { return &reset_info; }
+  uint32_t getCycleCount() { return (uint32_t)(mockArduino().cycles += mockArduino().cycles_per_read); }
+  uint8_t getCpuFreqMHz() { return F_CPU / 1000000L; }
+};
+
+/// To be defined by the tests using it, like the core does.
+extern EspClass ESP;
+
+/// UART keeping everything written, the FIFO always takes up to room bytes.
+class HardwareSerial
+{
+public:
+  std::string tx;
+  int room = 64;
+
+  int availableForWrite() { return room; }
+  size_t write(const uint8_t *data, size_t len)
+  {
+    tx.append(reinterpret_cast<const char *>(data), len);
+    return len;
+  }
+};
+
+static inline void pinMode(uint8_t pin, uint8_t mode) { mockArduino().pin_mode[pin] = mode; }
+static inline int digitalPinToInterrupt(uint8_t pin) { return pin; }
+static inline void attachInterrupt(int interrupt, mock_isr_t isr, int) { mockArduino().isr[interrupt] = isr; }
+static inline void detachInterrupt(int interrupt) { mockArduino().isr[interrupt] = nullptr; }
+static inline uint32_t millis() { return mockArduino().millis; }
+static inline void yield() {}
+static inline void *memcpy_P(void *dst, const void *src, size_t size) { return memcpy(dst, src, size); }
+
+// timer1 counts down from the value written and fires once, see core_esp8266_timer.cpp
+static inline void timer1_isr_init() {}
+static inline void timer1_attachInterrupt(mock_isr_t isr) { mockArduino().timer1_isr = isr; }
+static inline void timer1_detachInterrupt() { mockArduino().timer1_isr = nullptr; }
+static inline void timer1_enable(uint8_t divider, uint8_t, uint8_t)
+{
+  mockArduino().timer1_div = divider == TIM_DIV256 ? 256U : divider == TIM_DIV16 ? 16U : 1U;
+}
+static inline void timer1_disable() { mockArduino().timer1_armed = false; }
+static inline void timer1_write(uint32_t ticks)
+{
+  mock_arduino_t &mock = mockArduino();
+  mock.timer1_due = mock.cycles + (uint64_t)ticks * mock.timer1_div;
+  mock.timer1_armed = true;
+}
+
+#endif // NATIVE_ARDUINO_H
@@ -0,0 +1,31 @@
+/**
+ * \file   DS1307RTC.h
+ * \brief  Stand-in of the DS1307 library for the native unit tests.
+ *
+ * get() returns the preset time and calls a hook before, e.g. to inject an edge of the square wave while the
+ * RTC is being read.
+ */
+#ifndef NATIVE_DS1307RTC_H
+#define NATIVE_DS1307RTC_H
+
+#include <TimeLib.h>
+
+class DS1307RTC
+{
+public:
+  time_t utc;           ///< Returned by get(), 0 is the error value of the library
+  void (*on_get)(void); ///< Called by get() if set
+  unsigned gets;
+
+  time_t get()
+  {
+    gets++;
+    if (on_get)
+      on_get();
+    return utc;
+  }
+};
+
+static DS1307RTC RTC;
+
+#endif // NATIVE_DS1307RTC_H
@@ -0,0 +1,22 @@
+/**
+ * \file   ESP8266WiFi.h
+ * \brief  Stand-in of the WiFi library for the native unit tests.
+ */
+#ifndef NATIVE_ESP8266WIFI_H
+#define NATIVE_ESP8266WIFI_H
+
+#include <Arduino.h>
+
+/// IPv4 address, kept in network byte order like the core does
+class IPAddress
+{
+public:
+  IPAddress() : _address(0) {}
+  IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) : _address(a | b << 8 | c << 16 | (uint32_t)d << 24) {}
+  operator uint32_t() const { return _address; }
+
+private:
+  uint32_t _address;
+};
+
+#endif // NATIVE_ESP8266WIFI_H
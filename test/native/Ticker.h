@@ -0,0 +1,8 @@
+/**
+ * \file   Ticker.h
+ * \brief  Stand-in of the Ticker library for the native unit tests, the units under test only include it.
+ */
+#ifndef NATIVE_TICKER_H
+#define NATIVE_TICKER_H
+
+#endif // NATIVE_TICKER_H
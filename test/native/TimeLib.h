@@ -0,0 +1,10 @@
+/**
+ * \file   TimeLib.h
+ * \brief  Stand-in of the Time library for the native unit tests.
+ */
+#ifndef NATIVE_TIMELIB_H
+#define NATIVE_TIMELIB_H
+
+#include <ctime>
+
+#endif // NATIVE_TIMELIB_H
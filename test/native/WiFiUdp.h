@@ -0,0 +1,67 @@
+/**
+ * \file   WiFiUdp.h
+ * \brief  Stand-in of the UDP socket for the native unit tests.
+ *
+ * Holds one received datagram and the last one sent.
+ */
+#ifndef NATIVE_WIFIUDP_H
+#define NATIVE_WIFIUDP_H
+
+#include <ESP8266WiFi.h>
+
+class WiFiUDP
+{
+public:
+  uint16_t port;
+  uint8_t rx[64];
+  size_t rx_len;
+  IPAddress rx_ip;
+  uint16_t rx_port;
+  uint8_t tx[64];
+  size_t tx_len;
+  IPAddress tx_ip;
+  uint16_t tx_port;
+
+  WiFiUDP() : port(0), rx(), rx_len(0), rx_port(0), tx(), tx_len(0), tx_port(0) {}
+
+  uint8_t begin(uint16_t local_port)
+  {
+    port = local_port;
+    return 1;
+  }
+  /// Queues a datagram to be received.
+  void receive(const uint8_t *data, size_t len, IPAddress ip, uint16_t remote_port)
+  {
+    memcpy(rx, data, min(len, sizeof(rx)));
+    rx_len = min(len, sizeof(rx));
+    rx_ip = ip;
+    rx_port = remote_port;
+  }
+  int parsePacket() { return (int)rx_len; }
+  IPAddress remoteIP() const { return rx_ip; }
+  uint16_t remotePort() const { return rx_port; }
+  int read(uint8_t *buffer, size_t len)
+  {
+    const size_t count = min(len, rx_len);
+    memcpy(buffer, rx, count);
+    rx_len = 0;
+    return (int)count;
+  }
+  int beginPacket(IPAddress ip, uint16_t remote_port)
+  {
+    tx_ip = ip;
+    tx_port = remote_port;
+    tx_len = 0;
+    return 1;
+  }
+  size_t write(const uint8_t *buffer, size_t len)
+  {
+    const size_t count = min(len, sizeof(tx) - tx_len);
+    memcpy(tx + tx_len, buffer, count);
+    tx_len += count;
+    return count;
+  }
+  int endPacket() { return 1; }
+};
+
+#endif // NATIVE_WIFIUDP_H
@@ -0,0 +1,34 @@
+/**
+ * \file   Wire.h
+ * \brief  Stand-in of the I2C library for the native unit tests, records the bytes written.
+ */
+#ifndef NATIVE_WIRE_H
+#define NATIVE_WIRE_H
+
+#include <Arduino.h>
+
+class TwoWire
+{
+public:
+  uint8_t address;
+  uint8_t written[8];
+  size_t written_count;
+  uint8_t end_result; ///< 0 or the error code returned by endTransmission()
+
+  void beginTransmission(uint8_t slave)
+  {
+    address = slave;
+    written_count = 0;
+  }
+  size_t write(uint8_t data)
+  {
+    if (written_count < sizeof(written))
+      written[written_count++] = data;
+    return 1;
+  }
+  uint8_t endTransmission() { return end_result; }
+};
+
+static TwoWire Wire;
+
+#endif // NATIVE_WIRE_H
@@ -0,0 +1,161 @@
+/**
+ * \file   test_ntp.cpp
+ * \brief  Native unit test of the NTP request, the reply of the server and its decoding by the client.
+ *
+ * Run by: pio test -e native -f test_ntp
+ */
+#include <unity.h>
+
+#include "../../src/ntp_server.cpp"
+
+static const uint32_t UTC_S = 1700000000UL;
+static const uint32_t NONCE_S = 0x12345678UL;
+static const uint32_t NONCE_FRAC = 0x9ABCDEF0UL;
+static const IPAddress CLIENT_IP(192, 168, 1, 23);
+static const uint16_t CLIENT_PORT = 4711U;
+
+static WiFiUDP _server_udp;
+static uint8_t _request[NTP_PACKET_SIZE];
+
+// Upstream synchronization of the server at millis() 10000
+static void set_reference(uint16_t utc_ms)
+{
+  ntp_reference_t reference;
+  reference.utc_s = UTC_S;
+  reference.utc_ms = utc_ms;
+  reference.at_millis = 10000UL;
+  reference.stratum = 2;
+  reference.refid = 0x0A000001UL;
+  reference.root_delay = 0x100UL;
+  reference.root_dispersion = 0x200UL;
+  ntpServerSetReference(&reference);
+}
+
+// Passes the request to the server, returns its reply.
+static const uint8_t *serve(const uint8_t request[NTP_PACKET_SIZE])
+{
+  _server_udp.tx_len = 0;
+  _server_udp.receive(request, NTP_PACKET_SIZE, CLIENT_IP, CLIENT_PORT);
+  ntpServerPoll();
+  return _server_udp.tx_len == NTP_PACKET_SIZE ? _server_udp.tx : nullptr;
+}
+
+void setUp(void)
+{
+  mockArduino().millis = 10000UL;
+  _server_udp = WiFiUDP();
+  _reference_is_valid = false;
+  ntpServerBegin(_server_udp);
+  ntpBuildRequest(_request, NONCE_S, NONCE_FRAC);
+}
+
+void tearDown(void)
+{
+}
+
+static void test_request_carries_the_nonce(void)
+{
+  TEST_ASSERT_EQUAL_HEX8(0xE3, _request[0]); // alarm, version 4, client
+  TEST_ASSERT_EQUAL(0, _request[1]);
+  TEST_ASSERT_EQUAL(CLIENT_POLL, _request[2]);
+  TEST_ASSERT_EQUAL_HEX32(NONCE_S, get_u32(&_request[OFFSET_TRANSMIT_TS]));
+  TEST_ASSERT_EQUAL_HEX32(NONCE_FRAC, get_u32(&_request[OFFSET_TRANSMIT_TS + 4U]));
+  for (size_t i = OFFSET_REFERENCE_TS; i < OFFSET_TRANSMIT_TS; i++)
+    TEST_ASSERT_EQUAL(0, _request[i]);
+}
+
+static void test_server_answers_a_request(void)
+{
+  set_reference(250);
+  mockArduino().millis = 10500UL;
+  const uint32_t served = ntpServerServed();
+  const uint8_t *reply = serve(_request);
+  TEST_ASSERT_NOT_NULL(reply);
+  TEST_ASSERT_EQUAL(CLIENT_IP, _server_udp.tx_ip);
+  TEST_ASSERT_EQUAL(CLIENT_PORT, _server_udp.tx_port);
+  TEST_ASSERT_EQUAL_HEX8((VERSION << 3) | MODE_SERVER, reply[0]);
+  TEST_ASSERT_EQUAL(3, reply[1]);
+  TEST_ASSERT_EQUAL_MEMORY(&_request[OFFSET_TRANSMIT_TS], &reply[OFFSET_ORIGINATE_TS], 8U);
+  TEST_ASSERT_EQUAL_HEX32(UTC_S + SECONDS_1900_TO_1970, get_u32(&reply[OFFSET_REFERENCE_TS]));
+  TEST_ASSERT_EQUAL_HEX32(UTC_S + SECONDS_1900_TO_1970, get_u32(&reply[OFFSET_TRANSMIT_TS]));
+  TEST_ASSERT_EQUAL_HEX32(0xC0000000UL, get_u32(&reply[OFFSET_TRANSMIT_TS + 4U])); // 750 ms
+  TEST_ASSERT_EQUAL(served + 1U, ntpServerServed());
+}
+
+static void test_client_decodes_the_reply(void)
+{
+  set_reference(250);
+  mockArduino().millis = 10500UL;
+  uint8_t reply[NTP_PACKET_SIZE];
+  memcpy(reply, serve(_request), sizeof(reply));
+  ntp_reference_t reference;
+  TEST_ASSERT_TRUE(ntpDecodeReply(reply, _request, 777UL, 20UL, &reference));
+  TEST_ASSERT_EQUAL(UTC_S, reference.utc_s);
+  TEST_ASSERT_EQUAL(760, reference.utc_ms); // half of the round trip added
+  TEST_ASSERT_EQUAL(777, reference.at_millis);
+  TEST_ASSERT_EQUAL(3, reference.stratum);
+  TEST_ASSERT_EQUAL(0x100UL + 20UL * 65536UL / 1000UL, reference.root_delay);
+  TEST_ASSERT_EQUAL(0x200UL, reference.root_dispersion);
+}
+
+static void test_client_carries_into_the_next_second(void)
+{
+  set_reference(990);
+  uint8_t reply[NTP_PACKET_SIZE];
+  memcpy(reply, serve(_request), sizeof(reply));
+  ntp_reference_t reference;
+  TEST_ASSERT_TRUE(ntpDecodeReply(reply, _request, 0UL, 40UL, &reference));
+  TEST_ASSERT_EQUAL(UTC_S + 1U, reference.utc_s);
+  TEST_ASSERT_INT_WITHIN(1, 10, reference.utc_ms); // the fraction is truncated
+}
+
+static void test_client_rejects_a_reply_to_another_request(void)
+{
+  set_reference(250);
+  uint8_t reply[NTP_PACKET_SIZE];
+  memcpy(reply, serve(_request), sizeof(reply));
+  uint8_t next_request[NTP_PACKET_SIZE];
+  ntpBuildRequest(next_request, NONCE_S, NONCE_FRAC + 1U);
+  ntp_reference_t reference;
+  TEST_ASSERT_FALSE(ntpDecodeReply(reply, next_request, 0UL, 20UL, &reference));
+  memset(&reply[OFFSET_ORIGINATE_TS], 0, 8U); // a reply not answering any request
+  TEST_ASSERT_FALSE(ntpDecodeReply(reply, _request, 0UL, 20UL, &reference));
+}
+
+static void test_unsynchronized_server_is_rejected(void)
+{
+  const uint8_t *reply = serve(_request); // no reference yet
+  TEST_ASSERT_NOT_NULL(reply);
+  TEST_ASSERT_EQUAL(LI_ALARM, reply[0] >> 6);
+  TEST_ASSERT_EQUAL(NTP_STRATUM_UNSYNC, reply[1]);
+  ntp_reference_t reference;
+  TEST_ASSERT_FALSE(ntpDecodeReply(reply, _request, 0UL, 20UL, &reference));
+  set_reference(0);
+  mockArduino().millis = 10000UL + NTP_SERVER_MAX_AGE_S * 1000UL;
+  reply = serve(_request);
+  TEST_ASSERT_EQUAL(NTP_STRATUM_UNSYNC, reply[1]);
+}
+
+static void test_server_ignores_other_modes(void)
+{
+  set_reference(0);
+  uint8_t packet[NTP_PACKET_SIZE];
+  memcpy(packet, _request, sizeof(packet));
+  packet[0] = (VERSION << 3) | MODE_SERVER;
+  const uint32_t served = ntpServerServed();
+  TEST_ASSERT_NULL(serve(packet));
+  TEST_ASSERT_EQUAL(served, ntpServerServed());
+}
+
+int main(int, char **)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_request_carries_the_nonce);
+  RUN_TEST(test_server_answers_a_request);
+  RUN_TEST(test_client_decodes_the_reply);
+  RUN_TEST(test_client_carries_into_the_next_second);
+  RUN_TEST(test_client_rejects_a_reply_to_another_request);
+  RUN_TEST(test_unsynchronized_server_is_rejected);
+  RUN_TEST(test_server_ignores_other_modes);
+  return UNITY_END();
+}
@@ -0,0 +1,146 @@
+/**
+ * \file   test_postmortem.cpp
+ * \brief  Native unit test of the post-mortem, the RTC user memory is kept by the ESP stand-in.
+ *
+ * Run by: pio test -e native -f test_postmortem
+ */
+#include <unity.h>
+
+#include "../../src/postmortem.cpp"
+
+EspClass ESP;
+
+// Layout of the record, see postmortem.cpp
+static const unsigned MAGIC_BLOCK = 32U;
+static const unsigned HEAD_BLOCK = 35U;
+
+// Power on: The RTC user memory holds random data.
+static void power_on()
+{
+  for (unsigned i = 0; i < 128U; i++)
+    ESP.rtc_user_memory[i] = 0x5A5A5A5AUL * (i + 1U);
+  ESP.reset_info = rst_info();
+  ESP.reset_info.reason = REASON_DEFAULT_RST;
+}
+
+// Reset keeping the RTC user memory, the RAM copy is reloaded by postmortemBegin().
+static void reset(uint32_t reason)
+{
+  memset(&_record, 0xA5, sizeof(_record));
+  ESP.reset_info = rst_info();
+  ESP.reset_info.reason = reason;
+  mockArduino().millis = 0;
+}
+
+void setUp(void)
+{
+  power_on();
+}
+
+void tearDown(void)
+{
+}
+
+static void test_power_on_starts_a_new_record(void)
+{
+  TEST_ASSERT_FALSE(postmortemBegin());
+  TEST_ASSERT_EQUAL_HEX32(RECORD_MAGIC, ESP.rtc_user_memory[MAGIC_BLOCK]);
+  TEST_ASSERT_EQUAL(1, postmortemInfo()->boot_count);
+  TEST_ASSERT_EQUAL(0, postmortemInfo()->crash_uptime_ms);
+  postmortem_event_t event;
+  TEST_ASSERT_FALSE(postmortemGetEvent(0, &event));
+}
+
+static void test_rejects_another_version(void)
+{
+  postmortemBegin();
+  ESP.rtc_user_memory[MAGIC_BLOCK + 1U] = RECORD_VERSION + 1U;
+  reset(REASON_SOFT_RESTART);
+  TEST_ASSERT_FALSE(postmortemBegin());
+  TEST_ASSERT_EQUAL(1, postmortemInfo()->boot_count);
+}
+
+static void test_events_survive_a_reset(void)
+{
+  postmortemBegin();
+  mockArduino().millis = 1234;
+  postmortemEvent(7, -42);
+  postmortemUpdate(85, 30000);
+  postmortemUpdate(60, 31000); // no new high-water mark
+  reset(REASON_SOFT_RESTART);
+  TEST_ASSERT_TRUE(postmortemBegin());
+  const postmortem_info_t *info = postmortemInfo();
+  TEST_ASSERT_EQUAL(2, info->boot_count);
+  TEST_ASSERT_EQUAL(REASON_SOFT_RESTART, info->reset_reason);
+  TEST_ASSERT_EQUAL(85, info->isr_max_us);
+  TEST_ASSERT_EQUAL(30000, info->heap_min);
+  postmortem_event_t event;
+  TEST_ASSERT_TRUE(postmortemGetEvent(0, &event));
+  TEST_ASSERT_EQUAL(1234, event.uptime_ms);
+  TEST_ASSERT_EQUAL(1, event.boot);
+  TEST_ASSERT_EQUAL(7, event.id);
+  TEST_ASSERT_EQUAL(-42, event.arg);
+}
+
+static void test_ring_wraps_and_keeps_the_newest(void)
+{
+  postmortemBegin();
+  const unsigned count = POSTMORTEM_EVENT_CNT + 5U;
+  for (unsigned i = 0; i < count; i++)
+    postmortemEvent(1, (int32_t)i);
+  reset(REASON_SOFT_RESTART);
+  postmortemBegin();
+  TEST_ASSERT_EQUAL(count, ESP.rtc_user_memory[HEAD_BLOCK]);
+  postmortem_event_t event;
+  for (unsigned age = 0; age < POSTMORTEM_EVENT_CNT; age++)
+  {
+    TEST_ASSERT_TRUE(postmortemGetEvent(age, &event));
+    TEST_ASSERT_EQUAL(count - 1U - age, event.arg);
+  }
+  TEST_ASSERT_FALSE(postmortemGetEvent(POSTMORTEM_EVENT_CNT, &event));
+}
+
+static void test_crash_callback_records_the_uptime(void)
+{
+  postmortemBegin();
+  mockArduino().millis = 987654;
+  custom_crash_callback(&ESP.reset_info, 0, 0);
+  reset(REASON_EXCEPTION_RST);
+  ESP.reset_info.exccause = 28;
+  ESP.reset_info.epc1 = 0x40201234UL;
+  ESP.reset_info.excvaddr = 0x10;
+  postmortemBegin();
+  const postmortem_info_t *info = postmortemInfo();
+  TEST_ASSERT_EQUAL(REASON_EXCEPTION_RST, info->reset_reason);
+  TEST_ASSERT_EQUAL(987654, info->crash_uptime_ms);
+  TEST_ASSERT_EQUAL(28, info->exccause);
+  TEST_ASSERT_EQUAL_HEX32(0x40201234UL, info->epc1);
+  TEST_ASSERT_EQUAL(0x10, info->excvaddr);
+  reset(REASON_SOFT_RESTART); // the crash belongs to the previous run only
+  postmortemBegin();
+  TEST_ASSERT_EQUAL(0, postmortemInfo()->crash_uptime_ms);
+}
+
+static void test_clear_erases_events_and_boots(void)
+{
+  postmortemBegin();
+  postmortemEvent(3, 1);
+  postmortemClear();
+  reset(REASON_SOFT_RESTART);
+  TEST_ASSERT_TRUE(postmortemBegin());
+  TEST_ASSERT_EQUAL(1, postmortemInfo()->boot_count);
+  postmortem_event_t event;
+  TEST_ASSERT_FALSE(postmortemGetEvent(0, &event));
+}
+
+int main(int, char **)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_power_on_starts_a_new_record);
+  RUN_TEST(test_rejects_another_version);
+  RUN_TEST(test_events_survive_a_reset);
+  RUN_TEST(test_ring_wraps_and_keeps_the_newest);
+  RUN_TEST(test_crash_callback_records_the_uptime);
+  RUN_TEST(test_clear_erases_events_and_boots);
+  return UNITY_END();
+}
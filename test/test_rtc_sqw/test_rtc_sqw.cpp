@@ -0,0 +1,158 @@
+/**
+ * \file   test_rtc_sqw.cpp
+ * \brief  Native unit test of the RTC square wave tick, the DS1307 and the edges are mocked.
+ *
+ * Run by: pio test -e native -f test_rtc_sqw
+ */
+#include <unity.h>
+
+#include "../../src/rtc_sqw.cpp"
+
+static const uint8_t SQW_PIN = 0;
+static const time_t RTC_UTC = 1700000000;
+
+static unsigned _frames_committed;
+
+void commitVfdFrame()
+{
+  _frames_committed++;
+}
+
+static void edge()
+{
+  mockArduino().isr[SQW_PIN]();
+}
+
+void setUp(void)
+{
+  mockArduino() = mock_arduino_t();
+  Wire = TwoWire();
+  RTC = DS1307RTC();
+  RTC.utc = RTC_UTC;
+  _frames_committed = 0;
+  rtcSqwEnd();
+}
+
+void tearDown(void)
+{
+}
+
+static void test_begin_enables_the_square_wave(void)
+{
+  TEST_ASSERT_TRUE(rtcSqwBegin(SQW_PIN));
+  TEST_ASSERT_EQUAL_HEX8(0x68, Wire.address);
+  TEST_ASSERT_EQUAL(2, Wire.written_count);
+  TEST_ASSERT_EQUAL_HEX8(0x07, Wire.written[0]);
+  TEST_ASSERT_EQUAL_HEX8(0x10, Wire.written[1]);
+  TEST_ASSERT_EQUAL(INPUT_PULLUP, mockArduino().pin_mode[SQW_PIN]);
+  TEST_ASSERT_NOT_NULL(mockArduino().isr[SQW_PIN]);
+  TEST_ASSERT_FALSE(rtcSqwIsLocked());
+}
+
+static void test_begin_fails_without_rtc(void)
+{
+  Wire.end_result = 2; // address not acknowledged
+  TEST_ASSERT_FALSE(rtcSqwBegin(SQW_PIN));
+  TEST_ASSERT_NULL(mockArduino().isr[SQW_PIN]);
+}
+
+static void test_locks_after_the_first_edge(void)
+{
+  rtcSqwBegin(SQW_PIN);
+  rtcSqwPoll();
+  TEST_ASSERT_EQUAL(0, RTC.gets); // the RTC is read right after an edge only
+  TEST_ASSERT_FALSE(rtcSqwIsLocked());
+  edge();
+  rtcSqwPoll();
+  TEST_ASSERT_TRUE(rtcSqwIsLocked());
+  TEST_ASSERT_EQUAL(RTC_UTC, rtcSqwNow());
+  TEST_ASSERT_EQUAL(1, _frames_committed);
+}
+
+static void test_counts_the_seconds_by_the_edges(void)
+{
+  rtcSqwBegin(SQW_PIN);
+  edge();
+  rtcSqwPoll();
+  const uint32_t ticks = rtcSqwTicks();
+  RTC.utc = 0; // not read any more once locked
+  for (int i = 0; i < 3600; i++)
+    edge();
+  rtcSqwPoll();
+  TEST_ASSERT_EQUAL(1, RTC.gets);
+  TEST_ASSERT_EQUAL(RTC_UTC + 3600, rtcSqwNow());
+  TEST_ASSERT_EQUAL(ticks + 3600, rtcSqwTicks());
+}
+
+static void test_retries_if_an_edge_comes_during_the_read(void)
+{
+  rtcSqwBegin(SQW_PIN);
+  edge();
+  RTC.on_get = edge; // the second has changed while the RTC was read
+  rtcSqwPoll();
+  TEST_ASSERT_FALSE(rtcSqwIsLocked());
+  RTC.on_get = nullptr;
+  RTC.utc = RTC_UTC + 1;
+  rtcSqwPoll();
+  TEST_ASSERT_TRUE(rtcSqwIsLocked());
+  TEST_ASSERT_EQUAL(RTC_UTC + 1, rtcSqwNow());
+  edge();
+  TEST_ASSERT_EQUAL(RTC_UTC + 2, rtcSqwNow());
+}
+
+static void test_retries_if_the_read_fails(void)
+{
+  rtcSqwBegin(SQW_PIN);
+  edge();
+  RTC.utc = 0;
+  rtcSqwPoll();
+  TEST_ASSERT_FALSE(rtcSqwIsLocked());
+  RTC.utc = RTC_UTC;
+  rtcSqwPoll();
+  TEST_ASSERT_TRUE(rtcSqwIsLocked());
+}
+
+static void test_resync_takes_the_new_rtc_time(void)
+{
+  rtcSqwBegin(SQW_PIN);
+  edge();
+  rtcSqwPoll();
+  edge();
+  RTC.utc = RTC_UTC + 100; // e.g. set by the NTP sync
+  rtcSqwResync();
+  rtcSqwPoll();
+  TEST_ASSERT_EQUAL(RTC_UTC + 1, rtcSqwNow()); // keeps the old anchor until the next edge
+  edge();
+  rtcSqwPoll();
+  TEST_ASSERT_EQUAL(RTC_UTC + 100, rtcSqwNow());
+}
+
+static void test_end_releases_the_strapping_pin(void)
+{
+  rtcSqwBegin(SQW_PIN);
+  edge();
+  rtcSqwPoll();
+  TEST_ASSERT_TRUE(rtcSqwEnd());
+  TEST_ASSERT_EQUAL(2, Wire.written_count);
+  TEST_ASSERT_EQUAL_HEX8(0x07, Wire.written[0]);
+  TEST_ASSERT_EQUAL_HEX8(0x80, Wire.written[1]);
+  TEST_ASSERT_NULL(mockArduino().isr[SQW_PIN]);
+  TEST_ASSERT_FALSE(rtcSqwIsLocked());
+  Wire.written_count = 0;
+  TEST_ASSERT_TRUE(rtcSqwEnd()); // nothing left to do
+  TEST_ASSERT_EQUAL(0, Wire.written_count);
+}
+
+int main(int, char **)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_begin_enables_the_square_wave);
+  RUN_TEST(test_begin_fails_without_rtc);
+  RUN_TEST(test_locks_after_the_first_edge);
+  RUN_TEST(test_counts_the_seconds_by_the_edges);
+  RUN_TEST(test_retries_if_an_edge_comes_during_the_read);
+  RUN_TEST(test_retries_if_the_read_fails);
+  RUN_TEST(test_resync_takes_the_new_rtc_time);
+  RUN_TEST(test_end_releases_the_strapping_pin);
+  return UNITY_END();
+}
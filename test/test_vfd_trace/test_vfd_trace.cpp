@@ -0,0 +1,177 @@
+/**
+ * \file   test_vfd_trace.cpp
+ * \brief  Native unit test of the display interrupt, checked by the trace analyzer against golden values.
+ *
+ * The interrupt of src/multiplexing.cpp runs on timer1 and a cycle counter of the mock.  The trace of 600
+ * words is put out by src/vfd_trace.cpp like on the clock and written to TRACE_CAPTURE_PATH.  Then
+ * tools/vfd_trace_analyze.py compares it with test/vfd_trace/golden.json, so a change of the multiplexing
+ * timing fails this test.  After an intended change the golden values are recorded again:
+ *     cp .pio/vfd_trace_capture.txt test/vfd_trace/capture.txt
+ *     tools/vfd_trace_analyze.py test/vfd_trace/capture.txt --save-golden test/vfd_trace/golden.json
+ *
+ * Run by: pio test -e native -f test_vfd_trace (from the project directory, it needs python3)
+ */
+#include <unity.h>
+
+#include <cstdlib>
+
+#include "../../src/multiplexing.cpp"
+#include "../../src/vfd_trace.cpp"
+
+#ifndef TRACE_PYTHON
+#define TRACE_PYTHON "python3"
+#endif
+
+static const char TRACE_CAPTURE_PATH[] = ".pio/vfd_trace_capture.txt";
+static const char TRACE_ANALYZER[] = "tools/vfd_trace_analyze.py";
+static const char TRACE_GOLDEN_PATH[] = "test/vfd_trace/golden.json";
+static const uint32_t TRACE_WORD_CNT = 600U;
+static const uint8_t TRACE_BRIGHTNESS = 5U;
+static const uint8_t WARM_UP_SLOTS = 12U;
+static const uint32_t CYCLES_PER_READ = 12U;   // Run time between two reads of the cycle counter
+static const uint32_t LATENCY_MIN_CYCLES = 80U; // 1 to 4 us from the timer to the interrupt
+static const uint32_t LATENCY_SPREAD_CYCLES = 240U;
+static const uint32_t GATE_MASK = (1UL << 16) | (1UL << 17) | (1UL << 18);
+
+EspClass ESP;
+static HardwareSerial _serial;
+static vfd_trace_word_t _words[TRACE_WORD_CNT];
+static uint32_t _word_cnt;
+static bool _is_capture_written;
+static uint32_t _latency_seed = 42U;
+static event_log_mode_e _event_log_mode = EVENT_LOG_OFF;
+
+void eventLogSetMode(event_log_mode_e mode)
+{
+  _event_log_mode = mode;
+}
+
+event_log_mode_e eventLogGetMode()
+{
+  return _event_log_mode;
+}
+
+extern "C" void HV5812_vfdDriver(long)
+{
+}
+
+// Runs the interrupt when timer1 is due, the latency is taken from a fixed pseudo random sequence.
+static void run_slot()
+{
+  mock_arduino_t &mock = mockArduino();
+  _latency_seed = _latency_seed * 1103515245UL + 12345UL;
+  mock.cycles = mock.timer1_due + LATENCY_MIN_CYCLES + ((_latency_seed >> 16) % LATENCY_SPREAD_CYCLES);
+  mock.timer1_isr();
+}
+
+// Records the trace once, all tests look at the same one.
+static void record_trace()
+{
+  static const uint8_t DIGITS[VFD_TUBE_CNT] = {8, 5, 3, 2, 1, 0};
+  mock_arduino_t &mock = mockArduino();
+
+  mock.cycles = 1000000UL;
+  mock.cycles_per_read = CYCLES_PER_READ;
+  setVfdBrightness(TRACE_BRIGHTNESS);
+  updateVfd(DIGITS, 0);
+  for (uint8_t i = 0; i < WARM_UP_SLOTS; i++)
+    run_slot();
+  vfdTraceStart(TRACE_WORD_CNT);
+  while (isVfdTraceRunning())
+  {
+    run_slot();
+    vfdTracePoll(_serial);
+  }
+  vfdTracePoll(_serial);
+
+  FILE *capture = fopen(TRACE_CAPTURE_PATH, "w");
+  if (capture != nullptr)
+  {
+    _is_capture_written = fputs(_serial.tx.c_str(), capture) >= 0;
+    _is_capture_written = fclose(capture) == 0 && _is_capture_written;
+  }
+  for (size_t pos = _serial.tx.find("#T"); pos != std::string::npos && _word_cnt < TRACE_WORD_CNT;
+       pos = _serial.tx.find("#T", pos + 2))
+  {
+    uint8_t *bytes = reinterpret_cast<uint8_t *>(&_words[_word_cnt++]);
+    for (size_t i = 0; i < sizeof(vfd_trace_word_t); i++)
+      bytes[i] = strtoul(_serial.tx.substr(pos + 2 + 2 * i, 2).c_str(), nullptr, 16);
+  }
+}
+
+void setUp(void)
+{
+  static bool is_recorded;
+  if (!is_recorded)
+    record_trace();
+  is_recorded = true;
+}
+
+void tearDown(void)
+{
+}
+
+static void test_trace_holds_all_words(void)
+{
+  TEST_ASSERT_EQUAL(0U, _serial.tx.find("\n#S 1 80 1 8\n"));
+  TEST_ASSERT_EQUAL(TRACE_WORD_CNT, _word_cnt);
+  for (uint32_t i = 1; i < _word_cnt; i++)
+    TEST_ASSERT_EQUAL((_words[0].word >> VFD_TRACE_SEQ_SHIFT) + i, _words[i].word >> VFD_TRACE_SEQ_SHIFT);
+  TEST_ASSERT_FALSE(isVfdTraceRunning());
+  TEST_ASSERT_EQUAL(EVENT_LOG_OFF, _event_log_mode);
+}
+
+// Index of the gate driven by a word, -1 if it is none or more than one.
+static int gate_of(uint32_t word)
+{
+  for (uint8_t gate = 0; gate < 3; gate++)
+  {
+    if ((word & GATE_MASK) == (1UL << GATE[gate]))
+      return gate;
+  }
+  return -1;
+}
+
+static void test_gates_rotate_with_blank_words(void)
+{
+  // Dimmed slots put out the digits of one gate followed by a blank word.
+  const int first_gate = gate_of(_words[0].word);
+  TEST_ASSERT_TRUE(first_gate >= 0);
+  for (uint32_t i = 0; i < _word_cnt; i++)
+  {
+    const uint32_t word = _words[i].word & VFD_TRACE_WORD_MASK;
+    if (i % 2 == 1)
+      TEST_ASSERT_EQUAL_HEX32(0, word);
+    else
+      TEST_ASSERT_EQUAL((first_gate + i / 2) % 3, gate_of(word));
+  }
+}
+
+static void test_on_time_follows_the_brightness(void)
+{
+  // The blank word is late by the latency of its interrupt and the run time up to the output.
+  const uint32_t on_cycles = SLOT_CYCLES * TRACE_BRIGHTNESS / VFD_BRIGHTNESS_MAX;
+  const uint32_t late_max = LATENCY_MIN_CYCLES + LATENCY_SPREAD_CYCLES + 8U * CYCLES_PER_READ;
+  for (uint32_t i = 0; i + 1 < _word_cnt; i += 2)
+    TEST_ASSERT_UINT32_WITHIN(late_max, on_cycles + late_max / 2, _words[i + 1].ccount - _words[i].ccount);
+}
+
+static void test_trace_matches_golden(void)
+{
+  char command[160];
+  TEST_ASSERT_TRUE(_is_capture_written);
+  fflush(stdout); // the output of the analyzer follows the one of the test
+  snprintf(command, sizeof(command), "%s %s %s --golden %s", TRACE_PYTHON, TRACE_ANALYZER, TRACE_CAPTURE_PATH,
+           TRACE_GOLDEN_PATH);
+  TEST_ASSERT_EQUAL(0, system(command));
+}
+
+int main(int, char **)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_trace_holds_all_words);
+  RUN_TEST(test_gates_rotate_with_blank_words);
+  RUN_TEST(test_on_time_follows_the_brightness);
+  RUN_TEST(test_trace_matches_golden);
+  return UNITY_END();
+}
@@ -0,0 +1,128 @@
+#!/usr/bin/env python3
+"""Runs tools/vfd_trace_analyze.py against the trace and the golden values of this directory.
+
+capture.txt holds the output of 'trace 600' in the format of src/vfd_trace.cpp
+as written by the native test test/test_vfd_trace, golden.json the results of
+the analyzer for it.  That test compares the trace of the current interrupt
+with golden.json, this one checks that the analyzer detects regressions.  If
+the analyzer changes its figures, the golden values are recorded again:
+    tools/vfd_trace_analyze.py test/vfd_trace/capture.txt --save-golden test/vfd_trace/golden.json
+
+Run from the project directory:
+    python3 -m unittest discover -s test/vfd_trace
+"""
+import json
+import os
+import subprocess
+import sys
+import tempfile
+import unittest
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+ANALYZER = os.path.join(HERE, '..', '..', 'tools', 'vfd_trace_analyze.py')
+CAPTURE = os.path.join(HERE, 'capture.txt')
+GOLDEN = os.path.join(HERE, 'golden.json')
+GATE_MASK = 0x70000  # GATE_BITS of the analyzer
+
+
+def analyze(trace, *args):
+    """Returns exit status and output of the analyzer."""
+    run = subprocess.run([sys.executable, ANALYZER, trace] + list(args), stdout=subprocess.PIPE,
+                         stderr=subprocess.STDOUT, universal_newlines=True)
+    return run.returncode, run.stdout
+
+
+def read_words():
+    """Returns the lines of the capture, the words as (ccount, word | seq << 20)."""
+    with open(CAPTURE, encoding='utf-8') as source:
+        lines = source.read().splitlines()
+    words = []
+    for line in lines:
+        if line.startswith('#T'):
+            raw = bytes.fromhex(line[2:])
+            words.append((int.from_bytes(raw[:4], 'little'), int.from_bytes(raw[4:], 'little')))
+    return lines, words
+
+
+def format_word(ccount, raw):
+    return '#T' + ccount.to_bytes(4, 'little').hex() + raw.to_bytes(4, 'little').hex()
+
+
+class VfdTraceAnalyzeTest(unittest.TestCase):
+
+    def setUp(self):
+        self.directory = tempfile.TemporaryDirectory()
+
+    def tearDown(self):
+        self.directory.cleanup()
+
+    def path(self, name):
+        return os.path.join(self.directory.name, name)
+
+    def write_capture(self, words):
+        """Writes the header lines of the capture followed by the words given."""
+        lines, _ = read_words()
+        header = [line for line in lines if not line.startswith('#T')]
+        with open(self.path('capture.txt'), 'w', encoding='utf-8') as target:
+            target.write('\n'.join(header + [format_word(*word) for word in words]) + '\n')
+        return self.path('capture.txt')
+
+    def test_capture_matches_golden(self):
+        status, output = analyze(CAPTURE, '--golden', GOLDEN)
+        self.assertEqual(status, 0, output)
+        self.assertIn("matches golden values", output)
+
+    def test_results_equal_golden(self):
+        status, output = analyze(CAPTURE, '--json', self.path('result.json'))
+        self.assertEqual(status, 0, output)
+        with open(self.path('result.json'), encoding='utf-8') as source, \
+                open(GOLDEN, encoding='utf-8') as golden:
+            self.assertEqual(json.load(source), json.load(golden))
+
+    def test_trace_file_matches_golden(self):
+        status, output = analyze(CAPTURE, '--save', self.path('trace.vfdt'))
+        self.assertEqual(status, 0, output)
+        status, output = analyze(self.path('trace.vfdt'), '--golden', GOLDEN)
+        self.assertEqual(status, 0, output)
+
+    def test_missing_blank_time_is_a_regression(self):
+        _, words = read_words()
+        # The next gate is latched at the time of the blank word, the sequence stays without gaps.
+        changed = []
+        for index, (ccount, raw) in enumerate(words):
+            if raw & GATE_MASK or index + 1 == len(words):
+                changed.append((ccount, raw))
+            else:
+                changed.append((ccount, words[index + 1][1] & ~0xFFF00000 | raw & 0xFFF00000))
+        status, output = analyze(self.write_capture(changed), '--golden', GOLDEN)
+        self.assertEqual(status, 1, output)
+        self.assertIn("gate changes without blank time", output)
+
+    def test_overlapping_gates_are_a_regression(self):
+        _, words = read_words()
+        changed = list(words)
+        changed[10] = (words[10][0], words[10][1] | GATE_MASK)
+        status, output = analyze(self.write_capture(changed), '--golden', GOLDEN)
+        self.assertEqual(status, 1, output)
+        self.assertIn("gate overlaps", output)
+
+    def test_slower_refresh_is_a_regression(self):
+        _, words = read_words()
+        # 5 % more cycles between all words
+        first = words[0][0]
+        changed = [((first + ((ccount - first) & 0xFFFFFFFF) * 21 // 20) & 0xFFFFFFFF, raw)
+                   for ccount, raw in words]
+        status, output = analyze(self.write_capture(changed), '--golden', GOLDEN)
+        self.assertEqual(status, 1, output)
+        self.assertIn("period", output)
+
+    def test_dark_segment_is_a_regression(self):
+        _, words = read_words()
+        changed = [(ccount, raw & ~0x01) for ccount, raw in words]  # segment 0 of the tubes 3 to 5
+        status, output = analyze(self.write_capture(changed), '--golden', GOLDEN)
+        self.assertEqual(status, 1, output)
+        self.assertIn("segment 0", output)
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,192 @@
+#!/usr/bin/env python3
+"""Reports where the code and data reachable from the interrupt handlers live.
+
+While the SPI flash is erased or written (OTA update, configuration store, WiFi
+calibration data) its cache is off.  An interrupt handler touching anything in
+flash at that time crashes the clock.  This script walks the call graph of the
+interrupt handlers in the linked firmware: direct calls and every address loaded
+from a literal pool (calls through a register, tables, constants).  Each symbol
+found is listed with its section, anything residing in flash fails the check.
+
+Calls through a function pointer held in a variable cannot be followed, they
+are not used below the handlers of this firmware.
+
+platformio.ini runs it after each build (extra_scripts), the report is written
+to .pio/build/<env>/isr_sections.txt.  It can be run by hand as well:
+    tools/isr_sections.py .pio/build/esp01_1m/firmware.elf \\
+        --tool-prefix ~/.platformio/packages/toolchain-xtensa/bin/xtensa-lx106-elf-
+"""
+import argparse
+import bisect
+import re
+import subprocess
+import sys
+
+# Entry points of the interrupt handlers, matched against the demangled names
+ISR_ROOTS = ('vfd_refresh_callback', 'rtcSqwEdge')
+# Data read by the handlers through pointers which are set outside of them
+ISR_DATA = ('SEG_7_IV3A', 'SEG_7_IV12')
+# Symbols in flash which have been checked to be never used while the flash is busy
+ALLOWED_IN_FLASH = ()
+# Initialized data up to this size is searched for pointers, e.g. _seg_7
+POINTER_DATA_MAX = 16
+# Memory map of the ESP8266
+REGIONS = (
+    (0x3FFE8000, 0x40000000, 'dram', True),
+    (0x40000000, 0x40100000, 'rom', True),
+    (0x40100000, 0x40110000, 'iram', True),
+    (0x40200000, 0x40400000, 'flash', False),
+)
+CODE_TYPES = 'tTwW'
+CALL = re.compile(r'\s(?:call0|j)\s+([0-9a-f]+)\b')
+L32R = re.compile(r'\sl32r\s+a\d+,\s*([0-9a-f]+)\b')
+NM_LINE = re.compile(r'^([0-9a-f]+)(?: ([0-9a-f]+))? (\w) (.+)$')
+FLAGS_LINE = re.compile(r'^\s+[A-Z]+(?:, [A-Z_]+)*\s*$')  # flags following each section line
+SECTION_LINE = re.compile(r'^\s*\d+\s+(\S+)\s+([0-9a-f]+)\s+([0-9a-f]+)\s+[0-9a-f]+\s+([0-9a-f]+)')
+
+
+def region_of(address):
+    for start, end, name, resident in REGIONS:
+        if start <= address < end:
+            return name, resident
+    return None, True
+
+
+class Firmware:
+    """Symbols, sections and disassembly of the linked ELF file."""
+
+    def __init__(self, elf, tool_prefix):
+        self.elf = elf
+        self.tool_prefix = tool_prefix
+        with open(elf, 'rb') as source:
+            self.image = source.read()
+        self.sections = []  # (vma, size, file offset or None without contents, name)
+        for line in self.run('objdump', '-h', elf).splitlines():
+            match = SECTION_LINE.match(line)
+            if match:
+                name, size, vma, offset = match.groups()
+                self.sections.append((int(vma, 16), int(size, 16), int(offset, 16), name))
+            elif self.sections and FLAGS_LINE.match(line) and 'CONTENTS' not in line:
+                vma, size, _, name = self.sections[-1]
+                self.sections[-1] = (vma, size, None, name)
+        self.symbols = []  # (address, size, type, name) sorted by address
+        for line in self.run('nm', '-C', '-S', '-n', '--defined-only', elf).splitlines():
+            match = NM_LINE.match(line)
+            if match:
+                address, size, kind, name = match.groups()
+                self.symbols.append((int(address, 16), int(size or '0', 16), kind, name))
+        self.addresses = [symbol[0] for symbol in self.symbols]
+
+    def run(self, tool, *args):
+        return subprocess.run([self.tool_prefix + tool] + list(args), check=True, stdout=subprocess.PIPE,
+                              universal_newlines=True).stdout
+
+    def section_of(self, address):
+        for vma, size, _, name in self.sections:
+            if vma <= address < vma + size:
+                return name
+        return '?'
+
+    def symbol_at(self, address):
+        """Symbol covering the address or None.  Labels without a size only match exactly."""
+        index = bisect.bisect_right(self.addresses, address) - 1
+        for start, size, kind, name in reversed(self.symbols[max(index - 16, 0):index + 1]):
+            if start == address or start < address < start + size:
+                return start, size, kind, name
+        return None
+
+    def word_at(self, address):
+        for vma, size, offset, _ in self.sections:
+            if offset is not None and vma <= address and address + 4 <= vma + size:
+                position = offset + address - vma
+                return int.from_bytes(self.image[position:position + 4], 'little')
+        return None
+
+    def references(self, symbol):
+        """Addresses called or loaded from literals by a function, pointers held by small data."""
+        start, size, kind, _ = symbol
+        if kind not in CODE_TYPES:
+            words = (self.word_at(address) for address in range(start, start + size - 3, 4))
+            return set(word for word in words if word is not None and region_of(word)[0] is not None)
+        listing = self.run('objdump', '-d', '--no-show-raw-insn', '--start-address=0x%x' % start,
+                           '--stop-address=0x%x' % (start + size), self.elf)
+        found = set()
+        for line in listing.splitlines():
+            match = CALL.search(line)
+            if match:
+                found.add(int(match.group(1), 16))
+                continue
+            match = L32R.search(line)
+            if match:
+                value = self.word_at(int(match.group(1), 16))
+                if value is not None and region_of(value)[0] is not None:
+                    found.add(value)
+        return found
+
+
+def walk(firmware, roots):
+    """Returns the report lines and the count of symbols residing in flash."""
+    queue = [symbol for symbol in firmware.symbols
+             if symbol[3] in roots or symbol[3].split('(')[0] in roots]
+    if not queue:
+        return ["no interrupt handler found"], 1
+    seen = {}
+    while queue:
+        symbol = queue.pop()
+        if symbol[0] in seen:
+            continue
+        seen[symbol[0]] = symbol
+        is_code = symbol[2] in CODE_TYPES
+        if symbol[1] > 0 and (region_of(symbol[0])[0] in ('iram', 'flash') if is_code else
+                              firmware.word_at(symbol[0]) is not None and symbol[1] <= POINTER_DATA_MAX):
+            for address in firmware.references(symbol):
+                target = firmware.symbol_at(address)
+                if target is None:
+                    target = (address, 0, '?', '<0x%08x>' % address)
+                if target[0] not in seen:
+                    queue.append(target)
+    lines = []
+    misplaced = 0
+    for address in sorted(seen):
+        _, size, kind, name = seen[address]
+        region, resident = region_of(address)
+        resident = resident or name in ALLOWED_IN_FLASH
+        if not resident:
+            misplaced += 1
+        lines.append("%-5s 0x%08x %6u %s %-22s %-6s %s" % (
+            'ok' if resident else 'FLASH', address, size, kind, firmware.section_of(address), region, name))
+    return lines, misplaced
+
+
+def report(elf, tool_prefix, out_path=None):
+    """Writes the report and returns the count of symbols residing in flash."""
+    lines, misplaced = walk(Firmware(elf, tool_prefix), ISR_ROOTS + ISR_DATA)
+    text = "Symbols reachable from the interrupt handlers %s\n%s\n%u of %u in flash\n" % (
+        ', '.join(ISR_ROOTS), '\n'.join(lines), misplaced, len(lines))
+    if out_path:
+        with open(out_path, 'w', encoding='utf-8') as target:
+            target.write(text)
+    sys.stdout.write(text)
+    return misplaced
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('elf', help="linked firmware, e.g. .pio/build/esp01_1m/firmware.elf")
+    parser.add_argument('--tool-prefix', default='xtensa-lx106-elf-', help="prefix of objdump and nm")
+    parser.add_argument('--out', help="also write the report to this file")
+    args = parser.parse_args()
+    sys.exit(1 if report(args.elf, args.tool_prefix, args.out) else 0)
+
+
+def post_build(source, target, env):
+    """PlatformIO post action of the ELF file."""
+    tool_prefix = env.subst('$CC')[:-len('gcc')]
+    return 1 if report(str(target[0]), tool_prefix, env.subst('$BUILD_DIR/isr_sections.txt')) else 0
+
+
+if __name__ == '__main__':
+    main()
+else:
+    Import('env')  # noqa: F821, provided by PlatformIO
+    env.AddPostAction('$BUILD_DIR/${PROGNAME}.elf', post_build)  # noqa: F821
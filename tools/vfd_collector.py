@@ -0,0 +1,163 @@
+#!/usr/bin/env python3
+"""Collects the telemetry datagrams of the VFD clocks.
+
+The clocks send a datagram of fixed layout to the collector configured by
+'config set telemetry <ip> [<port> [<interval s>]]', see src/telemetry.h.
+This collector decodes the datagrams of all clocks, keeps the worst values per
+clock and prints a summary table.
+
+Examples:
+    tools/vfd_collector.py --port 4210
+    tools/vfd_collector.py --port 4210 --log telemetry.jsonl
+    tools/vfd_collector.py --fake 127.0.0.1:4210      # send a test datagram
+"""
+import argparse
+import json
+import socket
+import struct
+import sys
+import time
+
+MAGIC = 0x424E
+VERSION = 2
+# Layout of telemetry_packet_t, little endian and packed
+FIELDS_V1 = (
+    ('magic', 'H'), ('version', 'B'), ('sync_source', 'B'), ('chip_id', 'I'), ('seq', 'I'),
+    ('uptime_s', 'I'), ('utc', 'I'), ('last_sync_utc', 'I'), ('rtc_offset_s', 'i'), ('drift_ppb', 'i'),
+    ('ntp_delay_ms', 'H'), ('rtc_fallbacks', 'H'), ('isr_max_us', 'H'), ('isr_jitter_us', 'H'),
+    ('heap_free', 'I'), ('heap_free_min', 'I'), ('block_max', 'H'), ('block_max_min', 'H'),
+    ('stack_free_min', 'H'), ('fragmentation_max', 'B'), ('display', 'B'), ('brightness', 'B'),
+    ('reset_reason', 'B'), ('boot_count', 'H'),
+)
+FIELDS = FIELDS_V1 + (
+    ('radio_wakes', 'H'), ('radio_timeouts', 'H'), ('reconnect_ms_max', 'H'), ('first_sync_ms_max', 'H'),
+    ('late_syncs', 'H'),
+)
+PACKET_V1 = struct.Struct('<' + ''.join(code for _, code in FIELDS_V1))
+PACKET = struct.Struct('<' + ''.join(code for _, code in FIELDS))
+SYNC_SOURCES = ('none', 'ntp', 'rtc', 'warm', 'peer')
+DISPLAY_BITS = ((0x01, 'on'), (0x02, 'idle'), (0x04, 'stopwatch'), (0x08, 'sqw'))
+
+
+def decode(datagram):
+    """Returns the datagram as dict or None if it is no telemetry datagram.
+
+    Members unknown to a version 1 datagram are set to 0.
+    """
+    if len(datagram) < PACKET_V1.size:
+        return None
+    if len(datagram) >= PACKET.size:
+        packet = dict(zip((name for name, _ in FIELDS), PACKET.unpack_from(datagram)))
+    else:
+        packet = dict((name, 0) for name, _ in FIELDS)
+        packet.update(zip((name for name, _ in FIELDS_V1), PACKET_V1.unpack_from(datagram)))
+    if packet['magic'] != MAGIC or packet['version'] < 1:
+        return None
+    return packet
+
+
+class Clock:
+    """Aggregate of the datagrams of one clock."""
+
+    def __init__(self, address):
+        self.address = address
+        self.packets = 0
+        self.lost = 0
+        self.restarts = 0
+        self.isr_max_us = 0
+        self.isr_jitter_us = 0
+        self.ntp_delay_max_ms = 0
+        self.last = None
+
+    def update(self, packet):
+        if self.last is not None:
+            if packet['boot_count'] != self.last['boot_count'] or packet['seq'] < self.last['seq']:
+                self.restarts += 1
+            elif packet['seq'] == self.last['seq']:
+                return  # duplicate
+            else:
+                self.lost += packet['seq'] - self.last['seq'] - 1
+        self.packets += 1
+        self.isr_max_us = max(self.isr_max_us, packet['isr_max_us'])
+        self.isr_jitter_us = max(self.isr_jitter_us, packet['isr_jitter_us'])
+        self.ntp_delay_max_ms = max(self.ntp_delay_max_ms, packet['ntp_delay_ms'])
+        self.last = packet
+
+
+def display_state(bits):
+    return ','.join(name for bit, name in DISPLAY_BITS if bits & bit) or 'off'
+
+
+def print_table(clocks, out):
+    out.write("%-10s %-15s %6s %5s %4s %6s %7s %7s %6s %6s %5s %7s %4s %-5s %s\n" % (
+        'chip', 'address', 'uptime', 'pkts', 'lost', 'resets', 'isr us', 'jit us', 'ntp ms', 'heap',
+        'block', 'wake ms', 'late', 'sync', 'display'))
+    for chip_id, clock in sorted(clocks.items()):
+        last = clock.last
+        out.write("%-10u %-15s %6u %5u %4u %6u %7u %7u %6u %6u %5u %7u %4u %-5s %s\n" % (
+            chip_id, clock.address, last['uptime_s'] // 60, clock.packets, clock.lost, clock.restarts,
+            clock.isr_max_us, clock.isr_jitter_us, clock.ntp_delay_max_ms, last['heap_free_min'],
+            last['block_max_min'], last['first_sync_ms_max'], last['late_syncs'], SYNC_SOURCES[last['sync_source']] if last['sync_source'] < len(SYNC_SOURCES)
+            else '?', display_state(last['display'])))
+    out.flush()
+
+
+def collect(args):
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.bind((args.bind, args.port))
+    sock.settimeout(1.0)
+    log = open(args.log, 'a', encoding='utf-8') if args.log else None
+    clocks = {}
+    next_table = time.monotonic() + args.table
+    while True:
+        try:
+            datagram, (address, _) = sock.recvfrom(512)
+            packet = decode(datagram)
+            if packet is None:
+                print("ignored datagram of %u bytes from %s" % (len(datagram), address), file=sys.stderr)
+            else:
+                clocks.setdefault(packet['chip_id'], Clock(address)).update(packet)
+                if log:
+                    packet['address'] = address
+                    packet['received'] = time.time()
+                    log.write(json.dumps(packet) + '\n')
+                    log.flush()
+        except socket.timeout:
+            pass
+        if clocks and time.monotonic() >= next_table:
+            print_table(clocks, sys.stdout)
+            next_table = time.monotonic() + args.table
+
+
+def send_fake(target):
+    """Sends a datagram as a clock would, for testing the collector."""
+    host, port = target.rsplit(':', 1)
+    values = dict((name, 0) for name, _ in FIELDS)
+    values.update(magic=MAGIC, version=VERSION, sync_source=1, chip_id=4242, seq=int(time.time() * 10) % 100000,
+                  uptime_s=3600, utc=int(time.time()), last_sync_utc=int(time.time()) - 120, ntp_delay_ms=23,
+                  isr_max_us=41, isr_jitter_us=7, heap_free=40000, heap_free_min=38000, block_max=30000,
+                  block_max_min=28000, stack_free_min=2900, display=0x01, brightness=8, boot_count=1,
+                  radio_wakes=3, reconnect_ms_max=2400, first_sync_ms_max=2700)
+    datagram = PACKET.pack(*(values[name] for name, _ in FIELDS))
+    socket.socket(socket.AF_INET, socket.SOCK_DGRAM).sendto(datagram, (host, int(port)))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('--bind', default='0.0.0.0', help="local address to listen on")
+    parser.add_argument('--port', type=int, default=4210, help="UDP port to listen on")
+    parser.add_argument('--table', type=float, default=60.0, help="seconds between summary tables")
+    parser.add_argument('--log', help="append each datagram as JSON line to this file")
+    parser.add_argument('--fake', metavar='HOST:PORT', help="send a test datagram and exit")
+    args = parser.parse_args()
+    if args.fake:
+        send_fake(args.fake)
+        return
+    try:
+        collect(args)
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,80 @@
+#!/usr/bin/env python3
+"""Decodes the hex output of the VFD clock event log.
+
+The clock puts out its event log in hex after 'log hex' has been entered in the
+debug terminal.  Each record is a line "#E" followed by an event_record_t in
+hex, see src/event_log.h.  The format strings are read from EVENT_LOG_EVENTS in
+that header, so the decoder has to be run with the header of the firmware that
+produced the capture.  All other lines of the capture are passed through.
+
+Example:
+    pio device monitor | tee capture.txt
+    tools/vfd_logdecode.py capture.txt
+"""
+import argparse
+import os
+import re
+import struct
+import sys
+
+HEX_VERSION = 1
+RECORD = struct.Struct('<IHBB3i')  # ms, seq, id, argc, arg[3]
+CONVERSION = re.compile(r'%[-+ 0#]*\d*[diuxX]')
+DEFAULT_HEADER = os.path.join(os.path.dirname(__file__), '..', 'src', 'event_log.h')
+
+
+def read_formats(header):
+    """Returns the format strings of EVENT_LOG_EVENTS in ID order."""
+    with open(header, encoding='utf-8') as source:
+        text = source.read()
+    return [fmt for _, fmt in re.findall(r'X\((EV_\w+),\s*"((?:[^"\\]|\\.)*)"\)', text)]
+
+
+def decode(lines, formats, out):
+    expected_seq = None
+    for line in lines:
+        line = line.rstrip('\r\n')
+        if line.startswith('#H'):
+            version, event_cnt, record_size = (int(field) for field in line.split()[1:4])
+            if version != HEX_VERSION or record_size != RECORD.size:
+                sys.exit("unsupported log format %u, record size %u" % (version, record_size))
+            if event_cnt != len(formats):
+                print("warning: firmware knows %u events, header %u" % (event_cnt, len(formats)), file=sys.stderr)
+            expected_seq = None
+            continue
+        if not line.startswith('#E'):
+            if line:
+                out.write(line + '\n')
+            continue
+        try:
+            ms, seq, event_id, argc, *args = RECORD.unpack(bytes.fromhex(line[2:]))
+        except ValueError:
+            out.write("[ corrupt record ] %s\n" % line)
+            continue
+        if expected_seq is not None and seq != expected_seq:
+            out.write("[ %u records missing ]\n" % ((seq - expected_seq) & 0xFFFF))
+        expected_seq = (seq + 1) & 0xFFFF
+        if event_id < len(formats):
+            fmt = formats[event_id]
+            text = fmt % tuple(args[:len(CONVERSION.findall(fmt))])
+        else:
+            text = "unknown event %u %r" % (event_id, args[:argc])
+        out.write("[%6u.%03u] %s\n" % (ms // 1000, ms % 1000, text))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('capture', nargs='?', help="capture of the terminal (default: stdin)")
+    parser.add_argument('--header', default=DEFAULT_HEADER, help="event_log.h of the firmware")
+    args = parser.parse_args()
+
+    formats = read_formats(args.header)
+    if args.capture:
+        with open(args.capture, encoding='utf-8', errors='replace') as capture:
+            decode(capture, formats, sys.stdout)
+    else:
+        decode(sys.stdin, formats, sys.stdout)
+
+
+if __name__ == '__main__':
+    main()
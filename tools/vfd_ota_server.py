@@ -0,0 +1,64 @@
+#!/usr/bin/env python3
+"""Serves a firmware image for the network update of the VFD clock.
+
+The clock downloads the image after 'ota http://<this host>:<port>/firmware.bin'
+has been entered in its debug terminal.  The server sends the MD5 digest of the
+image in the header X-MD5, so the digest need not be typed in.  The options
+--corrupt and --stall help to check that a broken transfer leaves the running
+firmware untouched.
+
+Example:
+    pio run
+    tools/vfd_ota_server.py .pio/build/esp01_1m/firmware.bin --port 8266
+"""
+import argparse
+import hashlib
+import http.server
+import os
+import time
+
+
+def make_handler(image, args):
+    digest = hashlib.md5(image).hexdigest()
+
+    class Handler(http.server.BaseHTTPRequestHandler):
+        protocol_version = 'HTTP/1.0'
+
+        def do_GET(self):
+            if self.path != '/' + os.path.basename(args.image) and self.path != '/firmware.bin':
+                self.send_error(404)
+                return
+            body = bytearray(image)
+            if args.corrupt:
+                body[len(body) // 2] ^= 0xFF
+            self.send_response(200)
+            self.send_header('Content-Type', 'application/octet-stream')
+            self.send_header('Content-Length', str(len(body)))
+            self.send_header('X-MD5', digest)
+            self.end_headers()
+            for offset in range(0, len(body), 1024):
+                if args.stall and offset >= len(body) // 2:
+                    time.sleep(args.stall)
+                    return
+                self.wfile.write(body[offset:offset + 1024])
+
+    return Handler, digest
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('image', help="firmware image, e.g. .pio/build/esp01_1m/firmware.bin")
+    parser.add_argument('--port', type=int, default=8266, help="TCP port to listen on")
+    parser.add_argument('--corrupt', action='store_true', help="flip a byte, the clock has to refuse the image")
+    parser.add_argument('--stall', type=float, metavar='S', help="stop sending halfway for S seconds")
+    args = parser.parse_args()
+
+    with open(args.image, 'rb') as image_file:
+        image = image_file.read()
+    handler, digest = make_handler(image, args)
+    print("Serving %s (%u bytes, MD5 %s) on port %u" % (args.image, len(image), digest, args.port))
+    http.server.HTTPServer(('', args.port), handler).serve_forever()
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,83 @@
+#!/usr/bin/env python3
+"""Converts text into a flash resident VFD animation.
+
+The generated C++ source holds a frame table in PROGMEM and a vfd_animation_t
+descriptor as declared in src/multiplexing.h.  Each frame contains one glyph
+index per tube, element [0] being the rightmost tube.
+
+Example:
+    tools/vfd_text2frames.py --name VFD_ANIM_HELLO --period 200 "hello"
+"""
+import argparse
+import sys
+
+VFD_TUBE_CNT = 6
+VFD_BLANK = 16
+VFD_KEEP = 0xFF
+VFD_ANIM_FRAMES_MAX = 32  # see src/multiplexing.h
+
+# Glyph indices of SEG_7[] in src/multiplexing.cpp
+GLYPHS = {
+    '0': 0, '1': 1, '2': 2, '3': 3, '4': 4, '5': 5, '6': 6, '7': 7,
+    '8': 8, '9': 9, 'A': 10, 'B': 11, 'C': 12, 'D': 13, 'E': 14, 'F': 15,
+    ' ': VFD_BLANK, 'N': 19, 'I': 20, 'L': 23, 'S': 25, '-': 26, 'O': 27,
+    'R': 28, 'T': 29, 'U': 30, 'H': 31, '_': VFD_KEEP,
+}
+# Lower case letters are drawn by the same glyph if there is no dedicated one.
+ALIASES = {'g': '9', 'q': '9', 'z': '2', 'j': 'U', 'v': 'U', 'y': '4'}
+
+
+def glyph(char):
+    char = ALIASES.get(char, char).upper()
+    if char not in GLYPHS:
+        raise ValueError("no 7-segment glyph for character %r" % char)
+    return GLYPHS[char]
+
+
+def scroll_frames(text):
+    """Text enters at the right and leaves at the left."""
+    padded = [VFD_BLANK] * VFD_TUBE_CNT + [glyph(c) for c in text] + [VFD_BLANK] * VFD_TUBE_CNT
+    frames = []
+    for start in range(len(padded) - VFD_TUBE_CNT + 1):
+        window = padded[start:start + VFD_TUBE_CNT]
+        frames.append(list(reversed(window)))
+    return frames
+
+
+def static_frames(text):
+    """Text is right aligned and shown as a single frame."""
+    if len(text) > VFD_TUBE_CNT:
+        raise ValueError("static text is limited to %u characters" % VFD_TUBE_CNT)
+    return [list(reversed([glyph(c) for c in text.rjust(VFD_TUBE_CNT)]))]
+
+
+def emit(name, frames, period, loop, text, out):
+    out.write("// Generated by tools/vfd_text2frames.py from \"%s\"\n" % text)
+    out.write("static const uint8_t %s_FRAMES[][VFD_TUBE_CNT] PROGMEM = {\n" % name)
+    for frame in frames:
+        out.write("    {%s},\n" % ", ".join("%u" % g for g in frame))
+    out.write("};\n")
+    out.write("const vfd_animation_t %s = {%s_FRAMES, sizeof(%s_FRAMES) / sizeof(%s_FRAMES[0]), %u, %s};\n"
+              % (name, name, name, name, period, "VFD_ANIM_LOOP" if loop else "0"))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("text", help="text to be converted, '_' keeps the underlying digit")
+    parser.add_argument("--name", required=True, help="C identifier of the animation")
+    parser.add_argument("--period", type=int, default=200, help="frame period in milliseconds")
+    parser.add_argument("--static", action="store_true", help="single right aligned frame instead of scrolling")
+    parser.add_argument("--loop", action="store_true", help="restart the animation after its last frame")
+    args = parser.parse_args()
+
+    try:
+        frames = static_frames(args.text) if args.static else scroll_frames(args.text)
+        if len(frames) > VFD_ANIM_FRAMES_MAX:
+            raise ValueError("%u frames, the display plays %u at most" % (len(frames), VFD_ANIM_FRAMES_MAX))
+    except ValueError as err:
+        sys.exit("vfd_text2frames: %s" % err)
+    emit(args.name, frames, args.period, args.loop, args.text, sys.stdout)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,292 @@
+#!/usr/bin/env python3
+"""Analyzes a trace of the words the VFD clock sends to the HV5812.
+
+The trace is captured by 'trace <words>' in the debug terminal, see
+src/vfd_trace.h.  Each word is put out as a line "#T" followed by a
+vfd_trace_word_t in hex: the cycle count of the latch pulse and the 20 bit word
+with a 12 bit sequence number.  A word stays latched until the next one, so
+the trace tells exactly what the tubes showed and when.
+
+The analyzer computes
+  - the on-time of each tube and each of its segments,
+  - the period of each gate and its jitter,
+  - the blank time between two gates,
+  - the time two gates were driven at once (ghosting) and the gate changes
+    without any blank time in between.
+
+The results can be stored as golden values of a known good firmware and later
+captures be compared with them.  A regression makes the analyzer exit with
+status 1.  Golden values depend on the digits shown and on the brightness, so
+golden and new capture have to be taken with the same display content, e.g.
+a stopped stopwatch or a fixed message page.
+
+Examples:
+    pio device monitor | tee capture.txt        # then enter 'trace 4000'
+    tools/vfd_trace_analyze.py capture.txt --save trace.vfdt
+    tools/vfd_trace_analyze.py trace.vfdt --save-golden golden.json
+    tools/vfd_trace_analyze.py capture.txt --golden golden.json
+"""
+import argparse
+import json
+import re
+import struct
+import sys
+
+TRACE_VERSION = 1
+WORD = struct.Struct('<II')  # ccount, word | seq << 20
+FILE_MAGIC = b'VFDT'
+FILE_HEADER = struct.Struct('<4sBBBB')  # magic, version, cpu_mhz, tube_type, reserved
+WORD_MASK = 0x000FFFFF
+SEQ_SHIFT = 20
+SEQ_MASK = 0xFFF
+
+# Layout of the word, see vfd_refresh_slot() in src/multiplexing.cpp
+TUBE_CNT = 6
+GATE_BITS = (16, 17, 18)  # GATE[] of gate 0 to 2, gate n drives the tubes n and n + 3
+SLOT_MS = 5.0  # VFD_REFRESH_MS_PERIOD
+TRACE_LINE = re.compile(r'#T([0-9a-fA-F]{%u})' % (2 * WORD.size))
+START_LINE = re.compile(r'#S (\d+) (\d+) (\d+) (\d+)')
+
+# Allowed deviation from the golden values
+DEFAULT_TOLERANCE = {
+    'duty': 0.02,         # absolute, fraction of the time
+    'period': 0.01,       # relative
+    'jitter_us': 100.0,   # absolute
+    'blank': 0.2,         # relative, the blank time may not get shorter
+}
+
+
+class Trace:
+    """Words with absolute times in microseconds."""
+
+    def __init__(self, cpu_mhz=80, tube_type=1):
+        self.cpu_mhz = cpu_mhz
+        self.tube_type = tube_type
+        self.words = []  # (ccount, word, seq)
+
+    def read_capture(self, lines):
+        for line in lines:
+            start = START_LINE.search(line)
+            if start:
+                version, cpu_mhz, tube_type, size = (int(field) for field in start.groups())
+                if version != TRACE_VERSION or size != WORD.size:
+                    sys.exit("unsupported trace format %u, word size %u" % (version, size))
+                self.cpu_mhz, self.tube_type = cpu_mhz, tube_type
+                continue
+            match = TRACE_LINE.search(line)
+            if match:
+                self.add(*WORD.unpack(bytes.fromhex(match.group(1))))
+
+    def read_file(self, data):
+        magic, version, self.cpu_mhz, self.tube_type, _ = FILE_HEADER.unpack_from(data)
+        if magic != FILE_MAGIC or version != TRACE_VERSION:
+            sys.exit("no trace file of version %u" % TRACE_VERSION)
+        for offset in range(FILE_HEADER.size, len(data) - WORD.size + 1, WORD.size):
+            self.add(*WORD.unpack_from(data, offset))
+
+    def add(self, ccount, raw):
+        self.words.append((ccount, raw & WORD_MASK, (raw >> SEQ_SHIFT) & SEQ_MASK))
+
+    def to_bytes(self):
+        data = bytearray(FILE_HEADER.pack(FILE_MAGIC, TRACE_VERSION, self.cpu_mhz, self.tube_type, 0))
+        for ccount, word, seq in self.words:
+            data += WORD.pack(ccount, word | seq << SEQ_SHIFT)
+        return bytes(data)
+
+    def runs(self):
+        """Yields lists of (time us, word) without lost words, the cycle count is unwrapped."""
+        run = []
+        cycles = 0
+        previous = None
+        for ccount, word, seq in self.words:
+            if previous is not None:
+                if seq != (previous[2] + 1) & SEQ_MASK:
+                    if len(run) > 1:
+                        yield run
+                    run = []
+                else:
+                    cycles += (ccount - previous[0]) & 0xFFFFFFFF
+            previous = (ccount, word, seq)
+            run.append((cycles / self.cpu_mhz, word))
+        if len(run) > 1:
+            yield run
+
+
+def gates_of(word):
+    return [gate for gate, bit in enumerate(GATE_BITS) if word & (1 << bit)]
+
+
+def analyze(trace):
+    """Returns the timing figures of the trace as dict."""
+    total_us = 0.0
+    tube_us = [0.0] * TUBE_CNT
+    segment_us = [[0.0] * 8 for _ in range(TUBE_CNT)]
+    periods = [[] for _ in GATE_BITS]
+    blanks = []
+    overlap_us = 0.0
+    overlaps = 0
+    direct_changes = 0
+    lost_runs = -1
+    for run in trace.runs():
+        lost_runs += 1
+        last_on = [None] * len(GATE_BITS)
+        active = []
+        blank_start = None
+        for (time_us, word), (next_us, _) in zip(run, run[1:]):
+            duration = next_us - time_us
+            total_us += duration
+            gates = gates_of(word)
+            if len(gates) > 1:
+                overlaps += 1
+                overlap_us += duration
+            for gate in gates:
+                for tube, byte in ((gate, word >> 8 & 0xFF), (gate + 3, word & 0xFF)):
+                    if byte:
+                        tube_us[tube] += duration
+                    for segment in range(8):
+                        if byte & (1 << segment):
+                            segment_us[tube][segment] += duration
+                if gate not in active:
+                    if last_on[gate] is not None:
+                        periods[gate].append(time_us - last_on[gate])
+                    last_on[gate] = time_us
+            # Time between a gate turned off and the next one turned on
+            if gates and active and not set(gates) & set(active):
+                direct_changes += 1
+                blanks.append(0.0)
+            elif gates and blank_start is not None:
+                blanks.append(time_us - blank_start)
+            if gates:
+                blank_start = None
+            elif active:
+                blank_start = time_us
+            active = gates
+    if total_us == 0:
+        sys.exit("trace holds less than two consecutive words")
+
+    nominal_us = SLOT_MS * 1000.0 * len(GATE_BITS)
+    result = {
+        'cpu_mhz': trace.cpu_mhz,
+        'tube_type': trace.tube_type,
+        'words': len(trace.words),
+        'gaps': lost_runs,
+        'duration_ms': round(total_us / 1000.0, 3),
+        'tube_duty': [round(us / total_us, 4) for us in tube_us],
+        'segment_duty': [[round(us / total_us, 4) for us in tube] for tube in segment_us],
+        'gate_period_us': [],
+        'blank_us': None,
+        'overlap_us': round(overlap_us, 1),
+        'overlaps': overlaps,
+        'direct_changes': direct_changes,
+    }
+    for gate_periods in periods:
+        if gate_periods:
+            mean = sum(gate_periods) / len(gate_periods)
+            result['gate_period_us'].append({
+                'mean': round(mean, 1), 'min': round(min(gate_periods), 1), 'max': round(max(gate_periods), 1),
+                'jitter': round(max(abs(period - nominal_us) for period in gate_periods), 1)})
+        else:
+            result['gate_period_us'].append(None)
+    if blanks:
+        result['blank_us'] = {'mean': round(sum(blanks) / len(blanks), 1), 'min': round(min(blanks), 1),
+                              'max': round(max(blanks), 1)}
+    return result
+
+
+def compare(result, golden, tolerance):
+    """Returns the list of regressions of result against golden."""
+    failures = []
+    for key in ('cpu_mhz', 'tube_type'):
+        if result[key] != golden[key]:
+            failures.append("%s is %s, golden %s" % (key, result[key], golden[key]))
+    for tube, (duty, golden_duty) in enumerate(zip(result['tube_duty'], golden['tube_duty'])):
+        if abs(duty - golden_duty) > tolerance['duty']:
+            failures.append("tube %u on-time %.4f, golden %.4f" % (tube, duty, golden_duty))
+        for segment, (seg, golden_seg) in enumerate(zip(result['segment_duty'][tube], golden['segment_duty'][tube])):
+            if abs(seg - golden_seg) > tolerance['duty']:
+                failures.append("tube %u segment %u on-time %.4f, golden %.4f" % (tube, segment, seg, golden_seg))
+    for gate, (period, golden_period) in enumerate(zip(result['gate_period_us'], golden['gate_period_us'])):
+        if period is None or golden_period is None:
+            if period != golden_period:
+                failures.append("gate %u period missing" % gate)
+            continue
+        if abs(period['mean'] - golden_period['mean']) > tolerance['period'] * golden_period['mean']:
+            failures.append("gate %u period %.1f us, golden %.1f us" % (gate, period['mean'], golden_period['mean']))
+        if period['jitter'] > golden_period['jitter'] + tolerance['jitter_us']:
+            failures.append("gate %u jitter %.1f us, golden %.1f us" % (gate, period['jitter'],
+                                                                       golden_period['jitter']))
+    if golden['blank_us'] is not None:
+        if result['blank_us'] is None:
+            failures.append("no blank time between the gates")
+        elif result['blank_us']['min'] < golden['blank_us']['min'] * (1.0 - tolerance['blank']):
+            failures.append("blank time %.1f us, golden %.1f us" % (result['blank_us']['min'],
+                                                                    golden['blank_us']['min']))
+    if result['overlaps'] > golden['overlaps']:
+        failures.append("%u gate overlaps (%.1f us), golden %u" % (result['overlaps'], result['overlap_us'],
+                                                                   golden['overlaps']))
+    if result['direct_changes'] > golden['direct_changes']:
+        failures.append("%u gate changes without blank time, golden %u" % (result['direct_changes'],
+                                                                           golden['direct_changes']))
+    return failures
+
+
+def print_result(result, out):
+    out.write("%u words, %.1f ms, %u gaps, %u MHz, tube type %u\n" % (
+        result['words'], result['duration_ms'], result['gaps'], result['cpu_mhz'], result['tube_type']))
+    for tube in range(TUBE_CNT):
+        out.write("tube %u on %5.1f %%  segments %s\n" % (tube, 100.0 * result['tube_duty'][tube], ' '.join(
+            "%5.1f" % (100.0 * duty) for duty in result['segment_duty'][tube])))
+    for gate, period in enumerate(result['gate_period_us']):
+        if period:
+            out.write("gate %u period %.1f us (%.1f to %.1f), jitter %.1f us\n" % (
+                gate, period['mean'], period['min'], period['max'], period['jitter']))
+    if result['blank_us']:
+        out.write("blank between gates %.1f us (%.1f to %.1f)\n" % (
+            result['blank_us']['mean'], result['blank_us']['min'], result['blank_us']['max']))
+    out.write("gate overlaps %u (%.1f us), gate changes without blank %u\n" % (
+        result['overlaps'], result['overlap_us'], result['direct_changes']))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('trace', help="capture of the terminal or trace file written by --save")
+    parser.add_argument('--save', metavar='FILE', help="write the words to a compact binary trace file")
+    parser.add_argument('--json', metavar='FILE', help="write the results as JSON")
+    parser.add_argument('--save-golden', metavar='FILE', help="store the results as golden values")
+    parser.add_argument('--golden', metavar='FILE', help="compare with golden values, exit 1 on a regression")
+    for key, value in DEFAULT_TOLERANCE.items():
+        parser.add_argument('--tol-' + key.replace('_', '-'), type=float, default=value, dest='tol_' + key,
+                            help="tolerance of %s (default %s)" % (key, value))
+    args = parser.parse_args()
+
+    trace = Trace()
+    with open(args.trace, 'rb') as source:
+        data = source.read()
+    if data.startswith(FILE_MAGIC):
+        trace.read_file(data)
+    else:
+        trace.read_capture(data.decode('utf-8', errors='replace').splitlines())
+    if args.save:
+        with open(args.save, 'wb') as target:
+            target.write(trace.to_bytes())
+
+    result = analyze(trace)
+    print_result(result, sys.stdout)
+    for path in (args.json, args.save_golden):
+        if path:
+            with open(path, 'w', encoding='utf-8') as target:
+                json.dump(result, target, indent=1)
+    if args.golden:
+        with open(args.golden, encoding='utf-8') as source:
+            golden = json.load(source)
+        tolerance = dict((key, getattr(args, 'tol_' + key)) for key in DEFAULT_TOLERANCE)
+        failures = compare(result, golden, tolerance)
+        for failure in failures:
+            print("REGRESSION: " + failure)
+        if failures:
+            sys.exit(1)
+        print("matches golden values")
+
+
+if __name__ == '__main__':
+    main()